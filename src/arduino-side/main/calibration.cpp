@@ -0,0 +1,184 @@
+// Include calibration header file
+#include "calibration.h"
+#include "motion.h"
+#include "park.h"
+#include "feed.h"
+#include "battery.h"
+#include <EEPROM.h>
+
+// DEFINE VARIABLES
+CalibrationState calibrationState = {};
+
+// DEFINE FUNCTIONS
+/*
+ Reads the CalibrationRecord from the EEPROM and, only if its version and CRC are right,
+ replaces the default timings with the saved ones.
+*/
+bool calibrationLoad(){
+  CalibrationRecord record;
+  EEPROM.get(CALIBRATION_ADDRESS, record);
+  if (record.version != CALIBRATION_VERSION || record.board != boardVariant
+      || record.crc != crc8((const uint8_t*)&record, sizeof(record) - 1)) {
+    return false;  // Never saved (or saved by another version, or for the other board): the defaults are kept
+  }
+  serialDelay = record.serialDelay;
+  rotationDelay = record.rotationDelay;
+  departMinDelay = record.departMinDelay;
+  paddleGoingInterval = record.paddleGoingInterval;
+  paddleNotGoingInterval = record.paddleNotGoingInterval;
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 2; j++) {
+      offsetDelays[i][j] = record.offsetDelays[i][j];
+      travelMillis[i][j] = record.travelMillis[i][j];
+    }
+  }
+  batteryNominal = record.batteryNominal;
+  return true;
+}
+
+// Writes the current timings in the EEPROM (EEPROM.put only rewrites the bytes that have changed)
+void calibrationSave(){
+  CalibrationRecord record;
+  record.version = CALIBRATION_VERSION;
+  record.board = boardVariant;
+  record.serialDelay = serialDelay;
+  record.rotationDelay = rotationDelay;
+  record.departMinDelay = departMinDelay;
+  record.paddleGoingInterval = feedNeutralIntervals[0];  // Not the ones of the last set-point of the Rpi4
+  record.paddleNotGoingInterval = feedNeutralIntervals[1];
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 2; j++) {
+      record.offsetDelays[i][j] = offsetDelays[i][j];
+      record.travelMillis[i][j] = travelMillis[i][j];
+    }
+  }
+  record.batteryNominal = batteryNominal;
+  record.crc = crc8((const uint8_t*)&record, sizeof(record) - 1);
+  EEPROM.put(CALIBRATION_ADDRESS, record);
+}
+
+/*
+ A trial is a single rotation followed by the usual offset adjustment (in the opposite direction) and
+ a settle time. The rotation measures 'travelMillis', the adjustment is what gets tuned.
+*/
+static void queueTrial(){
+  uint8_t motorIndex = calibrationState.motorIndex;
+  uint8_t rotationDirection = calibrationState.rotationDirection;
+  motionClear();
+  motionAddRotate(motorIndex, rotationDirection, 1);
+  motionAddOffsetReset(motorIndex, !rotationDirection, offsetDelays[motorIndex][!rotationDirection]);
+  motionAddWait(MOTION_SETTLE_DELAY);  // Let it stop before checking where it is
+  motionStart();
+}
+
+/*
+ Checks where the last adjustment has left the motor, using what its hall has seen during the adjustment:
+ - the magnet has been seen and then left: the adjustment was too long, even if the hall reads a magnet now
+   (it's the next one, reached by going past the right one);
+ - the hall reads the magnet: the adjustment is right;
+ - the magnet has never been seen: the adjustment was too short.
+ Each time the change goes the other way the step is halved, so the value converges.
+*/
+static void evaluateTrial(){
+  uint8_t motorIndex = calibrationState.motorIndex;
+  uint8_t adjustDirection = !calibrationState.rotationDirection;
+  ul& offsetDelay = offsetDelays[motorIndex][adjustDirection];
+  bool passed = hallEvents[motorIndex].magnetSeen && hallEvents[motorIndex].departed;
+  if (!passed && !hallCheck(motorIndex)) {  // The hall reads the magnet
+    calibrationState.good[adjustDirection]++;
+    return;
+  }
+  calibrationState.good[adjustDirection] = 0;
+  int8_t change = passed ? -1 : 1;
+  if (calibrationState.lastChange[adjustDirection] != 0 && change != calibrationState.lastChange[adjustDirection]
+      && calibrationState.step[adjustDirection] > CALIBRATION_MIN_STEP) {
+    calibrationState.step[adjustDirection] /= 2;
+  }
+  calibrationState.lastChange[adjustDirection] = change;
+  if (change < 0) {
+    offsetDelay = (offsetDelay > calibrationState.step[adjustDirection]) ? offsetDelay - calibrationState.step[adjustDirection] : 0;
+  } else {
+    offsetDelay = min(offsetDelay + calibrationState.step[adjustDirection], (ul)CALIBRATION_MAX_OFFSET);
+  }
+}
+
+// Resets the trials' state for the motor passed
+static void startMotor(uint8_t motorIndex){
+  calibrationState.motorIndex = motorIndex;
+  calibrationState.rotationDirection = CLOCKWISE;
+  calibrationState.pairs = 0;
+  for (int i = 0; i < 2; i++) {
+    calibrationState.good[i] = 0;
+    calibrationState.step[i] = CALIBRATION_FIRST_STEP;
+    calibrationState.lastChange[i] = 0;
+  }
+}
+
+/*
+ Called when the calibration has gone through both the motors. 'rotationDelay' is only the limit for moving the
+ magnet away from the hall, so it's set to 3/4 of the fastest rotation measured: never long enough to skip a magnet.
+*/
+static void finishCalibration(){
+  ul fastest = 0;
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 2; j++) {
+      if (travelMillis[i][j] != 0 && (fastest == 0 || travelMillis[i][j] < fastest)) {
+        fastest = travelMillis[i][j];
+      }
+    }
+  }
+  if (fastest != 0) {
+    rotationDelay = fastest * 3 / 4;
+  }
+  calibrationSave();
+  calibrationState.running = false;
+}
+
+/*
+ The calibration moves each motor back and forth (clockwise, then counter clockwise, so it always ends where it started)
+ until both its adjustments have ended on the magnet CALIBRATION_GOOD_TRIALS times in a row, or CALIBRATION_MAX_PAIRS
+ is reached. The chamber should be empty, because the cross and the disk move as if they were throwing.
+ The feedback is sent to the Rpi4 when it's over, like after a throw.
+*/
+void calibrationStart(uint8_t seq){
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 2; j++) {
+      travelMillis[i][j] = 0;  // Measured again from scratch
+    }
+  }
+  batteryNominal = batteryMillivolts;  // The timings are tuned again at the voltage of now, they aren't scaled meanwhile
+  parkSave(false);
+  calibrationState.running = true;
+  throwSeq = seq;
+  isThrowing = true;  // The feedback will be sent when the calibration is over
+  startMotor(DISK);
+  queueTrial();
+}
+
+/*
+ Must be called when the motors are free. Evaluates the trial just done and queues the next one.
+ Returns false when there is no calibration running (or it has just finished).
+*/
+bool calibrationTick(){
+  if (!calibrationState.running) {
+    return false;
+  }
+  evaluateTrial();
+  if (calibrationState.rotationDirection == COUNTER_CLOCKWISE) {
+    calibrationState.pairs++;
+    uint8_t motorIndex = calibrationState.motorIndex;
+    bool tuned = calibrationState.good[CLOCKWISE] >= CALIBRATION_GOOD_TRIALS && calibrationState.good[COUNTER_CLOCKWISE] >= CALIBRATION_GOOD_TRIALS;
+    if (tuned || calibrationState.pairs >= CALIBRATION_MAX_PAIRS) {
+      if (motorIndex == CROSS) {
+        finishCalibration();
+        return false;
+      }
+      startMotor(CROSS);
+      queueTrial();
+      return true;
+    }
+  }
+  calibrationState.rotationDirection = !calibrationState.rotationDirection;
+  queueTrial();
+  return true;
+}
@@ -0,0 +1,227 @@
+// Include capture header file
+#include "capture.h"
+#include "motion.h"
+#include "hall.h"
+#include "drivers.h"
+#include "park.h"
+#include "protocol.h"
+
+// DEFINE VARIABLES
+static uint8_t captureRing[CAPTURE_SAMPLES * CAPTURE_SAMPLE_BYTES];  // Samples, the oldest one at 'captureNext' once it's full
+static volatile uint8_t capturePhase = CAPTURE_IDLE;  // One of the CapturePhase values
+static uint8_t captureMotor;                  // Motor being driven
+static uint8_t captureDirection;              // Its direction
+static uint8_t captureSeq;                    // Sequence number of the FRAME_CAPTURE
+static uint16_t captureInterval;              // Micros between two samples
+static volatile ul captureDueMicros;          // Micros at which the next sample is due
+static volatile uint16_t captureReadings[2];  // Last reading of each hall
+static volatile uint16_t captureNext = 0;     // Index of the ring the next sample goes to
+static volatile uint16_t captureStored = 0;   // Samples in the ring, up to CAPTURE_SAMPLES
+static volatile uint16_t captureLeft = 0;     // Samples still to take after the magnet
+static volatile uint16_t captureLate = 0;     // Samples taken more than an interval after they were due
+static volatile bool captureIndex = false;    // True if the magnet found is an index magnet
+static uint16_t captureTrigger;               // Index of the sample that has found the magnet, from the oldest
+static uint16_t captureSent;                  // Samples already sent
+static bool captureInfoSent;                  // True once the FRAME_CAPTURE_INFO has been sent
+static ul captureStartMillis;                 // Millis at which the current phase (sampling or return) has started
+
+// DEFINE FUNCTIONS
+// A FRAME_CAPTURE carries motor, direction and the sample interval in micros (little endian)
+bool captureValid(const uint8_t request[], uint8_t length){
+  if (length != 4 || request[0] > CROSS || request[1] > COUNTER_CLOCKWISE) {
+    return false;
+  }
+  uint16_t interval = request[2] | (request[3] << 8);
+  return interval >= CAPTURE_MIN_INTERVAL && interval <= CAPTURE_MAX_INTERVAL;
+}
+
+/*
+ The capture is a command like a throw: the feedback is sent when it's over, after its frames.
+ The motors are moving from now on, so if the power goes off the calibration at boot can't be skipped.
+*/
+void captureStart(const uint8_t request[], uint8_t seq){
+  parkSave(false);
+  captureMotor = request[0];
+  captureDirection = request[1];
+  captureInterval = request[2] | (request[3] << 8);
+  captureSeq = seq;
+  captureNext = 0;
+  captureStored = 0;
+  captureLate = 0;
+  captureSent = 0;
+  captureInfoSent = false;
+  captureTrigger = CAPTURE_NO_TRIGGER;
+  throwSeq = seq;
+  dualTrash = TRASH_NONE;
+  isThrowing = true;
+  captureStartMillis = millis();
+  captureDueMicros = micros();
+  capturePhase = CAPTURE_LEAVING;
+  hallCapture(true);
+  driveMotor(captureMotor, captureDirection);
+}
+
+/*
+ A sample is made of both the readings and it's taken when the cross's one arrives, if it's due: the halls are
+ converted one after the other, so the two readings of a sample are at most a conversion apart.
+ Only a few byte writes and comparisons, since it runs in the ADC interrupts.
+*/
+void captureSample(uint8_t motorIndex, int reading){
+  if (capturePhase < CAPTURE_LEAVING || capturePhase > CAPTURE_AFTER) {
+    return;
+  }
+  captureReadings[motorIndex] = reading;
+  ul late = micros() - captureDueMicros;
+  if (motorIndex != CROSS || (long)late < 0) {
+    return;
+  }
+  if (late >= captureInterval) {
+    captureLate++;
+  }
+  captureDueMicros += captureInterval;
+  uint8_t* sample = &captureRing[captureNext * CAPTURE_SAMPLE_BYTES];
+  sample[0] = uint8_t(captureReadings[DISK]);
+  sample[1] = uint8_t(captureReadings[CROSS]);
+  sample[2] = (captureReadings[DISK] >> 8) | ((captureReadings[CROSS] >> 8) << 2);
+  captureNext = (captureNext + 1) % CAPTURE_SAMPLES;
+  if (captureStored < CAPTURE_SAMPLES) {
+    captureStored++;
+  }
+  int moving = captureReadings[captureMotor];
+  switch (capturePhase) {
+    case CAPTURE_LEAVING:
+      // Same check as a departure in 'hallProcess'
+      if (moving > hallThresholds[captureMotor].exitLow && moving < hallThresholds[captureMotor].exitHigh) {
+        capturePhase = CAPTURE_SEEKING;
+      }
+      break;
+    case CAPTURE_SEEKING:
+      if (moving <= hallThresholds[captureMotor].entryLow || moving >= hallThresholds[captureMotor].entryHigh) {
+        captureIndex = moving <= hallThresholds[captureMotor].entryLow;
+        captureLeft = CAPTURE_SAMPLES - CAPTURE_PRETRIGGER - 1;
+        capturePhase = CAPTURE_AFTER;
+      }
+      break;
+    default:  // CAPTURE_AFTER
+      if (--captureLeft == 0) {
+        capturePhase = CAPTURE_SAMPLED;
+      }
+      break;
+  }
+}
+
+// The job that puts the motor back on a magnet, the same steps as a rotation of a throw
+static void captureReturn(bool rotate){
+  motionClear();
+  if (rotate) {
+    motionAddRotate(captureMotor, captureDirection, 1);
+  }
+  motionAddOffsetReset(captureMotor, !captureDirection, offsetDelays[captureMotor][!captureDirection]);
+  motionStart();
+  capturePhase = CAPTURE_SENDING;
+}
+
+/*
+ The ring is full: the magnet found is counted and the motor goes on until the next one, where the hall stops it
+ (if it's still on the magnet found, the hall waits for it to go first). Without a magnet within MOTION_BUDGET_DEFAULT
+ a normal rotation takes over, so a jam is handled like in a throw.
+*/
+static void captureSampled(){
+  hallCapture(false);
+  if (capturePhase != CAPTURE_SAMPLED) {
+    motorHalt(captureMotor);
+    captureReturn(true);
+    return;
+  }
+  captureTrigger = captureStored - (CAPTURE_SAMPLES - CAPTURE_PRETRIGGER);
+  positionPass(captureMotor, captureDirection, captureIndex);
+  int moving = captureReadings[captureMotor];
+  if (moving <= hallThresholds[captureMotor].entryLow || moving >= hallThresholds[captureMotor].entryHigh) {
+    hallArmDeparture(captureMotor);
+  } else {
+    hallArm(captureMotor);
+  }
+  captureStartMillis = millis();
+  capturePhase = CAPTURE_RETURN;
+}
+
+// Sends the FRAME_CAPTURE_INFO and then the FRAME_CAPTURE_DATA, only what fits in the serial buffer right now
+static void captureSend(){
+  if (!captureInfoSent) {
+    if (Serial.availableForWrite() < 21 + 5) {
+      return;
+    }
+    volatile HallThresholds& thresholds = hallThresholds[captureMotor];
+    uint8_t info[21] = {captureMotor, captureDirection, uint8_t(captureInterval), uint8_t(captureInterval >> 8),
+                        uint8_t(captureStored), uint8_t(captureStored >> 8), uint8_t(captureTrigger), uint8_t(captureTrigger >> 8),
+                        uint8_t(thresholds.entryLow), uint8_t(thresholds.entryLow >> 8), uint8_t(thresholds.entryHigh), uint8_t(thresholds.entryHigh >> 8),
+                        uint8_t(hallHysteresis), uint8_t(hallHysteresis >> 8), captureIndex, uint8_t(captureLate), uint8_t(captureLate >> 8),
+                        hallMode, CAPTURE_SAMPLE_BYTES, uint8_t(thresholds.baseline), uint8_t(thresholds.baseline >> 8)};
+    sendFrame(FRAME_CAPTURE_INFO, captureSeq, info, sizeof(info));
+    captureInfoSent = true;
+  }
+  const uint8_t frameLength = 2 + CAPTURE_SAMPLES_PER_FRAME * CAPTURE_SAMPLE_BYTES;
+  while (captureSent < captureStored && Serial.availableForWrite() >= frameLength + 5) {
+    uint8_t payload[frameLength] = {uint8_t(captureSent), uint8_t(captureSent >> 8)};
+    uint16_t oldest = (captureStored < CAPTURE_SAMPLES) ? 0 : captureNext;
+    uint8_t count = min(uint16_t(captureStored - captureSent), uint16_t(CAPTURE_SAMPLES_PER_FRAME));
+    for (uint8_t i = 0; i < count; i++) {
+      memcpy(&payload[2 + i * CAPTURE_SAMPLE_BYTES],
+             &captureRing[((oldest + captureSent + i) % CAPTURE_SAMPLES) * CAPTURE_SAMPLE_BYTES], CAPTURE_SAMPLE_BYTES);
+    }
+    sendFrame(FRAME_CAPTURE_DATA, captureSeq, payload, 2 + count * CAPTURE_SAMPLE_BYTES);
+    captureSent += count;
+  }
+}
+
+/*
+ Samples the halls where the ADC isn't driven by the interrupts, and moves the capture on when the ring is full,
+ the next magnet has arrived or the frames can be sent.
+*/
+void captureTick(){
+  switch (capturePhase) {
+    case CAPTURE_LEAVING:
+    case CAPTURE_SEEKING:
+    case CAPTURE_AFTER:
+      if (hallMode == HALL_MODE_POLL) {
+        captureSample(DISK, analogRead(motorData[DISK].HALL));
+        captureSample(CROSS, analogRead(motorData[CROSS].HALL));
+      }
+      if (capturePhase != CAPTURE_AFTER && millis() - captureStartMillis >= MOTION_BUDGET_DEFAULT) {
+        captureSampled();  // No magnet, but the ring has the last samples anyway
+      }
+      break;
+    case CAPTURE_SAMPLED:
+      captureSampled();
+      break;
+    case CAPTURE_RETURN:
+      hallUpdate();
+      if (hallDeparted(captureMotor)) {
+        hallArm(captureMotor);  // Off the magnet found, now the next one
+      }
+      if (hallDetected(captureMotor)) {
+        motorHalt(captureMotor);
+        hallDisarm(captureMotor);
+        positionPass(captureMotor, captureDirection, hallEvents[captureMotor].entryIndex);
+        captureReturn(false);
+      } else if (millis() - captureStartMillis >= MOTION_BUDGET_DEFAULT) {
+        motorHalt(captureMotor);
+        hallDisarm(captureMotor);
+        captureReturn(true);
+      }
+      break;
+    case CAPTURE_SENDING:
+      captureSend();
+      if (captureSent >= captureStored) {
+        capturePhase = CAPTURE_IDLE;
+      }
+      break;
+    default:  // CAPTURE_IDLE
+      break;
+  }
+}
+
+// Returns true while the capture is running or its frames haven't all been sent
+bool captureRunning(){
+  return capturePhase != CAPTURE_IDLE;
+}
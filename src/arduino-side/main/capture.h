@@ -0,0 +1,45 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include "config.h"
+
+/*
+ Waveform capture of the halls, for tuning 'hallThresholdLow', 'hallThresholdHigh' and 'hallHysteresis' from what
+ the halls really read instead of guessing them. The thresholds in use are the ones moved with the learned baseline (see hall.h). Asked by the Rpi4 with a FRAME_CAPTURE (motor, direction, sample interval)
+ and queued like a throw. The motor is driven without stopping on the magnets while both the halls are sampled every
+ 'interval' micros into a ring in RAM; the ring stops CAPTURE_PRETRIGGER samples after the reading of the moving motor's
+ hall has left the window of the thresholds (the next magnet), so the capture holds the quiet reading before the magnet,
+ the whole pulse at full speed and what comes after it. The motor then goes on to the next magnet and is adjusted
+ like after a rotation, the positions are kept right.
+ On the ATmega4809 the samples are taken by the ADC interrupts (see hall.h), elsewhere by 'captureTick' from the loop().
+ The capture is then sent as a FRAME_CAPTURE_INFO followed by the FRAME_CAPTURE_DATA, when the serial buffer has room,
+ and the FRAME_DONE of the command comes last.
+*/
+
+// DEFINITION
+#define CAPTURE_SAMPLES 512           // Samples of the ring (3 bytes each, both halls)
+#define CAPTURE_PRETRIGGER 128        // Samples kept from before the magnet
+#define CAPTURE_MIN_INTERVAL 200      // Micros, the ADC can't convert both the halls faster than this (oversampled, see hall.h)
+#define CAPTURE_MAX_INTERVAL 10000    // Micros
+#define CAPTURE_SAMPLE_BYTES 3        // Low bytes of the disk's and the cross's readings, then their high bits
+#define CAPTURE_SAMPLES_PER_FRAME 10  // Samples in a FRAME_CAPTURE_DATA, after the index of the first one
+#define CAPTURE_NO_TRIGGER 0xFFFF     // Trigger index when no magnet has arrived within MOTION_BUDGET_DEFAULT
+
+// Enum for what the capture is doing
+enum CapturePhase {
+  CAPTURE_IDLE = 0,     // No capture
+  CAPTURE_LEAVING = 1,  // Sampling, waiting for the moving motor's hall to leave the magnet it has started on
+  CAPTURE_SEEKING = 2,  // Sampling, waiting for the next magnet
+  CAPTURE_AFTER = 3,    // Sampling what comes after the magnet
+  CAPTURE_SAMPLED = 4,  // The ring is full, the loop() takes it from here
+  CAPTURE_RETURN = 5,   // Going on to the next magnet, then the offset adjustment
+  CAPTURE_SENDING = 6,  // Sending the frames
+};
+
+// DECLEARING FUNCTIONS
+void captureStart(const uint8_t request[], uint8_t seq);   // Start the capture of a FRAME_CAPTURE, the motors must be free
+bool captureValid(const uint8_t request[], uint8_t length); // True if the payload of a FRAME_CAPTURE can be captured
+void captureSample(uint8_t motorIndex, int reading);        // Give a hall reading to the capture, it can be called from the interrupts
+void captureTick();                                         // Advance the capture, it must be called at every loop() pass
+bool captureRunning();                                      // True until the capture has been sent whole
+
+#endif /*CAPTURE_H*/
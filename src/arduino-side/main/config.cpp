@@ -1,34 +1,123 @@
 // Include config header file
 #include "config.h"
+#include "motion.h"
+#include "drivers.h"
+#include "park.h"
+#include "protocol.h"
+#include "slots.h"
+#include "planner.h"
+#include "program.h"
 
 // DEFINE VARIABLES
 ul serialDelay = 20;
 ul rotationDelay = 900;
-ul crossOffsetDelay = 170;
-ul diskOffsetDelay = 95;
+ul departMinDelay = 150;
 const int hallThresholdLow = 400;
 const int hallThresholdHigh = 550;
+const int hallHysteresis = 25;
 const int feedbackOk = 42;
+const int feedbackUnsorted = 43;
+#if defined(REMATE_BOARD_TRANSISTOR)
+// The brake stops the motors on the magnet, there is no coasting to bring back (the calibration still tunes them)
+ul offsetDelays[2][2] = {
+  {0, 0},  // Disk: clockwise, counter clockwise
+  {0, 0}   // Cross: clockwise, counter clockwise
+};
+#else
+ul offsetDelays[2][2] = {
+  {95, 95},   // Disk: clockwise, counter clockwise
+  {170, 150}  // Cross: clockwise, counter clockwise
+};
+#endif
+ul travelMillis[2][2] = {{0, 0}, {0, 0}};
 ul paddleGoingInterval = 50;  // When there is no friction, this is too much
 ul paddleNotGoingInterval = 1200;
 ul trashIncomingTimeout = 5000;
-ul previousMillis = 0;
-bool paperAlreadyPresent = false;
+const bool dualThrow = true;
+/*
+ Only the metal (disk) and the plastic (cross) use a single motor each, so only them can move together.
+ The paper and the unsorted trashes move both the motors (and the paper may be waiting on the disk), they are always thrown alone.
+*/
+const bool dualThrowSafe[TRASH_UNSORTED + 1][TRASH_UNSORTED + 1] = {
+  // NONE,  PAPER, METAL, PLASTIC, UNSORTED
+  {false, false, false, false, false},  // TRASH_NONE
+  {false, false, false, false, false},  // TRASH_PAPER
+  {false, false, false, true,  false},  // TRASH_METAL
+  {false, false, true,  false, false},  // TRASH_PLASTIC
+  {false, false, false, false, false},  // TRASH_UNSORTED
+};
 bool isThrowing = false;
+bool isFlushing = false;
+bool isBooting = false;
+bool awaitingTrash = false;
+ul trashIncomingMillis = 0;
 TrashType trash = TRASH_NONE;
+uint8_t throwSeq = 0;
+TrashType dualTrash = TRASH_NONE;
+uint8_t dualSeq = 0;
 const MotorData motorData[] = {
-  {COUNTER_DISK_PIN, CLOCK_DISK_PIN, HALL_DISK},
-  {COUNTER_CROSS_PIN, CLOCK_CROSS_PIN, HALL_CROSS}
+  {HALL_DISK},
+  {HALL_CROSS}
+};
+// The same rotations of 'throwPOM', 'throwPaper' and 'throwUnsorted', without the offsets
+const ThrowStroke throwStrokes[TRASH_UNSORTED + 1] = {
+  {{0, 0}, false, {0, 0}},    // TRASH_NONE
+  {{1, -2}, true, {-1, 0}},   // TRASH_PAPER
+  {{-1, 0}, true, {1, 0}},    // TRASH_METAL
+  {{0, 1}, true, {0, 0}},     // TRASH_PLASTIC
+  {{2, -1}, true, {-2, 1}},   // TRASH_UNSORTED
+};
+const ThrowStroke paperHoldStroke = {{0, -1}, false, {0, 0}};
+// Default motion programs of the throws (see program.h), every move is followed by the offset adjustment against it
+const uint8_t motionPrograms[PROGRAM_COUNT][PROGRAM_MAX_LENGTH] PROGMEM = {
+  {},  // Unused (TRASH_NONE)
+  {  // PROGRAM_PAPER
+    PROG_MOVE_BOTH(CLOCKWISE, COUNTER_CLOCKWISE),  // Simultaneously rotates both the disk's motor and the cross's motor
+    PROG_MOVE(CROSS, COUNTER_CLOCKWISE, 1),  // Now the cross rotates again to dispose also the second-arrived waste
+    PROG_CORRECT(CROSS),
+    PROG_CORRECT(DISK),
+    PROG_SETTLE(0),
+    PROG_MOVE_TO(DISK, PROGRAM_POSITION_HOME),
+    PROG_CORRECT(DISK),
+    PROG_RELEASE(TRASH_PAPER)  // Now the slot is free because both wastes have been disposed
+  },
+  {  // PROGRAM_METAL
+    PROG_MOVE_TO(DISK, DISK_METAL_POSITION),  // Moves the disk to put the trash in the corresponding bin
+    PROG_SETTLE(0),
+    PROG_MOVE_TO(DISK, PROGRAM_POSITION_HOME),  // Makes the disk go back in place
+    PROG_CORRECT(DISK)
+  },
+  {  // PROGRAM_PLASTIC
+    PROG_MOVE(CROSS, CLOCKWISE, 1),  // The next arm of the cross takes the place of this one
+    PROG_SETTLE(0),
+    PROG_MOVE_TO(CROSS, PROGRAM_POSITION_HOME),
+    PROG_CORRECT(CROSS)
+  },
+  {  // PROGRAM_UNSORTED
+    PROG_MOVE_BOTH(CLOCKWISE, COUNTER_CLOCKWISE),
+    PROG_CORRECT(CROSS),
+    PROG_MOVE(DISK, CLOCKWISE, 1),
+    PROG_SETTLE(0),
+    PROG_MOVE(DISK, COUNTER_CLOCKWISE, 1),
+    PROG_MOVE_BOTH(COUNTER_CLOCKWISE, CLOCKWISE),
+    PROG_CORRECT(CROSS),
+    PROG_CORRECT(DISK)
+  },
+  {  // PROGRAM_PAPER_HOLD
+    PROG_MOVE(CROSS, COUNTER_CLOCKWISE, 1),  // Rotate the cross to moves the waste
+    PROG_CORRECT(CROSS),
+    PROG_HOLD(TRASH_PAPER)  // Now the paper waits in its slot
+  },
+  {  // PROGRAM_PAPER_EXPIRED
+    PROG_MOVE_TO(DISK, DISK_PAPER_POSITION),
+    PROG_SETTLE(0),
+    PROG_MOVE_TO(DISK, PROGRAM_POSITION_HOME),
+    PROG_CORRECT(DISK),
+    PROG_RELEASE(TRASH_PAPER)
+  },
 };
-PaddleMotorStruct paddleMotorStruct = {1, 1};  // Initialize this at {1, 1} to make the paddle move
 
 // DEFINE FUNCTIONS
-// Reads the output values of the hall passed in the parameter
-bool hallCheck(int hall) {
-  int reading = analogRead(hall);  // Read the output of the hall passed and stores it in the 'reading' variable
-  return (reading > hallThresholdLow && reading < hallThresholdHigh);  // Check if a magnet is detected, if so returns false
-}
-
 /*
  The parameter is a list containg all the motor's indexes that must be turned off.
  The last value of the list is a 0xFF flag, indicating the end for the loop.
@@ -36,203 +125,220 @@ bool hallCheck(int hall) {
 void turnMotorsOff(const int motorIndexes[]){
   // Setting to LOW all the pins of the motors passed
   for (int i = 0; motorIndexes[i] != MOTOR_INDEXES_END_FLAG; i++){
-    const MotorData& motor = motorData[motorIndexes[i]];  // Creating the 'motor' variable
-    digitalWrite(motor.CLOCK_PIN, LOW);
-    digitalWrite(motor.COUNTER_PIN, LOW);
+    motorOff(motorIndexes[i]);
   }
 }
 
 /*
- This is the main function for the paddle's motor handling. Depending on the 'power' and 'going'
- variables, turns on or off the motor. If both are true than the transistor's pin is set to HIGH
- in order to make the paddle's motor move.
+ Queues the throw of the TRASH_PLASTIC and TRASH_METAL passed. When there are two of them (one for each motor)
+ each step of the first one is joined with the same step of the second one, so both the motors move together.
 */
-void controlPaddleMotorPower(PaddleMotorStruct* paddleMotorController) {
-  if(paddleMotorController->power && paddleMotorController->going) {  // Checks if both of the variables are true
-    digitalWrite(PADDLE_NPN, HIGH);  // Setting the transistor to HIGH and so make the paddle's motor move
-  } else {
-    digitalWrite(PADDLE_NPN, LOW);  // Setting the transistor to LOW and so make the paddle'motor stop
+static void queuePOM(const TrashType trashTypes[], uint8_t count){
+  uint8_t motorIndexes[2];
+  for (uint8_t i = 0; i < count; i++) {
+    motorIndexes[i] = (trashTypes[i] == TRASH_METAL) ? DISK : CROSS;  // Choosing the motorIndex based on the trashType
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    // Moves the motor to put the trash in the corresponding bin
+    if (motorIndexes[i] == DISK) {
+      motionAddMoveTo(DISK, DISK_METAL_POSITION);
+    } else {
+      motionAddRotate(CROSS, CLOCKWISE, 1);  // The next arm of the cross takes the place of this one
+    }
+    if (i + 1 < count) {
+      motionWithNext();  // The other motor starts together with this one
+    }
+  }
+  motionAddWait(serialDelay);
+  for (uint8_t i = 0; i < count; i++) {
+    motionAddMoveTo(motorIndexes[i], POSITION_HOME); // Makes the motor go back in place, if it isn't already on a home position
+    if (i + 1 < count) {
+      motionWithNext();  // The other motor starts together with this one
+    }
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    motionAddOffsetResetLast(motorIndexes[i]);  // Adjusting the offset post-rotation
+    if (i + 1 < count) {
+      motionWithNext();  // The other motor starts together with this one
+    }
   }
 }
 
+// This function is used for dispose both the TRASH_PLASTIC and TRASH_METAL.
+void throwPOM(TrashType trashType){
+  programQueue(trashType);  // PROGRAM_METAL or PROGRAM_PLASTIC
+}
+
+// Disposes a TRASH_PLASTIC and a TRASH_METAL at the same time, the disk and the cross each stop on their own hall
+void throwPOMTogether(TrashType first, TrashType second){
+  const TrashType trashTypes[2] = {first, second};
+  queuePOM(trashTypes, 2);
+}
+
 /*
- At each state of the 'paddleMotorStruct.going' corresponds a certain time interval.
-     going = 1 -> interval = 90, going = 0 -> interval = 1000
- Is verified if that interval has been past, if so the state of the 'going' variable is switched.
- The next time that the 'controlPaddleMotorPower' function will be called the motor will act
- accordingly.
- (if going is switched to false, then when the 'controlPaddleMotorPower' will be called, the motor will turn off).
+ If there is no paper waste yet, it simply moves the new one and wait
+ for a second waste to dispose them in the same movement.
+ If a paper waste is already present then moves both the old and the new
+ waste and then dispose both of them. Which of the two is decided by the paper's policy (see slots.h).
 */
-void controlPaddleMotorGoing(PaddleMotorStruct* paddleMotorController){
-  ul currentMillis = millis();  // Get current time
-  // Checking if it's time to switch the going state of the paddle
-  if (currentMillis - previousMillis >= (paddleMotorController->going ? paddleGoingInterval : paddleNotGoingInterval)) {  // Decides which interval to consider
-    previousMillis = currentMillis;  // Upadate the last time that the switch has happend
-    paddleMotorController->going = !paddleMotorController->going;  // Change the going state
-  }
+void throwPaper(){
+  programQueue((slotDecide(TRASH_PAPER) == SLOT_FLUSH) ? PROGRAM_PAPER : PROGRAM_PAPER_HOLD);
 }
 
 /*
- Due to the high speed and acceleration of the motors and the lack of precise mounting, when the motor turns off
- the disk or the cross keeps moving for a bit. This function is used to bring back the cross or disk and to adjust
- the offset.
+ Disposes the paper that has been waiting for too long, without a new one: the disk turns as in the
+ combined move of 'throwPaper' and comes back.
 */
-void resetMotorOffset(uint8_t motorIndex, uint8_t rotationDirection, ul movementDelay){
-  int motors[2] = {(int)motorIndex, MOTOR_INDEXES_END_FLAG};  // Creating a list containg the motor and the 0xFF flag
-  const MotorData& motor = motorData[motorIndex];  // Creating the 'motor' variable
-  delay(200);  // Wait for the cross or disk to stop moving
-  digitalWrite(motor.COUNTER_PIN, rotationDirection);
-  digitalWrite(motor.CLOCK_PIN, !rotationDirection);
-  delay(movementDelay);  // Short time for adjusting the offset
-  turnMotorsOff(motors);
+void flushPaper(){
+  programQueue(PROGRAM_PAPER_EXPIRED);
 }
 
 /*
- The first parameter is the index of the motors to rotate;
- The second one indicates in which direction the rotation must be done;
- The third one is the times that the motor must rotate (1 times -> 1 hall detections, 2 times -> 2 hall detections...);
+ When more than one type of trash falls then they all get disposed in a particular bin.
 */
-void rotateMotor(uint8_t motorIndex, uint8_t rotationDirection, uint8_t times) {
-  int motors[2] = {(int)motorIndex, MOTOR_INDEXES_END_FLAG};  // Creating a list containg the motor and the 0xFF flag
-  for (int i = 0; i < times; i++) {
-    const MotorData& motor = motorData[motorIndex];  // Creating the 'motor' variable
-    // Move the motor away from the magnet or else the hall will detect it and the rotation won't be done
-    digitalWrite(motor.COUNTER_PIN, rotationDirection);
-    digitalWrite(motor.CLOCK_PIN, !rotationDirection);
-    delay(rotationDelay);
-    // Now it can start rotating until a magnet is found from the hall
-    while (hallCheck(motorData[motorIndex].HALL)) {
-      digitalWrite(motor.COUNTER_PIN, rotationDirection);
-      digitalWrite(motor.CLOCK_PIN, !rotationDirection);
-    }
-    turnMotorsOff(motors);  // When a magnet is detected than the motor can be turned off
-  }
+void throwUnsorted(){
+  programQueue(PROGRAM_UNSORTED);
 }
 
 /*
- This function moves both the motor simultaneously regardless of the halls.
- It's used for the first part of the simultaneous rotation where i just need
- to move the cross and the disk to make the magnet moves from the hall.
+ Queues the steps of the throw that matches the trash passed and starts them.
+ The motors are then moved by 'motionTick' at every loop() pass, so this returns immediately.
 */
-void enableMotorSIM(const uint8_t directions[]){
-  for (int i = 0; i < 2; i++){
-    digitalWrite(motorData[1 - i].COUNTER_PIN, directions[1 - i]);
-    digitalWrite(motorData[1 - i].CLOCK_PIN, !directions[1 - i]);
+void startThrow(TrashType trashType, uint8_t seq){
+  parkSave(false);  // If the power goes off from now on, the calibration at boot can't be skipped
+  motionClear();
+  if(trashType == TRASH_METAL || trashType == TRASH_PLASTIC){
+    throwPOM(trashType);
+  } else if(trashType == TRASH_PAPER){
+    throwPaper();
+  } else {  // At this point trash must be TRASH_UNSORTED
+    throwUnsorted();
   }
+  trash = trashType;  // This is the trash being thrown now
+  throwSeq = seq;
+  dualTrash = TRASH_NONE;
+  isThrowing = true;  // The feedback will be sent when the motors have finished
+  motionStart();
 }
 
-// Function that moves the disk and cross motor simultaneously
-void rotateMotorSIM(uint8_t rotationDirectionDisk, uint8_t rotationDirectionCross) {
-  int motors[3] = {DISK, CROSS, MOTOR_INDEXES_END_FLAG};  // Creating a list containg the motor and the 0xFF flag
-  uint8_t directions[2] = {rotationDirectionDisk, rotationDirectionCross};  // Creating a list containing the directions in order
-  // Move the motors away from the magnets or else the halls will detect it and the rotation won't be done
-  enableMotorSIM(directions);
-  delay(rotationDelay);
-  // Now it can start rotating until a magnet is found from the hall
-  bool exitLoop = false;  // Boolean for exiting the loop when both the halls detects a magnet
-  while (!exitLoop) {
-    enableMotorSIM(directions);  // Move both of them until on the halls detect a magnet
-    // Check for magnets and handle motor stops
-    for (int i = 0; i < 2; i++) {
-      if (!hallCheck(motorData[i].HALL)) {  // Checks for both the cross and the disk, based on the i value
-        const int motorToTurnOff[] = {i, MOTOR_INDEXES_END_FLAG};  // Turns off the motor, which hall found a magnet
-        turnMotorsOff(motorToTurnOff);
-        // Rotate the other motor until its magnet is detected
-        while (hallCheck(motorData[1 - i].HALL)) {
-          digitalWrite(motorData[1 - i].COUNTER_PIN, directions[1 - i]);
-          digitalWrite(motorData[1 - i].CLOCK_PIN, !directions[1 - i]);
-        }
-        exitLoop = true;  // Exit the while loop after both motors are aligned with magnets
-        break;  // Exit the for loop
-      }
-    }
+/*
+ Starts disposing the held trashes of the class passed, because they have waited longer than their policy allows.
+ This isn't a command of the Rpi4, so no FRAME_DONE is sent when it's over.
+*/
+void startFlush(TrashType trashType){
+  parkSave(false);  // If the power goes off from now on, the calibration at boot can't be skipped
+  motionClear();
+  if(trashType == TRASH_PAPER){
+    flushPaper();
+  } else {
+    slotRelease(trashType);  // No other class can be held on this Remate
   }
-  turnMotorsOff(motors);  // Turn off all the motors
+  isFlushing = true;
+  motionStart();
 }
 
-// This function is used for dispose both the TRASH_PLASTIC and TRASH_METAL.
-void throwPOM(TrashType trashType){
-  uint8_t motorIndex = (trashType == TRASH_METAL) ? DISK : CROSS;  // Choosing the motorIndex based on the trashType
-  uint8_t rotationDirection = (trashType == TRASH_METAL) ? COUNTER_CLOCKWISE : CLOCKWISE;  // Choosing the rotationDirection based on the trashType
-  rotateMotor(motorIndex, rotationDirection, 1);  // Moves the motor to put the trash in the corresponding bin
-  delay(serialDelay);
-  rotateMotor(motorIndex, !rotationDirection, 1); // Makes the motor go back in place
-  resetMotorOffset(motorIndex, rotationDirection, (trashType == TRASH_PLASTIC ? crossOffsetDelay : diskOffsetDelay));  // Adjusting the offset post-rotation
-  trash = TRASH_NONE;  // Re-setting the 'trash' variable
+/*
+ Starts the calibration of the cross at boot, when the parked state can't be trusted. It's finished by
+ 'endBootCalibration' from the loop(), so the serial link, the paddle and the fast stop line are served meanwhile.
+*/
+void startBootCalibration(){
+  motionClear();
+  motionAddRotate(CROSS, CLOCKWISE, 1);  // Cross calibration
+  motionAddOffsetReset(CROSS, COUNTER_CLOCKWISE, offsetDelays[CROSS][COUNTER_CLOCKWISE]);  // Adjust the cross's offset
+  isBooting = true;  // The FRAME_READY is sent when the cross is in place
+  motionStart();
 }
 
 /*
- If there is no paper waste yet, it simply moves the new one and wait
- for a second waste to dispose them in the same movement.
- If a paper waste is already present then moves both the old and the new
- waste and then dispose both of them.
+ Called when the job of 'startBootCalibration' is over: from here on the positions are counted from where
+ the motors are now, and the commands of the Rpi4 are accepted.
 */
-void throwPaper(){
-  if(paperAlreadyPresent){
-    rotateMotorSIM(CLOCKWISE, COUNTER_CLOCKWISE);  // Simultaneously rotates both the disk's motor and the cross's motor
-    rotateMotor(CROSS, COUNTER_CLOCKWISE, 1);  // Now the cross rotates again to dispose also the second-arrived waste
-    resetMotorOffset(CROSS, CLOCKWISE, crossOffsetDelay);  // Adjusting the cross's offset
-    resetMotorOffset(DISK, COUNTER_CLOCKWISE, diskOffsetDelay);  // Adjusting the disk's offset
-    delay(serialDelay);
-    rotateMotor(DISK, COUNTER_CLOCKWISE, 1);
-    resetMotorOffset(DISK, CLOCKWISE, diskOffsetDelay);  // Adjusting the disk's offset
-    /*
-    rotateMotor(CROSS, CLOCKWISE, 1);  // Once both the new waste and the previous waste have been thrown away, the cross starts to go back in place
-    rotateMotorSIM(COUNTER_CLOCKWISE, CLOCKWISE); // Simultaneously rotates both the disk's motor and the cross's motor
-    */
-    paperAlreadyPresent = false;  // Now this becomes true because both wastes have been disposed
-  } else {  // If there is no paper waste yet
-    rotateMotor(CROSS, COUNTER_CLOCKWISE, 1);  // Rotate the cross to moves the waste
-    resetMotorOffset(CROSS, CLOCKWISE, crossOffsetDelay);  // Adjusting the cross's offset
-    paperAlreadyPresent = true;  // Now the 'paperAlreadyPresent' is true
+void endBootCalibration(){
+  isBooting = false;
+  positionReset(DISK, 0);
+  positionReset(CROSS, 0);
+  if (!motionFaulted()) {  // Otherwise the jam is reported by the loop(), after the FRAME_READY
+    parkSave(true);
   }
-  trash = TRASH_NONE;
+  sendReadyToPi();
 }
 
 /*
- When more than one type of trash falls then they all get disposed in a particular bin.
+ Starts the job planned for the trashes of a FRAME_BATCH, instead of throwing them one at a time.
+ A single FRAME_DONE is sent when the whole job is over.
 */
-void throwUnsorted(){
-	rotateMotorSIM(CLOCKWISE, COUNTER_CLOCKWISE);  // Simultaneously rotates both the disk's motor and the cross's motor
-	resetMotorOffset(CROSS, CLOCKWISE, crossOffsetDelay);  // Adjusting the cross's offset
-	rotateMotor(DISK, CLOCKWISE, 1);  //
-	delay(serialDelay);
-	rotateMotor(DISK, COUNTER_CLOCKWISE, 1);  //
-	rotateMotorSIM(COUNTER_CLOCKWISE, CLOCKWISE);  // Simultaneously rotates both the disk's motor and the cross's motor
-	resetMotorOffset(CROSS, COUNTER_CLOCKWISE, crossOffsetDelay);  // Adjusting the cross's offset
-	resetMotorOffset(DISK, CLOCKWISE, diskOffsetDelay);  // Adjusting the disk's offset
+void startBatch(const uint8_t items[], uint8_t count, uint8_t seq){
+  parkSave(false);  // If the power goes off from now on, the calibration at boot can't be skipped
+  motionClear();
+  planBatch(items, count);
+  trash = TRASH_BATCH;
+  throwSeq = seq;
+  dualTrash = TRASH_NONE;
+  isThrowing = true;  // The feedback will be sent when the motors have finished
+  motionStart();
+}
+
+// True if the two trashes passed can be thrown at the same time, following the 'dualThrowSafe' interlock table
+bool canThrowTogether(TrashType first, TrashType second){
+  if (!dualThrow || first > TRASH_UNSORTED || second > TRASH_UNSORTED) {
+    return false;
+  }
+  return dualThrowSafe[first][second];
+}
+
+/*
+ Starts the throws of two trashes together, they must have passed 'canThrowTogether'.
+ Each command gets its own FRAME_DONE when both the motors have finished.
+*/
+void startDualThrow(TrashType first, uint8_t firstSeq, TrashType second, uint8_t secondSeq){
+  parkSave(false);  // If the power goes off from now on, the calibration at boot can't be skipped
+  motionClear();
+  throwPOMTogether(first, second);
+  trash = first;
+  throwSeq = firstSeq;
+  dualTrash = second;
+  dualSeq = secondSeq;
+  isThrowing = true;  // The feedback will be sent when the motors have finished
+  motionStart();
+}
+
+// CRC-8 (polynomial 0x07) of the bytes passed, used for checking what is saved in the EEPROM
+uint8_t crc8(const uint8_t* data, uint8_t length){
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
 }
 
 // RPI4 COMMUNICATION
 // Function to verify that the incoming data from the Rpi4 is a valid number
 bool isValidTrashType(TrashType trashToVerify) {
-  return (trashToVerify > TRASH_NONE && trashToVerify <= TRASH_UNSORTED) || trashToVerify == TRASH_INCOMING;
+  return (trashToVerify > TRASH_NONE && trashToVerify <= TRASH_UNSORTED) || trashToVerify == TRASH_INCOMING || trashToVerify == TRASH_CALIBRATE;
 }
 
 /*
- If the Rpi4 is sending something through the Serial port, read it, convert it in int
- type and returns it (only if it is a value between 0 and 3 or equal to 9).
+ If the Rpi4 has sent a new command, returns it (only if it is a valid TrashType or flag).
+ The frames are read by 'receiveCommand', which never waits and queues the commands that move the motors.
 */
 int getTrashFromPi() {
-  Serial.flush();  // Clear the outgoing buffer
-  TrashType trashGet = TRASH_NONE;
-  if (Serial.available() > 0) {  // Verify that something is coming through the Serial port
-    trashGet = TrashType(Serial.parseInt());  // Get serial input
-    if (!isValidTrashType(trashGet)) {  // Checks if it is a valid value
-      trashGet = TRASH_NONE;  // Reset to default if invalid
-    }
-  }
-  return trashGet;  // Return the verified value
+  return receiveCommand();
 }
 
-// Send the feedback to Rpi4 after the throwing is over
+/*
+ Send the feedback to Rpi4 after the throwing is over, in the FRAME_DONE of the command that started it.
+ The frame is sent again until the Rpi4 answers, so no delay is needed before it.
+*/
 void sendFeedbackToPi(int feedbackNumber){
-	delay(1000);  // Needed for solving latency problems
-  Serial.println(feedbackNumber);  // Send the "done" flag (42) to the Rpi4
-  Serial.flush();  // Clear the outgoing buffer
-  delay(serialDelay);
-  while (Serial.available() > 0) { // Clear any remaining data in the input buffer
-    Serial.read();
+  sendDoneToPi(throwSeq, feedbackNumber);  // Send the "done" flag (42) to the Rpi4
+  if (dualTrash != TRASH_NONE) {
+    sendDoneToPi(dualSeq, feedbackNumber);  // The second trash of a dual throw is over too
+    dualTrash = TRASH_NONE;
   }
+  trash = TRASH_NONE;  // Re-setting the 'trash' variable
   isThrowing = false;
+  parkSave(true);  // The motors are parked on their magnets again
 }
@@ -3,29 +3,61 @@
 #include <Arduino.h>
 
 // DEFINITION
-// Definition for the disk's motor
+// Definition for the disk's motor (relays)
 #define CLOCK_DISK_PIN 2
 #define COUNTER_DISK_PIN 4
-// Definition for the cross's motor
+// Definition for the cross's motor (relays)
 #define CLOCK_CROSS_PIN 7
 #define COUNTER_CROSS_PIN 8
+// Definition for the disk's motor (transistors)
+#define CLOCK_DISK_PNP 2
+#define COUNTER_DISK_PNP 3
+#define CLOCK_DISK_NPN 4
+#define COUNTER_DISK_NPN 5
+// Definition for the cross's motor (transistors)
+#define CLOCK_CROSS_PNP 6
+#define COUNTER_CROSS_PNP 7
+#define CLOCK_CROSS_NPN 8
+#define COUNTER_CROSS_NPN 9
+// Definition of the step down regulators (transistors)
+#define DISK_MOTOR_REGULATOR 10
+#define CROSS_MOTOR_REGULATOR 11
 // Definition for the paddle's motor
 #define PADDLE_NPN 12
+#define PADDLE_STOP_PIN A3  // Fast stop line from the Rpi4 (3.3V -> 5V level shifter, pulled down when the Rpi4 is off)
 // Definition for the hall's
 #define HALL_DISK A0
 #define HALL_CROSS A1
+// Definition for the battery monitor (divider from the 12V battery, see battery.h)
+#define BATTERY_PIN A2
 // Definitions for the directions of rotation
 #define CLOCKWISE 0
 #define COUNTER_CLOCKWISE 1
 // Definition for the motors indexes
 #define DISK 0
 #define CROSS 1
+// Definition for the magnets of the disk and of the cross (one every 90 degrees)
+#define MOTOR_POSITIONS 4
+// Definition for the positions of the disk over its bins (see position.h)
+#define DISK_METAL_POSITION 3  // A quarter turn counter clockwise
+#define DISK_PAPER_POSITION 1  // A quarter turn clockwise
 // Useful definition
 #define MOTOR_INDEXES_END_FLAG 0xFF  // This will be useful for turning the motors off
 
 // Typedefinition for unsigned long type
 typedef unsigned long ul;
 
+// Enum for the boards Remate can be built for, the motors' drivers are chosen from this (see drivers.h)
+enum BoardVariant {
+  BOARD_RELAY = 0,       // Relays, the default
+  BOARD_TRANSISTOR = 1,  // NPN/PNP H-bridges, built with -DREMATE_BOARD_TRANSISTOR
+};
+#if defined(REMATE_BOARD_TRANSISTOR)
+constexpr BoardVariant boardVariant = BOARD_TRANSISTOR;
+#else
+constexpr BoardVariant boardVariant = BOARD_RELAY;
+#endif
+
 // Enum for trash types
 enum TrashType {
   TRASH_NONE = 0,
@@ -33,58 +65,74 @@ enum TrashType {
   TRASH_METAL = 2,
   TRASH_PLASTIC = 3,
   TRASH_UNSORTED = 4,
+  TRASH_CALIBRATE = 7,  // 7 is a flag asking to calibrate the motors' timings, it isn't a trash
+  TRASH_BATCH = 8,  // 8 is a flag for a list of trashes thrown with a single planned job (FRAME_BATCH), it isn't a trash
   TRASH_INCOMING = 9,  // 9 is a flag indicating that something has been detected from the Rpi4, but it's not defined yet
+  TRASH_CAPTURE = 10,  // 10 is a flag for a capture of the halls' waveform (FRAME_CAPTURE, see capture.h), it isn't a trash
 };
 
 // CONSTANTS
 extern ul serialDelay;               // Millis for Serial related actions
-extern ul rotationDelay;             // Millis for making sure that the magnet has moved away from the hall
-extern ul crossOffsetDelay;          // Millis for adjusting the cross after a rotation
-extern ul diskOffsetDelay;           // Millis for adjusting the disk after a rotation
-extern const int hallThresholdLow;   // If hall's value < than this, there is a magnet
-extern const int hallThresholdHigh;  // If hall's value > than this, there is a magnet
+extern ul rotationDelay;             // Max millis for making sure that the magnet has moved away from the hall
+extern ul departMinDelay;            // Min millis of movement before the magnet can be considered moved away from the hall
+extern const int hallThresholdLow;   // If hall's value < than this, there is a magnet (for HALL_NOMINAL_BASELINE, see hall.h)
+extern const int hallThresholdHigh;  // If hall's value > than this, there is a magnet (for HALL_NOMINAL_BASELINE, see hall.h)
+extern const int hallHysteresis;     // The magnet has moved away only when hall's value is this much inside the thresholds
 extern const int feedbackOk;         // Number to send at the Rpi4 when throwing is over
+extern const int feedbackUnsorted;   // Number to send instead of 'feedbackOk' when a jam has sent the trash to the unsorted bin
+extern ul offsetDelays[2][2];        // Millis for adjusting the disk (0) or the cross (1) after a rotation, for each direction of the adjustment
+extern ul travelMillis[2][2];        // Millis measured for a rotation (at full speed) of the disk (0) or the cross (1), for each direction (0 -> not measured)
 // Logic for the paddle motor going delay -> // 200 and 675 with 6v
 extern ul paddleGoingInterval;       // Millis indicating the time of paddle's going
 extern ul paddleNotGoingInterval;    // Millis indicating the time of paddle's stopping
 extern ul trashIncomingTimeout;      // Millis for exiting the 9 condition if nothing is received
-extern ul previousMillis;            // Stores the last time that the paddle's going variable has changed
+extern const bool dualThrow;         // True if two queued trashes for different motors can be thrown together
+extern const bool dualThrowSafe[TRASH_UNSORTED + 1][TRASH_UNSORTED + 1];  // Interlock table: which trashes can be thrown together
 
 // TRASHING SETUP
-extern bool paperAlreadyPresent;     // True when there is already a paper trash type waiting for being disposed
-extern bool isThrowing;              // When this is false the arduino read from the Serial, if true then all the data incoming from the Serial won't be considered
-extern TrashType trash;              // Trash initialized as null
+extern bool isThrowing;              // True while a throw is running, the feedback to the Rpi4 must be sent when it's over
+extern bool isFlushing;              // True while the held trashes are disposed because of their timeout (see slots.h)
+extern bool isBooting;               // True while the cross is calibrated at boot, the FRAME_READY is sent when it's over
+extern bool awaitingTrash;           // True after a 9 has been received and the defined trash hasn't arrived yet
+extern ul trashIncomingMillis;       // Stores the time at which the last 9 has been received
+extern TrashType trash;              // Trash that is being thrown, initialized as null
+extern uint8_t throwSeq;             // Sequence number of the command being executed, sent back in the FRAME_DONE
+extern TrashType dualTrash;          // Trash thrown together with 'trash', TRASH_NONE if the throw is a single one
+extern uint8_t dualSeq;              // Sequence number of the command of 'dualTrash'
 
 // MOTOR STRUCTS
-// Struct for the disk's and the cross's motor
+// Struct for the disk's and the cross's motor, their pins are in the board profile (see drivers.h)
 typedef struct {
-  int COUNTER_PIN;
-  int CLOCK_PIN;
   int HALL;
 } MotorData;
 extern const MotorData motorData[];  // List that assigns to each element of the struct a pin
 
-// Struct for the paddle's motor
+// Struct for the rotations of a throw as the planner sees them (see planner.h), > 0 clockwise and < 0 counter clockwise
 typedef struct {
-  bool power;  // Indicates if the paddle should be moving (true) or not (false)
-  bool going;  // Indicates if the paddle is currently in the "going" or "not going" position when power is true
-} PaddleMotorStruct;
-extern PaddleMotorStruct paddleMotorStruct; // Instance of PaddleMotorStruct to control the paddle motor
+  int8_t before[2];  // Rotations of the disk (0) and of the cross (1) that bring the trash to its bin
+  bool dump;         // True if the trash falls in its bin after 'before' (false for a paper that is only parked)
+  int8_t after[2];   // Rotations of the disk and of the cross that bring them back in place
+} ThrowStroke;
+extern const ThrowStroke throwStrokes[TRASH_UNSORTED + 1];  // Stroke of each trash (for the paper, the one that disposes the held paper too)
+extern const ThrowStroke paperHoldStroke;                   // Stroke that parks a paper
 
 // DECLEARING FUNCTIONS
-bool hallCheck(int hall);                                                // Read values from disk's or cross's hall
 void turnMotorsOff(const int motorIndexes[]);                            // Turn off motors passed in the array
-void controlPaddleMotorPower(PaddleMotorStruct* paddleMotorController);  // Main function for the paddle motor's transistor handling
-void controlPaddleMotorGoing(PaddleMotorStruct* paddleMotorController);  // Control paddle motor's going state depending on time
-void resetMotorOffset(uint8_t motorIndex, uint8_t rotationDirection, ul movementDelay);  // Adjusts the motor's offset after a rotation has occurred
-void rotateMotor(uint8_t motorIndex, uint8_t rotationDirection, uint8_t times);  // Rotate cross's or disk's motor
-void enableMotorSIM(const uint8_t directions[]);                         // Enable both the disk's motor and the cross's motor simultaneously
-void rotateMotorSIM(uint8_t rotationDirectionDisk, uint8_t rotationDirectionCross);  // Rotate simultaneously the cross's and the disk's motor
-void throwPOM(TrashType trashType);                                      // Throw POM (plastic or metal)
-void throwPaper();                                                       // Function to handle paper trashes
-void throwUnsorted();                                                    // Throw all the trashes in the unsorted bin
+void throwPOM(TrashType trashType);                                      // Start throwing POM (plastic or metal)
+void throwPOMTogether(TrashType first, TrashType second);                // Start throwing a plastic and a metal together
+void throwPaper();                                                       // Start handling paper trashes
+void flushPaper();                                                       // Start disposing the held paper alone
+void throwUnsorted();                                                    // Start throwing all the trashes in the unsorted bin
+void startThrow(TrashType trashType, uint8_t seq);                       // Start the throw that matches the trash passed
+void startFlush(TrashType trashType);                                    // Start disposing the held trashes of the class passed
+void startBootCalibration();                                            // Start the calibration of the cross done at boot
+void endBootCalibration();                                               // End it and tell the Rpi4 that Remate is ready
+void startBatch(const uint8_t items[], uint8_t count, uint8_t seq);       // Start the planned job of the trashes of a FRAME_BATCH
+bool canThrowTogether(TrashType first, TrashType second);                // Check the interlock table for the two trashes passed
+void startDualThrow(TrashType first, uint8_t firstSeq, TrashType second, uint8_t secondSeq);  // Start two throws together
+uint8_t crc8(const uint8_t* data, uint8_t length);                       // CRC-8 of the bytes passed, for what is saved or sent
 bool isValidTrashType(TrashType trashToVerify);                          // Verifies that the incoming data from the Rpi4 is a valid number
-int getTrashFromPi();                                                    // Get the Serial input from Rpi4
+int getTrashFromPi();                                                    // Get the command sent by the Rpi4, if any
 void sendFeedbackToPi(int feedbackNumber);                               // Send the Serial feedback to Rpi4
 
 #endif /*CONFIG_H*/
@@ -0,0 +1,48 @@
+// Include feed header file
+#include "feed.h"
+#include "paddle.h"
+
+// DEFINE VARIABLES
+ul feedNeutralIntervals[2] = {0, 0};
+uint8_t feedLevel = FEED_NEUTRAL;
+static ul feedSetMillis = 0;  // Millis at which the last set-point has arrived
+
+// DEFINE FUNCTIONS
+// Must be called after the calibrated timings have been loaded
+void feedBegin(){
+  feedNeutralIntervals[0] = constrain(paddleGoingInterval, FEED_MIN_GOING, FEED_MAX_GOING);
+  feedNeutralIntervals[1] = constrain(paddleNotGoingInterval, FEED_MIN_NOT_GOING, FEED_MAX_NOT_GOING);
+  feedLevel = FEED_NEUTRAL;
+}
+
+// Millis between 'neutral' and 'slowest' (under FEED_NEUTRAL) or 'fastest' (over it) for the level passed
+static ul feedInterpolate(ul neutral, ul slowest, ul fastest, uint8_t level){
+  if (level < FEED_NEUTRAL) {
+    return (long)slowest + ((long)neutral - (long)slowest) * level / FEED_NEUTRAL;
+  }
+  return (long)neutral + ((long)fastest - (long)neutral) * (level - FEED_NEUTRAL) / (255 - FEED_NEUTRAL);
+}
+
+/*
+ The pulse gets longer and the pause shorter as the level goes up. A running paddle switches to the new
+ intervals at the end of its current period.
+*/
+void feedSet(uint8_t level){
+  feedLevel = level;
+  feedSetMillis = millis();
+  paddleGoingInterval = feedInterpolate(feedNeutralIntervals[0], FEED_MIN_GOING, FEED_MAX_GOING, level);
+  paddleNotGoingInterval = feedInterpolate(feedNeutralIntervals[1], FEED_MAX_NOT_GOING, FEED_MIN_NOT_GOING, level);
+  paddleUpdate();
+}
+
+// Without set-points the paddle must not be left at the last one, that may have been the fastest
+void feedTick(){
+  if (feedLevel != FEED_NEUTRAL && millis() - feedSetMillis >= FEED_TIMEOUT) {
+    feedSet(FEED_NEUTRAL);
+  }
+}
+
+// Returns the "going" part of the period, 255 meaning always going
+uint8_t feedDuty(){
+  return paddleGoingInterval * 255UL / (paddleGoingInterval + paddleNotGoingInterval);
+}
@@ -0,0 +1,138 @@
+// Include paddle header file
+#include "paddle.h"
+#include "battery.h"
+
+// DEFINE VARIABLES
+#if defined(ARDUINO_ARCH_MEGAAVR)
+static PORT_t* paddlePort;    // Port of the PADDLE_NPN pin, for turning it off from the interrupts
+static uint8_t paddleMask;    // Bit of the PADDLE_NPN pin in its port
+#else
+static volatile bool paddleOn = false;  // True while the pulses are going on
+static bool paddleGoing = false;        // True during the "going" part of the pulse
+static ul paddleSwitchMillis = 0;       // Millis at which 'paddleGoing' has changed the last time
+#endif
+static volatile bool paddleStopLine = false;  // True after a rising edge of PADDLE_STOP_PIN, until the loop() has seen it
+
+// DEFINE FUNCTIONS
+#if defined(ARDUINO_ARCH_MEGAAVR)
+// Timer ticks in the millis passed, TCA0 counts at F_CPU / 1024 (64 us at 16MHz, max ~4 seconds)
+static uint16_t paddleTicks(ul millisToConvert){
+  return (uint16_t)min(millisToConvert * (F_CPU / 1024UL) / 1000UL, 0xFFFFUL);
+}
+#endif
+
+// Interrupt of the fast stop line: nothing but register writes, the rest is left to the loop()
+static void paddleStopISR(){
+  paddleStop();
+  paddleStopLine = true;
+}
+
+/*
+ TCA0 runs in single slope mode: WO1 goes high when the count restarts from 0 and low when it reaches CMP1,
+ so every period of PER + 1 ticks is a "going" part of CMP1 ticks followed by the "not going" part.
+ The pulses reach the pin only while CMP1EN is set, otherwise the pin is the (low) PORT output.
+*/
+void paddleBegin(){
+  pinMode(PADDLE_NPN, OUTPUT);
+  digitalWrite(PADDLE_NPN, LOW);
+  pinMode(PADDLE_STOP_PIN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(PADDLE_STOP_PIN), paddleStopISR, RISING);
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  paddlePort = digitalPinToPortStruct(PADDLE_NPN);
+  paddleMask = digitalPinToBitMask(PADDLE_NPN);
+  TCA0.SINGLE.CTRLA = 0;  // The core has started it for analogWrite(), it must be stopped before being changed
+  TCA0.SINGLE.CTRLESET = TCA_SINGLE_CMD_RESET_gc;
+  TCA0.SINGLE.CTRLD = 0;  // Single 16 bit timer instead of the two 8 bit ones used by the core
+  PORTMUX.TCAROUTEA = (PORTMUX.TCAROUTEA & ~PORTMUX_TCA0_gm) | PORTMUX_TCA0_PORTE_gc;  // WO1 -> PE1 (D12)
+  TCA0.SINGLE.CTRLB = TCA_SINGLE_WGMODE_SINGLESLOPE_gc;  // Output not enabled yet
+  TCA0.SINGLE.CTRLA = TCA_SINGLE_CLKSEL_DIV1024_gc | TCA_SINGLE_ENABLE_bm;
+#endif
+}
+
+/*
+ The count is moved to the end of the period, so the first "going" part starts at the next tick
+ and not after a whole period. The intervals are read now, so the calibrated ones are used.
+*/
+void paddleStart(){
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  uint8_t sreg = SREG;
+  cli();  // 'paddleStop' may be called from an interrupt meanwhile
+  if (!(TCA0.SINGLE.CTRLB & TCA_SINGLE_CMP1EN_bm)) {
+    uint16_t goingTicks = paddleTicks(batteryScaled(paddleGoingInterval));
+    uint16_t periodTicks = paddleTicks(batteryScaled(paddleGoingInterval) + paddleNotGoingInterval);
+    TCA0.SINGLE.PER = periodTicks;
+    TCA0.SINGLE.CMP1 = goingTicks;
+    TCA0.SINGLE.CNT = periodTicks;
+    TCA0.SINGLE.CTRLB |= TCA_SINGLE_CMP1EN_bm;
+  }
+  SREG = sreg;
+#else
+  if (!paddleOn) {
+    paddleOn = true;
+    paddleGoing = true;
+    paddleSwitchMillis = millis();
+    digitalWrite(PADDLE_NPN, HIGH);
+  }
+#endif
+}
+
+/*
+ The buffered registers are copied by the timer at the end of the period, so the pulse that is going on
+ isn't cut. Without the timer 'paddleTick' reads the intervals at every switch anyway.
+*/
+void paddleUpdate(){
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  TCA0.SINGLE.PERBUF = paddleTicks(batteryScaled(paddleGoingInterval) + paddleNotGoingInterval);
+  TCA0.SINGLE.CMP1BUF = paddleTicks(batteryScaled(paddleGoingInterval));
+#endif
+}
+
+// Only register writes on the ATmega4809, so this can be called from any interrupt
+void paddleStop(){
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  uint8_t sreg = SREG;
+  cli();
+  TCA0.SINGLE.CTRLB &= ~TCA_SINGLE_CMP1EN_bm;  // The pin goes back to the PORT output...
+  paddlePort->OUTCLR = paddleMask;              // ...that is low
+  SREG = sreg;
+#else
+  paddleOn = false;
+  digitalWrite(PADDLE_NPN, LOW);
+#endif
+}
+
+// Returns true while the paddle's pulses are going on
+bool paddleRunning(){
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  return TCA0.SINGLE.CTRLB & TCA_SINGLE_CMP1EN_bm;
+#else
+  return paddleOn;
+#endif
+}
+
+/*
+ At each state of 'paddleGoing' corresponds a certain time interval ('paddleGoingInterval' or 'paddleNotGoingInterval').
+ When it has passed the state is switched and the pin follows it. With the timer there is nothing to do.
+*/
+void paddleTick(){
+#if !defined(ARDUINO_ARCH_MEGAAVR)
+  if (!paddleOn) {
+    return;
+  }
+  ul currentMillis = millis();  // Get current time
+  if (currentMillis - paddleSwitchMillis >= (paddleGoing ? batteryScaled(paddleGoingInterval) : paddleNotGoingInterval)) {
+    paddleSwitchMillis = currentMillis;  // Update the last time that the switch has happened
+    paddleGoing = !paddleGoing;
+    digitalWrite(PADDLE_NPN, paddleGoing ? HIGH : LOW);
+  }
+#endif
+}
+
+// Returns true if the fast stop line has stopped the paddle since the last call
+bool paddleStopRequested(){
+  if (!paddleStopLine) {
+    return false;
+  }
+  paddleStopLine = false;
+  return true;
+}
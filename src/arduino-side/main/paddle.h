@@ -0,0 +1,24 @@
+#ifndef PADDLE_H
+#define PADDLE_H
+#include "config.h"
+
+/*
+ The paddle's motor pushes the trashes with short pulses: 'paddleGoingInterval' millis on, 'paddleNotGoingInterval' millis off.
+ On the ATmega4809 the pulses are made by TCA0 on its WO1 output (routed to PE1, the PADDLE_NPN pin), so they don't
+ depend on the loop() at all. TCA0 is taken from the core, analogWrite() on pins 5, 9 and 10 can't be used anymore.
+ On the other boards 'paddleTick' makes the pulses with millis() from the loop().
+ The "going" pulse is scaled for the battery's voltage (see battery.h), the pause isn't.
+ A rising edge on PADDLE_STOP_PIN (the fast stop line of the Rpi4) stops the paddle from its interrupt, a few
+ microseconds later, without waiting for the serial link and the loop(); the loop() then handles it like a 9.
+*/
+
+// DECLEARING FUNCTIONS
+void paddleBegin();    // Prepare the paddle's pin (and the timer), the paddle is stopped
+void paddleStart();    // Start the pulses from the "going" one, does nothing if the paddle is already moving
+void paddleUpdate();   // Use the current intervals from the next period, if the paddle is moving
+void paddleStop();     // Stop the pulses and turn the paddle's motor off, it can be called also from an interrupt
+bool paddleRunning();  // True while the pulses are going on
+void paddleTick();     // Make the pulses without the timer, it must be called at every loop() pass
+bool paddleStopRequested();  // True (once) after the Rpi4 has stopped the paddle with the fast stop line
+
+#endif /*PADDLE_H*/
@@ -0,0 +1,76 @@
+// Include park header file
+#include "park.h"
+#include "hall.h"
+#include <EEPROM.h>
+#include <stddef.h>
+
+// DEFINE VARIABLES
+bool parkRestored = false;
+static bool parkStoredClean = false;  // True while the record in the EEPROM says the motors are parked
+static bool parkPending = false;      // True while the motors are parked but the record hasn't been marked clean yet
+static ul parkPendingMillis = 0;      // Millis at which the motors have been parked
+
+// DEFINE FUNCTIONS
+/*
+ The calibration at boot can be skipped only if the last throw has ended cleanly (the record says the motors
+ were parked and not moving when the power went off) and both the halls are reading their magnet right now.
+ If the motors were moving (crash, reset or power loss in the middle of a throw) the usual calibration is done.
+*/
+bool parkLoad(){
+  ParkRecord record;
+  EEPROM.get(PARK_ADDRESS, record);
+  if (record.version != PARK_VERSION || record.crc != crc8((const uint8_t*)&record, sizeof(record) - 1) || !record.clean) {
+    return false;
+  }
+  parkStoredClean = true;
+  if (hallCheck(DISK) || hallCheck(CROSS)) {
+    return false;  // At least one of them has been moved by hand
+  }
+  for (int i = 0; i < 2; i++) {
+    positionReset(i, record.positions[i]);
+  }
+  // The held trashes are still there, their timeouts start again from now
+  slotRing.head = 0;
+  slotRing.count = 0;
+  for (uint8_t i = 0; i < record.slotCount && i < SLOT_COUNT; i++) {
+    slotHold(TrashType(record.slots[i]));
+  }
+  parkRestored = true;
+  return true;
+}
+
+/*
+ Called with false when the motors start moving and with true when they are parked again. Only the clean flag is
+ written when they start moving, and only if the record is clean: its CRC doesn't match anymore, so the record is
+ ignored at boot. The whole record is written by 'parkTick' once they have been parked for PARK_IDLE_DELAY.
+ A stream of throws doesn't write the EEPROM at all, a pause costs a few bytes; if the power goes off before the
+ delay is over the calibration at boot is done, as after a crash.
+*/
+void parkSave(bool clean){
+  parkPending = clean;
+  parkPendingMillis = millis();
+  if (!clean && parkStoredClean) {
+    EEPROM.update(PARK_ADDRESS + offsetof(ParkRecord, clean), 0);
+    parkStoredClean = false;
+  }
+}
+
+// This must be called at every loop() pass, EEPROM.put only rewrites the bytes that have changed
+void parkTick(){
+  if (!parkPending || millis() - parkPendingMillis < PARK_IDLE_DELAY) {
+    return;
+  }
+  ParkRecord record;
+  record.version = PARK_VERSION;
+  record.clean = true;
+  record.positions[DISK] = axisPositions[DISK].position;
+  record.positions[CROSS] = axisPositions[CROSS].position;
+  record.slotCount = slotRing.count;
+  for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+    record.slots[i] = slotRing.items[(slotRing.head + i) % SLOT_COUNT];
+  }
+  record.crc = crc8((const uint8_t*)&record, sizeof(record) - 1);
+  EEPROM.put(PARK_ADDRESS, record);
+  parkStoredClean = true;
+  parkPending = false;
+}
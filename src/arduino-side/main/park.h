@@ -0,0 +1,29 @@
+#ifndef PARK_H
+#define PARK_H
+#include "config.h"
+#include "slots.h"
+#include "position.h"
+
+// DEFINITION
+#define PARK_VERSION 3   // Must be increased every time the ParkRecord changes
+#define PARK_ADDRESS 48  // EEPROM address of the ParkRecord (right after the CalibrationRecord)
+#define PARK_IDLE_DELAY 10000  // Millis the motors must stay parked before the record is marked clean again
+
+// PARK STRUCTS
+// Struct saved in the EEPROM, where Remate has been left by the last throw
+typedef struct {
+  uint8_t version;              // PARK_VERSION, a different one means the record must be ignored
+  uint8_t clean;                // 1 when the motors have been left parked on their magnets, 0 while they are moving
+  uint8_t slotCount;            // Number of trashes held when the motors have been parked
+  uint8_t slots[SLOT_COUNT];    // Classes of the trashes held, from the oldest
+  uint8_t positions[2];         // Positions of the disk and of the cross (see position.h)
+  uint8_t crc;                  // CRC-8 of all the bytes above
+} ParkRecord;
+extern bool parkRestored;       // True when the boot has skipped the calibration thanks to the ParkRecord
+
+// DECLEARING FUNCTIONS
+bool parkLoad();                // Restore the parked state, returns true if the calibration at boot can be skipped
+void parkSave(bool clean);      // Save whether the motors are parked (true) or moving (false)
+void parkTick();                // Write the parked state once the motors have been idle for PARK_IDLE_DELAY
+
+#endif /*PARK_H*/
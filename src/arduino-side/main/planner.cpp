@@ -0,0 +1,103 @@
+// Include planner header file
+#include "planner.h"
+#include "slots.h"
+
+// DEFINE FUNCTIONS
+// Adds the rotations passed to the last segment of the plan
+static void planMove(MotionPlan& plan, const int8_t steps[2]){
+  for (int i = 0; i < 2; i++) {
+    plan.segments[plan.count - 1].steps[i] += steps[i];
+  }
+}
+
+/*
+ Closes the last segment with a drop and opens a new one. Two drops without any rotation between them
+ are the same drop: the trashes have fallen together.
+*/
+static void planDump(MotionPlan& plan){
+  PlanSegment& last = plan.segments[plan.count - 1];
+  if (plan.count > 1 && last.steps[DISK] == 0 && last.steps[CROSS] == 0) {
+    return;  // Nothing has moved since the last drop
+  }
+  last.dump = true;
+  plan.segments[plan.count++] = {};  // There is room for it, a stroke has only one drop
+}
+
+// Appends the stroke passed: the way to the bin, the drop and the way back
+static void planStroke(MotionPlan& plan, const ThrowStroke& stroke){
+  planMove(plan, stroke.before);
+  if (stroke.dump) {
+    planDump(plan);
+  }
+  planMove(plan, stroke.after);
+}
+
+/*
+ Queues the moves of the plan in the motion job. In every segment the motors that have to rotate start together,
+ the drops become a pause of 'serialDelay' millis. After the last drop each motor goes to its nearest home position
+ (see position.h), and then the offset of each motor that has moved is adjusted in the direction opposite to its
+ last rotation, as 'throwPOM' does.
+*/
+static void planQueue(const MotionPlan& plan){
+  bool moved[2] = {false, false};
+  uint8_t lastDirection[2] = {CLOCKWISE, CLOCKWISE};
+  uint8_t positions[2] = {axisPositions[DISK].position, axisPositions[CROSS].position};
+  for (uint8_t s = 0; s < plan.count; s++) {
+    const PlanSegment& segment = plan.segments[s];
+    bool joined = false;
+    for (uint8_t motorIndex = 0; motorIndex < 2; motorIndex++) {
+      // The shortest rotation that brings the motor to the same magnet
+      uint8_t target = positionAfter(positions[motorIndex], segment.steps[motorIndex]);
+      if (s == plan.count - 1 && moved[motorIndex]) {
+        target = positionNearestHome(motorIndex, target);
+      }
+      int8_t steps = positionShortest(positions[motorIndex], target);
+      positions[motorIndex] = target;
+      if (steps == 0) {
+        continue;
+      }
+      if (joined) {
+        motionWithNext();  // Both the motors rotate in this segment, they start together
+      }
+      lastDirection[motorIndex] = (steps > 0) ? CLOCKWISE : COUNTER_CLOCKWISE;
+      moved[motorIndex] = true;
+      motionAddRotate(motorIndex, lastDirection[motorIndex], abs(steps));
+      joined = true;
+    }
+    if (segment.dump) {
+      motionAddWait(serialDelay);
+    }
+  }
+  bool joined = false;
+  for (uint8_t motorIndex = 0; motorIndex < 2; motorIndex++) {
+    if (!moved[motorIndex]) {
+      continue;
+    }
+    if (joined) {
+      motionWithNext();
+    }
+    uint8_t rotationDirection = !lastDirection[motorIndex];
+    motionAddOffsetReset(motorIndex, rotationDirection, offsetDelays[motorIndex][rotationDirection]);  // Adjusting the offset post-rotation
+    joined = true;
+  }
+}
+
+/*
+ Plans the trashes passed, in their order, and queues the moves in the motion job (which must have been cleared).
+ The paper follows its policy: it's parked or disposed together with the one already held (see slots.h).
+*/
+void planBatch(const uint8_t items[], uint8_t count){
+  MotionPlan plan = {};
+  plan.count = 1;
+  for (uint8_t i = 0; i < count && i < BATCH_MAX_ITEMS; i++) {
+    TrashType trashType = TrashType(items[i]);
+    if (trashType == TRASH_PAPER && slotDecide(TRASH_PAPER) == SLOT_HOLD) {
+      planStroke(plan, paperHoldStroke);
+      slotHold(TRASH_PAPER);
+    } else {
+      planStroke(plan, throwStrokes[trashType]);
+      slotRelease(trashType);
+    }
+  }
+  planQueue(plan);
+}
@@ -0,0 +1,41 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+#include "config.h"
+#include "motion.h"
+
+/*
+ The planner turns the list of trashes of a FRAME_BATCH into a single motion job. Every trash is seen as its
+ ThrowStroke (the rotations that bring it to its bin, then the ones that bring the motors back), and the strokes
+ are cut in segments at every drop in a bin. Inside a segment only the net rotation of each motor matters, so:
+ - the return of a trash and the way out of the next one are summed (a return is reused or cancelled),
+ - the disk and the cross move together, each one stopped by its own hall,
+ - a net rotation longer than half a turn is done the other way round.
+ The offsets are adjusted only once, at the end of the job.
+*/
+
+// DEFINITION
+#define BATCH_MAX_ITEMS 4                   // Max number of trashes in a FRAME_BATCH
+#define PLAN_MAX_SEGMENTS (BATCH_MAX_ITEMS + 1)  // A segment before each drop, plus the way back
+// Max number of steps a plan queues: two rotations in each segment, a pause at each drop and the two offsets at the end
+#define PLAN_MAX_STEPS (PLAN_MAX_SEGMENTS * 2 + BATCH_MAX_ITEMS + 2)
+#if PLAN_MAX_STEPS > MOTION_MAX_STEPS
+#error "The longest plan of a FRAME_BATCH doesn't fit in a motion job, increase MOTION_MAX_STEPS"
+#endif
+
+// PLANNER STRUCTS
+// Struct for the rotations of both the motors between two drops
+typedef struct {
+  int8_t steps[2];  // Hall to hall rotations of the disk (0) and the cross (1), > 0 clockwise and < 0 counter clockwise
+  bool dump;        // True if a trash falls in its bin at the end of this segment
+} PlanSegment;
+
+// Struct for the whole plan of a batch
+typedef struct {
+  PlanSegment segments[PLAN_MAX_SEGMENTS];
+  uint8_t count;    // Number of segments in the list
+} MotionPlan;
+
+// DECLEARING FUNCTIONS
+void planBatch(const uint8_t items[], uint8_t count);  // Plan the trashes passed and queue the moves in the motion job
+
+#endif /*PLANNER_H*/
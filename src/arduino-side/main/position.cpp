@@ -0,0 +1,67 @@
+// Include position header file
+#include "position.h"
+
+// DEFINE VARIABLES
+AxisPosition axisPositions[2] = {};
+#if defined(REMATE_INDEX_MAGNET)
+const bool positionHasIndex[2] = {true, false};  // The disk, whose bins are at fixed positions (the arms of the cross are all equal)
+#else
+const bool positionHasIndex[2] = {false, false};  // No index magnet is mounted, the count is never checked
+#endif
+/*
+ The disk has a single home, the bins are around it. The cross has four equal arms: the paper is parked with a quarter
+ turn that is never undone, so it can wait for the next trash on any of its magnets.
+*/
+const uint8_t positionHomes[2] = {
+  0x01,  // Disk
+  0x0F   // Cross
+};
+
+// DEFINE FUNCTIONS
+// Sets the position of the motor passed, after the calibration at boot or when restoring the parked state
+void positionReset(uint8_t motorIndex, uint8_t position){
+  axisPositions[motorIndex].position = position % MOTOR_POSITIONS;
+}
+
+/*
+ Called every time a rotation of the motor passed reaches a magnet. With an index magnet, reaching it means
+ being at POSITION_INDEX whatever the count says; not finding it there means the count is wrong, but not by how much.
+*/
+void positionPass(uint8_t motorIndex, uint8_t rotationDirection, bool indexMagnet){
+  AxisPosition& axis = axisPositions[motorIndex];
+  axis.passes[rotationDirection]++;
+  axis.position = positionAfter(axis.position, (rotationDirection == CLOCKWISE) ? 1 : -1);
+  if (!positionHasIndex[motorIndex] || indexMagnet == (axis.position == POSITION_INDEX)) {
+    return;
+  }
+  axis.indexErrors++;
+  if (indexMagnet) {
+    axis.position = POSITION_INDEX;
+  }
+}
+
+// Returns the position reached from the one passed after 'steps' rotations (> 0 clockwise)
+uint8_t positionAfter(uint8_t position, int8_t steps){
+  int8_t reached = (position + steps) % MOTOR_POSITIONS;
+  return (reached < 0) ? reached + MOTOR_POSITIONS : reached;
+}
+
+// Returns the rotations (> 0 clockwise, < 0 counter clockwise) of the shortest way between the positions passed
+int8_t positionShortest(uint8_t from, uint8_t to){
+  int8_t steps = positionAfter(to, -from);
+  return (steps > MOTOR_POSITIONS / 2) ? steps - MOTOR_POSITIONS : steps;
+}
+
+// Returns the home position of the motor passed that can be reached with the fewest rotations
+uint8_t positionNearestHome(uint8_t motorIndex, uint8_t from){
+  uint8_t nearest = from;
+  int8_t fewest = MOTOR_POSITIONS;
+  for (uint8_t position = 0; position < MOTOR_POSITIONS; position++) {
+    int8_t steps = abs(positionShortest(from, position));
+    if ((positionHomes[motorIndex] & (1 << position)) && steps < fewest) {
+      nearest = position;
+      fewest = steps;
+    }
+  }
+  return nearest;
+}
@@ -0,0 +1,35 @@
+#ifndef POSITION_H
+#define POSITION_H
+#include "config.h"
+
+/*
+ Absolute position of the disk and of the cross: the magnet (0 - MOTOR_POSITIONS-1) they are stopped on, 0 being
+ where they are after the calibration at boot. Every magnet reached by a rotation moves it by one, up when clockwise
+ and down when counter clockwise. A motor can have an index magnet at POSITION_INDEX, mounted the other way round
+ (its reading is under 'hallThresholdLow' while the others are over 'hallThresholdHigh'): every pass on it checks
+ the count and puts it right. Only the disk can have one, and only when built with REMATE_INDEX_MAGNET.
+*/
+
+// DEFINITION
+#define POSITION_INDEX 0     // Position of the index magnet
+#define POSITION_HOME 0xFF   // Target of a STEP_MOVE_TO that means "the nearest home position"
+
+// POSITION STRUCTS
+// Struct for the position of a motor
+typedef struct {
+  uint8_t position;     // Magnet the motor is on
+  uint8_t indexErrors;  // Times the count has disagreed with the index magnet
+  uint16_t passes[2];   // Magnets reached clockwise and counter clockwise since the boot
+} AxisPosition;
+extern AxisPosition axisPositions[2];   // Position of the disk (0) and of the cross (1)
+extern const bool positionHasIndex[2];  // True for the motors that have an index magnet
+extern const uint8_t positionHomes[2];  // Bit mask of the positions where each motor can wait for the next trash
+
+// DECLEARING FUNCTIONS
+void positionReset(uint8_t motorIndex, uint8_t position);                            // Set where the motor is
+void positionPass(uint8_t motorIndex, uint8_t rotationDirection, bool indexMagnet);  // Count a magnet reached by the motor
+uint8_t positionAfter(uint8_t position, int8_t steps);                                // Position reached after the rotations passed
+int8_t positionShortest(uint8_t from, uint8_t to);                                    // Shortest rotations (> 0 clockwise) between two positions
+uint8_t positionNearestHome(uint8_t motorIndex, uint8_t from);                        // Home position closest to the one passed
+
+#endif /*POSITION_H*/
@@ -0,0 +1,69 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+#include "config.h"
+
+/*
+ The throws are motion programs: a few instructions of two bytes (operation, argument) that are turned into the steps
+ of the motion job, which then runs them without blocking. The default programs are in 'motionPrograms' (flash), each
+ one can be replaced by a program uploaded by the Rpi4 with a FRAME_PROGRAM and saved in the EEPROM, so the sequences
+ can be tuned (and timed) without flashing Remate again. A program ends at its first OP_END or at PROGRAM_MAX_LENGTH.
+ Every move already ends on its own hall, so no instruction is needed for waiting for a magnet.
+*/
+
+// DEFINITION
+#define PROGRAM_MAX_LENGTH 24       // Max number of bytes of a program (12 instructions)
+#define PROGRAM_VERSION 1           // Must be increased every time the ProgramStore or the instructions change
+#define PROGRAM_ADDRESS 64          // EEPROM address of the ProgramStore (after the ParkRecord)
+#define PROGRAM_STORE_SIZE 64       // Bytes of EEPROM for the uploaded programs, from PROGRAM_ADDRESS
+#define PROGRAM_POSITION_HOME 0x7F  // Position of an OP_MOVE_TO that means POSITION_HOME
+
+// Macros for writing the instructions, each one is two bytes
+#define PROG_MOVE(motorIndex, rotationDirection, times) OP_MOVE, uint8_t((motorIndex) | (rotationDirection) << 1 | (times) << 2)
+#define PROG_MOVE_BOTH(rotationDirectionDisk, rotationDirectionCross) OP_MOVE_BOTH, uint8_t((rotationDirectionDisk) | (rotationDirectionCross) << 1)
+#define PROG_MOVE_TO(motorIndex, position) OP_MOVE_TO, uint8_t((motorIndex) | (position) << 1)
+#define PROG_SETTLE(tens) OP_SETTLE, uint8_t(tens)
+#define PROG_CORRECT(motorIndex) OP_CORRECT, uint8_t(motorIndex)
+#define PROG_TOGETHER OP_TOGETHER, 0
+#define PROG_HOLD(trashType) OP_SLOT, uint8_t((trashType) | 0x80)
+#define PROG_RELEASE(trashType) OP_SLOT, uint8_t(trashType)
+
+// Enum for the operations of the instructions, the argument of each one is explained here
+enum ProgramOperation {
+  OP_END = 0,        // End of the program
+  OP_MOVE = 1,       // Rotate a motor: bit 0 motor, bit 1 direction, bits 2-7 hall detections
+  OP_MOVE_BOTH = 2,  // Rotate both the motors together, once: bit 0 disk's direction, bit 1 cross's direction
+  OP_MOVE_TO = 3,    // Rotate a motor the shortest way to a position: bit 0 motor, bits 1-7 position (or PROGRAM_POSITION_HOME)
+  OP_SETTLE = 4,     // Pause, in tens of millis (0 -> 'serialDelay')
+  OP_CORRECT = 5,    // Adjust the offset of a motor against its last rotation: the motor
+  OP_TOGETHER = 6,   // The next move starts together with the last one, on the other motor: unused
+  OP_SLOT = 7,       // Hold (bit 7 set) or release the trashes of a class in their slots: bits 0-6 the class (see slots.h)
+};
+
+// Enum for the programs, the ones of the trashes thrown as a single move have the number of their TrashType
+enum MotionProgramId {
+  PROGRAM_PAPER = 1,          // The new paper and the held one are disposed together
+  PROGRAM_METAL = 2,
+  PROGRAM_PLASTIC = 3,
+  PROGRAM_UNSORTED = 4,
+  PROGRAM_PAPER_HOLD = 5,     // The new paper is parked in its slot
+  PROGRAM_PAPER_EXPIRED = 6,  // The held paper is disposed alone, because it has waited too long
+  PROGRAM_COUNT = 7,
+};
+
+// PROGRAM STRUCTS
+// Struct saved in the EEPROM with the uploaded programs, each one is: id, length, instructions
+typedef struct {
+  uint8_t version;                          // PROGRAM_VERSION, a different one means the store must be ignored
+  uint8_t used;                             // Bytes of 'data' in use
+  uint8_t data[PROGRAM_STORE_SIZE - 3];
+  uint8_t crc;                              // CRC-8 of all the bytes above
+} ProgramStore;
+extern const uint8_t motionPrograms[PROGRAM_COUNT][PROGRAM_MAX_LENGTH];  // Default programs, in flash
+
+// DECLEARING FUNCTIONS
+void programLoad();                                                    // Read the uploaded programs from the EEPROM
+bool programValid(const uint8_t* code, uint8_t length);                // Check a program before it's saved
+bool programSave(uint8_t programId, const uint8_t* code, uint8_t length);  // Save an uploaded program (length 0 -> back to the default)
+void programQueue(uint8_t programId);                                  // Queue the steps of a program in the motion job
+
+#endif /*PROGRAM_H*/
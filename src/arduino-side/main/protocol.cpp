@@ -0,0 +1,367 @@
+// Include protocol header file
+#include "protocol.h"
+#include "hall.h"
+#include "park.h"
+#include "battery.h"
+#include "telemetry.h"
+#include "recorder.h"
+#include "capture.h"
+
+// DEFINE VARIABLES
+FrameReceiver frameReceiver = {};
+PendingDone pendingDone[PENDING_DONE_SIZE] = {};
+CommandQueue commandQueue = {};
+
+// DEFINE FUNCTIONS
+// Sends a frame made of the header, the payload passed and the CRC-8
+void sendFrame(uint8_t type, uint8_t seq, const uint8_t* payload, uint8_t length){
+  uint8_t frame[FRAME_MAX_PAYLOAD + 5];
+  length = min(length, (uint8_t)FRAME_MAX_PAYLOAD);
+  frame[0] = FRAME_SYNC;
+  frame[1] = length;
+  frame[2] = type;
+  frame[3] = seq;
+  memcpy(frame + 4, payload, length);
+  frame[4 + length] = crc8(frame + 1, length + 3);
+  Serial.write(frame, length + 5);
+}
+
+/*
+ Sent when the boot is over and every time the Rpi4 sends a FRAME_HELLO, so the Rpi4 doesn't have
+ to guess when Remate is ready after a reset or after the Rpi4 itself has restarted.
+*/
+void sendReadyToPi(){
+  uint16_t capabilities = CAPABILITY_CALIBRATION | CAPABILITY_PARK | CAPABILITY_FEED | CAPABILITY_STOP_LINE;
+  if (hallMode == HALL_MODE_WINDOW) {
+    capabilities |= CAPABILITY_HALL_WINDOW;
+  }
+  if (parkRestored) {
+    capabilities |= CAPABILITY_PARK_RESTORED;
+  }
+  if (dualThrow) {
+    capabilities |= CAPABILITY_DUAL_THROW;
+  }
+  capabilities |= CAPABILITY_BATCH;
+  capabilities |= CAPABILITY_RECOVERY;
+  capabilities |= CAPABILITY_PROGRAM;
+  capabilities |= CAPABILITY_BATTERY;
+  capabilities |= CAPABILITY_TELEMETRY;
+  capabilities |= CAPABILITY_RECORDER;
+  capabilities |= CAPABILITY_CAPTURE;
+  // The size of the queue is how many commands the Rpi4 can send ahead, the capabilities that don't fit in a byte come last
+  uint8_t payload[4] = {PROTOCOL_VERSION, uint8_t(capabilities), COMMAND_QUEUE_SIZE, uint8_t(capabilities >> 8)};
+  sendFrame(FRAME_READY, 0, payload, sizeof(payload));
+}
+
+// Sends the FRAME_DONE (or FRAME_FAULT) passed, with the current length of the queue
+static void sendDone(const PendingDone& done){
+  if (done.type == FRAME_FAULT) {
+    uint8_t payload[4] = {done.fault.reason, done.fault.motorIndex, done.fault.position, commandQueue.count};
+    sendFrame(FRAME_FAULT, done.seq, payload, sizeof(payload));
+    return;
+  }
+  uint8_t payload[4] = {done.feedback, commandQueue.count, uint8_t(batteryMillivolts), uint8_t(batteryMillivolts >> 8)};
+  sendFrame(FRAME_DONE, done.seq, payload, sizeof(payload));
+}
+
+/*
+ The frame is kept until the Rpi4 sends its ACK, 'receiveCommand' sends it again meanwhile.
+ If all the slots are waiting, the one that has been sent the most times is given up.
+*/
+static PendingDone& pendingSlot(uint8_t type, uint8_t seq){
+  uint8_t slot = 0;
+  for (uint8_t i = 0; i < PENDING_DONE_SIZE; i++) {
+    if (!pendingDone[i].waiting) {
+      slot = i;
+      break;
+    }
+    if (pendingDone[i].retries > pendingDone[slot].retries) {
+      slot = i;
+    }
+  }
+  PendingDone& done = pendingDone[slot];
+  done.waiting = true;
+  done.type = type;
+  done.seq = seq;
+  done.retries = 0;
+  done.sentMillis = millis();
+  done.firstSentMicros = micros();
+  return done;
+}
+
+// Sends the FRAME_DONE of the command passed
+void sendDoneToPi(uint8_t seq, uint8_t feedback){
+  PendingDone& done = pendingSlot(FRAME_DONE, seq);
+  done.feedback = feedback;
+  recorderAdd(RECORD_DONE, seq, feedback, commandQueue.count);
+  sendDone(done);
+}
+
+// Sends the FRAME_FAULT of the command passed: it's over, but its trash may still be in the chamber
+void sendFaultToPi(uint8_t seq, const MotionFault& fault){
+  PendingDone& done = pendingSlot(FRAME_FAULT, seq);
+  done.fault = fault;
+  sendDone(done);
+}
+
+// Sends a FRAME_NACK with the reason passed
+static void sendNack(uint8_t seq, uint8_t reason){
+  sendFrame(FRAME_NACK, seq, &reason, 1);
+}
+
+// Appends a command to the queue (with the trashes of a TRASH_BATCH), false if it's full
+static bool pushCommand(TrashType command, uint8_t seq, const uint8_t* items, uint8_t itemCount){
+  if (commandQueue.count >= COMMAND_QUEUE_SIZE) {
+    return false;
+  }
+  QueuedCommand& queued = commandQueue.items[(commandQueue.head + commandQueue.count) % COMMAND_QUEUE_SIZE];
+  queued.command = command;
+  queued.seq = seq;
+  queued.itemCount = itemCount;
+  memcpy(queued.items, items, itemCount);
+  commandQueue.count++;
+  return true;
+}
+
+// True if the payload of a FRAME_BATCH is a list of trashes that can be planned
+static bool isValidBatch(const uint8_t* payload, uint8_t length){
+  if (length == 0 || length > BATCH_MAX_ITEMS) {
+    return false;
+  }
+  for (uint8_t i = 0; i < length; i++) {
+    if (payload[i] == TRASH_NONE || payload[i] > TRASH_UNSORTED) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ A command the Rpi4 sends again is a copy only if it has been accepted: a refused one (broken, or with the queue full)
+ is sent again after the newer ones, and must still be executed. Sequence numbers older than SEQ_WINDOW
+ are always taken as copies, the Rpi4 never has that many commands in flight.
+*/
+static bool isRepeated(uint8_t seq){
+  if (!frameReceiver.sessionStarted) {
+    return false;
+  }
+  uint8_t age = frameReceiver.newestSeq - seq;
+  if (age >= 128) {
+    return false;  // Newer than any accepted one
+  }
+  return age >= SEQ_WINDOW || (frameReceiver.acceptedSeqs & (1U << age));
+}
+
+// The command has been accepted, the ACK tells the Rpi4 how many commands are waiting
+static void acceptCommand(uint8_t seq){
+  FrameReceiver& rx = frameReceiver;
+  uint8_t age = rx.newestSeq - seq;
+  if (!rx.sessionStarted) {
+    rx.newestSeq = seq;
+    rx.acceptedSeqs = 1;
+  } else if (age >= 128) {  // The newest one, the window moves forward
+    uint8_t ahead = seq - rx.newestSeq;
+    rx.acceptedSeqs = (ahead >= SEQ_WINDOW) ? 1 : (uint16_t)(rx.acceptedSeqs << ahead) | 1;
+    rx.newestSeq = seq;
+  } else {
+    rx.acceptedSeqs |= 1U << age;  // An older one that had been refused
+  }
+  rx.sessionStarted = true;
+  rx.lastCommandSeq = seq;
+  sendFrame(FRAME_ACK, seq, &commandQueue.count, 1);
+}
+
+// Takes the oldest command of the queue, the loop() calls this every time the motors are free
+bool popCommand(QueuedCommand* queued){
+  if (commandQueue.count == 0) {
+    return false;
+  }
+  *queued = commandQueue.items[commandQueue.head];
+  commandQueue.head = (commandQueue.head + 1) % COMMAND_QUEUE_SIZE;
+  commandQueue.count--;
+  return true;
+}
+
+// Reads the oldest command of the queue without taking it, false if there is none
+bool peekCommand(QueuedCommand* queued){
+  if (commandQueue.count == 0) {
+    return false;
+  }
+  *queued = commandQueue.items[commandQueue.head];
+  return true;
+}
+
+// Sends the FRAME_DONE (or FRAME_FAULT) again if its ACK hasn't arrived in time
+static void retryDone(){
+  for (uint8_t i = 0; i < PENDING_DONE_SIZE; i++) {
+    PendingDone& done = pendingDone[i];
+    if (!done.waiting || millis() - done.sentMillis < FRAME_RETRY_DELAY) {
+      continue;
+    }
+    if (done.retries >= FRAME_MAX_RETRIES) {
+      done.waiting = false;  // The Rpi4 is gone, it will ask with a FRAME_HELLO when it's back
+      continue;
+    }
+    done.retries++;
+    done.sentMillis = millis();
+    sendDone(done);
+  }
+}
+
+/*
+ Handles a frame that has arrived whole and with the right CRC-8. Returns the command it carries,
+ TRASH_NONE if it isn't a new command (answers, questions and commands sent again because the ACK got lost).
+ The commands that move the motors are queued here, so that the ACK can tell the Rpi4 how many are waiting.
+*/
+static TrashType handleFrame(uint8_t type, uint8_t seq, const uint8_t* payload, uint8_t length){
+  switch (type) {
+    case FRAME_HELLO:
+      frameReceiver.sessionStarted = false;  // The Rpi4 restarts its sequence numbers
+      telemetryEnabled = false;  // Until the new session asks for it
+      if (!isBooting) {  // Otherwise the FRAME_READY is sent when the calibration at boot is over
+        sendReadyToPi();
+      }
+      break;
+    case FRAME_ACK:
+      for (uint8_t i = 0; i < PENDING_DONE_SIZE; i++) {
+        if (pendingDone[i].waiting && pendingDone[i].seq == seq) {
+          pendingDone[i].waiting = false;
+          telemetryRecord(TELEMETRY_FEEDBACK, TELEMETRY_NO_AXIS, seq, pendingDone[i].firstSentMicros, 0, 0, 0);
+        }
+      }
+      break;
+    case FRAME_COMMAND: {
+      TrashType command = (length == 1) ? TrashType(payload[0]) : TRASH_NONE;
+      if (!isValidTrashType(command)) {
+        sendNack(seq, NACK_UNKNOWN);
+        break;
+      }
+      if (isRepeated(seq)) {
+        sendFrame(FRAME_ACK, seq, &commandQueue.count, 1);  // Already received, only its ACK got lost
+        break;
+      }
+      if (command != TRASH_INCOMING && !pushCommand(command, seq, NULL, 0)) {
+        sendNack(seq, NACK_QUEUE_FULL);
+        break;
+      }
+      acceptCommand(seq);
+      return command;
+    }
+    case FRAME_BATCH:
+      if (!isValidBatch(payload, length)) {
+        sendNack(seq, NACK_INVALID);
+        break;
+      }
+      if (isRepeated(seq)) {
+        sendFrame(FRAME_ACK, seq, &commandQueue.count, 1);  // Already received, only its ACK got lost
+        break;
+      }
+      if (!pushCommand(TRASH_BATCH, seq, payload, length)) {
+        sendNack(seq, NACK_QUEUE_FULL);
+        break;
+      }
+      acceptCommand(seq);
+      return TRASH_BATCH;
+    case FRAME_PROGRAM:
+      // Saved right away, it's used from the next throw of its class (the running one is already in the motion job)
+      if (length == 0 || payload[0] == 0 || payload[0] >= PROGRAM_COUNT || !programValid(payload + 1, length - 1)
+          || !programSave(payload[0], payload + 1, length - 1)) {
+        sendNack(seq, NACK_INVALID);
+        break;
+      }
+      sendFrame(FRAME_ACK, seq, &commandQueue.count, 1);
+      break;
+    case FRAME_FEED: {
+      if (length != 1) {
+        sendNack(seq, NACK_UNKNOWN);
+        break;
+      }
+      feedSet(payload[0]);
+      // The ACK tells what the paddle is doing now: level, duty, "going" and "not going" millis, and the battery's voltage
+      uint8_t state[9] = {commandQueue.count, feedLevel, feedDuty(), uint8_t(paddleGoingInterval), uint8_t(paddleGoingInterval >> 8),
+                          uint8_t(paddleNotGoingInterval), uint8_t(paddleNotGoingInterval >> 8),
+                          uint8_t(batteryMillivolts), uint8_t(batteryMillivolts >> 8)};
+      sendFrame(FRAME_ACK, seq, state, sizeof(state));
+      break;
+    }
+    case FRAME_TELEMETRY_ON:
+      if (length != 1 || payload[0] > 1) {
+        sendNack(seq, NACK_UNKNOWN);
+        break;
+      }
+      telemetryEnabled = payload[0];
+      sendFrame(FRAME_ACK, seq, &commandQueue.count, 1);
+      break;
+    case FRAME_RECORDER_DUMP: {
+      // Only asked for after a reset, so it doesn't matter that the loop() waits for the serial buffer meanwhile
+      RecorderEntry entries[RECORDER_SLOTS];
+      uint8_t count = recorderRead(entries);
+      const uint8_t perFrame = FRAME_MAX_PAYLOAD / sizeof(RecorderEntry);
+      for (uint8_t i = 0; i < count; i += perFrame) {
+        sendFrame(FRAME_RECORDS, seq, (const uint8_t*)&entries[i], min(uint8_t(count - i), perFrame) * sizeof(RecorderEntry));
+      }
+      uint8_t answer[2] = {commandQueue.count, count};
+      sendFrame(FRAME_ACK, seq, answer, sizeof(answer));
+      break;
+    }
+    case FRAME_CAPTURE:
+      if (!captureValid(payload, length)) {
+        sendNack(seq, NACK_INVALID);
+        break;
+      }
+      if (isRepeated(seq)) {
+        sendFrame(FRAME_ACK, seq, &commandQueue.count, 1);  // Already received, only its ACK got lost
+        break;
+      }
+      if (!pushCommand(TRASH_CAPTURE, seq, payload, length)) {
+        sendNack(seq, NACK_QUEUE_FULL);
+        break;
+      }
+      acceptCommand(seq);
+      return TRASH_CAPTURE;
+    default:
+      sendNack(seq, NACK_UNKNOWN);
+      break;
+  }
+  return TRASH_NONE;
+}
+
+/*
+ Reads the bytes that have arrived from the Rpi4 without waiting for the missing ones: a frame can arrive
+ over several loop() passes. The bytes are stored by the core's USART interrupt meanwhile (SERIAL_RX_BUFFER_SIZE),
+ so nothing gets lost while the loop() is busy. Bytes that aren't part of a frame are skipped, broken frames get a FRAME_NACK.
+ When a new command arrives it's returned and the rest is read at the next pass.
+*/
+TrashType receiveCommand(){
+  retryDone();
+  FrameReceiver& rx = frameReceiver;
+  if (rx.received > 0 && millis() - rx.lastByteMillis >= FRAME_BYTE_TIMEOUT) {
+    rx.received = 0;  // The rest of the frame has never arrived
+  }
+  while (Serial.available() > 0) {
+    uint8_t byte = Serial.read();
+    rx.lastByteMillis = millis();
+    if (rx.received == 0 && byte != FRAME_SYNC) {
+      continue;  // Line noise
+    }
+    if (rx.received == 1 && byte > FRAME_MAX_PAYLOAD) {
+      rx.received = 0;  // Can't be a length, so that FRAME_SYNC was noise too
+      continue;
+    }
+    rx.buffer[rx.received++] = byte;
+    if (rx.received < 5 || rx.received < rx.buffer[1] + 5) {
+      continue;
+    }
+    rx.received = 0;  // The frame is complete
+    uint8_t length = rx.buffer[1];
+    if (crc8(rx.buffer + 1, length + 3) != rx.buffer[4 + length]) {
+      sendNack(rx.buffer[3], NACK_CRC);
+      continue;
+    }
+    TrashType command = handleFrame(rx.buffer[2], rx.buffer[3], rx.buffer + 4, length);
+    if (command != TRASH_NONE) {
+      return command;
+    }
+  }
+  return TRASH_NONE;
+}
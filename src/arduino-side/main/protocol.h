@@ -0,0 +1,128 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+#include "config.h"
+#include "planner.h"
+#include "program.h"
+#include "feed.h"
+
+// DEFINITION
+#define FRAME_SYNC 0xA5          // First byte of every binary frame, in both directions
+#define PROTOCOL_VERSION 11      // Must be increased every time the frames change
+#define FRAME_MAX_PAYLOAD 32     // Max number of bytes of payload in a frame (a FRAME_PROGRAM is the longest)
+#define FRAME_BYTE_TIMEOUT 50    // Millis without bytes after which a frame that has only partially arrived is dropped
+#define FRAME_RETRY_DELAY 200    // Millis to wait for the ACK of a FRAME_DONE before sending it again
+#define FRAME_MAX_RETRIES 5      // Times a FRAME_DONE is sent again before giving up
+#define COMMAND_QUEUE_SIZE 4     // Max number of commands waiting for the motors to be free
+#define SEQ_WINDOW 16            // Sequence numbers up to the newest one that are remembered as accepted (the bits of 'acceptedSeqs')
+#define PENDING_DONE_SIZE 2      // Max number of FRAME_DONE waiting for their ACK (a dual throw ends two commands together)
+
+/*
+ Enum for the types of the binary frames. Every frame is:
+ FRAME_SYNC, payload length, type, sequence number, payload, CRC-8 (of everything from the length to the end of the payload)
+*/
+enum FrameType {
+  FRAME_READY = 0x01,     // Arduino -> Rpi4: Remate can accept commands, payload: version, capabilities (low byte), COMMAND_QUEUE_SIZE,
+                          //   capabilities (high byte)
+  FRAME_ACK = 0x02,       // Both ways: the frame with this sequence number has arrived, payload (Arduino only): commands queued,
+                          //   for a FRAME_FEED also the feed level, the duty (0 - 255), the "going" and "not going" millis and the
+                          //   battery's millivolts (16 bits each)
+  FRAME_NACK = 0x03,      // Arduino -> Rpi4: the frame with this sequence number can't be accepted, payload: one of the NackReason values
+  FRAME_DONE = 0x04,      // Arduino -> Rpi4: the command with this sequence number is over, payload: feedback (42), commands queued,
+                          //   battery's millivolts (16 bits, 0 -> no battery monitor)
+  FRAME_FAULT = 0x05,     // Arduino -> Rpi4: the command with this sequence number (0 if it wasn't a command) has failed for a jam,
+                          //   payload: one of the MotionFaultReason values, motor, its position, commands queued
+  FRAME_TELEMETRY = 0x06, // Arduino -> Rpi4: timing of a phase that is over, no ACK, payload: a TelemetryRecord (see telemetry.h)
+  FRAME_RECORDS = 0x07,   // Arduino -> Rpi4: answer to a FRAME_RECORDER_DUMP, payload: up to 4 RecorderEntry (see recorder.h)
+  FRAME_CAPTURE_INFO = 0x08, // Arduino -> Rpi4: a capture is over, payload: motor, direction, interval, samples, trigger index,
+                          //   the 3 thresholds (16 bits little endian), index magnet, late samples (16 bits), HallMode, bytes per sample
+  FRAME_CAPTURE_DATA = 0x09, // Arduino -> Rpi4: samples of a capture, payload: index of the first one (16 bits), up to 10 samples (see capture.h)
+  FRAME_HELLO = 0x10,     // Rpi4 -> Arduino: asks for the FRAME_READY, a new Rpi4 session starts
+  FRAME_COMMAND = 0x11,   // Rpi4 -> Arduino: payload: one of the TrashType values
+  FRAME_BATCH = 0x12,     // Rpi4 -> Arduino: payload: the TrashType values of the trashes in the chamber (max BATCH_MAX_ITEMS)
+  FRAME_PROGRAM = 0x13,   // Rpi4 -> Arduino: payload: one of the MotionProgramId values, its instructions (none -> the default one)
+  FRAME_FEED = 0x14,      // Rpi4 -> Arduino: payload: feed level of the paddle, 0 (slowest) - 255 (fastest), see feed.h
+  FRAME_TELEMETRY_ON = 0x15, // Rpi4 -> Arduino: payload: 1 turns the FRAME_TELEMETRY on, 0 off
+  FRAME_RECORDER_DUMP = 0x16, // Rpi4 -> Arduino: asks for the flight recorder, it arrives in FRAME_RECORDS from the oldest entry,
+                          //   then the ACK has the number of entries after the commands queued
+  FRAME_CAPTURE = 0x17,   // Rpi4 -> Arduino: payload: motor, direction, micros between samples (16 bits), queued like a command,
+                          //   the FRAME_CAPTURE_INFO and FRAME_CAPTURE_DATA come before its FRAME_DONE
+};
+
+// Enum for the reasons of a FRAME_NACK
+enum NackReason {
+  NACK_CRC = 1,           // Broken frame, send it again
+  NACK_UNKNOWN = 2,       // Unknown frame type or command, sending it again is useless
+  NACK_QUEUE_FULL = 3,    // The command queue is full, send it again when a FRAME_DONE arrives
+  NACK_INVALID = 4,       // The program or the batch is invalid, or there is no room left for it, sending it again is useless
+};
+
+// Enum for the bits of the capabilities sent in the FRAME_READY
+enum Capability {
+  CAPABILITY_HALL_WINDOW = 0x01,   // The halls turn the motors off by interrupt
+  CAPABILITY_CALIBRATION = 0x02,   // The calibration routine (7) is available
+  CAPABILITY_PARK = 0x04,          // The parked state is saved in the EEPROM
+  CAPABILITY_PARK_RESTORED = 0x08, // The calibration at boot has been skipped thanks to the parked state
+  CAPABILITY_DUAL_THROW = 0x10,    // Two queued trashes may be thrown together, their FRAME_DONE arrive together
+  CAPABILITY_BATCH = 0x20,         // The FRAME_BATCH is accepted
+  CAPABILITY_RECOVERY = 0x40,      // A jam is recovered from (see recovery.h), a FRAME_FAULT may arrive instead of the FRAME_DONE
+  CAPABILITY_PROGRAM = 0x80,       // The FRAME_PROGRAM is accepted
+  CAPABILITY_FEED = 0x100,         // The FRAME_FEED is accepted
+  CAPABILITY_STOP_LINE = 0x200,    // The paddle can be stopped with the fast stop line (PADDLE_STOP_PIN) instead of a 9
+  CAPABILITY_BATTERY = 0x400,      // The timings follow the battery's voltage, that is sent in the FRAME_DONE (see battery.h)
+  CAPABILITY_TELEMETRY = 0x800,    // The FRAME_TELEMETRY_ON is accepted
+  CAPABILITY_RECORDER = 0x1000,    // The FRAME_RECORDER_DUMP is accepted
+  CAPABILITY_CAPTURE = 0x2000,     // The FRAME_CAPTURE is accepted
+};
+
+// PROTOCOL STRUCTS
+// Struct for the frame that is being received from the Rpi4
+typedef struct {
+  uint8_t buffer[FRAME_MAX_PAYLOAD + 5];  // Bytes received so far, starting from FRAME_SYNC
+  uint8_t received;                       // Number of bytes in the buffer
+  ul lastByteMillis;                      // Millis at which the last byte has arrived
+  bool sessionStarted;                    // False until the first command of this Rpi4 session, the seqs below aren't valid yet
+  uint8_t lastCommandSeq;                 // Sequence number of the last command accepted (the one 'receiveCommand' has returned)
+  uint8_t newestSeq;                      // Highest sequence number accepted (wrapping at 255)
+  uint16_t acceptedSeqs;                  // Bit i set -> the command 'newestSeq' - i has been accepted, for ignoring the ones sent again
+} FrameReceiver;
+
+// Struct for a command waiting for the motors to be free
+typedef struct {
+  TrashType command;                // Trash to throw, TRASH_CALIBRATE, TRASH_BATCH or TRASH_CAPTURE
+  uint8_t seq;                      // Sequence number, sent back in the FRAME_DONE
+  uint8_t items[BATCH_MAX_ITEMS];   // Trashes of a TRASH_BATCH, in the order they have been sent (the request of a TRASH_CAPTURE)
+  uint8_t itemCount;                // Number of trashes in 'items'
+} QueuedCommand;
+
+// Struct for the ring of the commands waiting for the motors to be free, in the order they have arrived
+typedef struct {
+  QueuedCommand items[COMMAND_QUEUE_SIZE];
+  uint8_t head;       // Index of the oldest command
+  uint8_t count;      // Number of commands in the ring
+} CommandQueue;
+
+// Struct for the FRAME_DONE (or FRAME_FAULT) waiting for the ACK of the Rpi4
+typedef struct {
+  bool waiting;      // True until the ACK arrives or FRAME_MAX_RETRIES is reached
+  uint8_t type;      // FRAME_DONE or FRAME_FAULT
+  uint8_t seq;       // Sequence number of the command that is over
+  uint8_t feedback;  // Feedback sent in the payload of a FRAME_DONE
+  MotionFault fault; // What has stopped the command of a FRAME_FAULT
+  uint8_t retries;   // Times the frame has been sent again
+  ul sentMillis;     // Millis at which the frame has been sent the last time
+  ul firstSentMicros; // Micros at which the frame has been sent the first time, for the telemetry
+} PendingDone;
+extern FrameReceiver frameReceiver;
+extern PendingDone pendingDone[PENDING_DONE_SIZE];
+extern CommandQueue commandQueue;
+
+// DECLEARING FUNCTIONS
+void sendFrame(uint8_t type, uint8_t seq, const uint8_t* payload, uint8_t length);  // Send a binary frame to the Rpi4
+void sendReadyToPi();                                                                // Send the FRAME_READY to the Rpi4
+void sendDoneToPi(uint8_t seq, uint8_t feedback);                                    // Send the FRAME_DONE, again until the ACK arrives
+void sendFaultToPi(uint8_t seq, const MotionFault& fault);                           // Send the FRAME_FAULT, again until the ACK arrives
+TrashType receiveCommand();                                                          // Read the Rpi4, returns a new command (TRASH_NONE if none)
+bool popCommand(QueuedCommand* queued);                                              // Take the oldest queued command, false if there is none
+bool peekCommand(QueuedCommand* queued);                                             // Read the oldest queued command without taking it
+
+#endif /*PROTOCOL_H*/
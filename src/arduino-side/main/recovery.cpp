@@ -0,0 +1,52 @@
+// Include recovery header file
+#include "recovery.h"
+#include "motion.h"
+#include "planner.h"
+#include "protocol.h"
+#include "calibration.h"
+#include "capture.h"
+
+// DEFINE VARIABLES
+bool recoveryFallback = false;
+
+// DEFINE FUNCTIONS
+/*
+ Ends what has got stuck without recovering it, the Rpi4 gets a FRAME_FAULT for each of its commands (a flush isn't
+ a command, its FRAME_FAULT has 0 as sequence number). The ParkRecord still says that the motors are moving,
+ so if Remate is reset the calibration at boot isn't skipped.
+*/
+static void recoveryGiveUp(const MotionFault& fault){
+  if (isThrowing) {
+    sendFaultToPi(throwSeq, fault);
+    if (dualTrash != TRASH_NONE) {
+      sendFaultToPi(dualSeq, fault);
+    }
+  } else {
+    sendFaultToPi(0, fault);
+  }
+  recoveryFallback = false;
+  calibrationState.running = false;
+  isThrowing = false;
+  isFlushing = false;
+  trash = TRASH_NONE;
+  dualTrash = TRASH_NONE;
+}
+
+/*
+ Must be called when 'motionFaulted' is true. The first time a throw gets stuck its trashes are sent to the unsorted
+ bin with a planned job (the motor that has got stuck may be anywhere, the planner starts from the positions counted
+ so far); a second jam, a flush, the calibration or a capture are given up.
+*/
+bool recoverFault(){
+  MotionFault fault = motionJob.fault;
+  motionClear();  // The fault is handled only once
+  if (!isThrowing || calibrationState.running || captureRunning() || recoveryFallback || trash == TRASH_UNSORTED) {
+    recoveryGiveUp(fault);
+    return false;
+  }
+  const uint8_t items[1] = {TRASH_UNSORTED};
+  recoveryFallback = true;
+  planBatch(items, 1);
+  motionStart();
+  return true;
+}
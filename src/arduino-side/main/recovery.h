@@ -0,0 +1,20 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+#include "config.h"
+
+/*
+ Recovery from a jam. The motion job already tries to free a stuck motor by itself: a rotation that doesn't leave
+ its magnet or doesn't reach the next one within its time budget is jogged back and retried (see motion.h).
+ When that isn't enough the job is aborted, and then:
+ 1. the trashes of the throw are disposed in the unsorted bin, the Rpi4 gets 'feedbackUnsorted' in the FRAME_DONE,
+ 2. if that gets stuck too (or what got stuck wasn't a throw), the Rpi4 gets a FRAME_FAULT instead of the FRAME_DONE.
+ Either way Remate goes on with the next queued command: a jam costs a few seconds instead of a power cycle.
+*/
+
+// DEFINE VARIABLES
+extern bool recoveryFallback;  // True while the trashes of a jammed throw are being disposed in the unsorted bin
+
+// DECLEARING FUNCTIONS
+bool recoverFault();           // Handle the job aborted by a jam, returns true if a recovery job has been started
+
+#endif /*RECOVERY_H*/
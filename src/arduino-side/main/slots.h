@@ -0,0 +1,46 @@
+#ifndef SLOTS_H
+#define SLOTS_H
+#include "config.h"
+
+/*
+ Some trashes aren't disposed as soon as they arrive: they are parked in a holding slot and disposed later together
+ with the next ones of the same class, with a single combined move (see 'throwPaper'). The slots are a ring: holding
+ and releasing only move 'head' and 'count', nothing is shifted. What to do with each trash is decided by 'slotDecide'
+ following the 'slotPolicies' table.
+*/
+
+// DEFINITION
+#define SLOT_COUNT 4  // Max number of trashes held at the same time, whatever their class
+
+// Enum for what has to be done with a trash that has arrived
+enum SlotDecision {
+  SLOT_DIRECT = 0,  // Disposed right away, this class is never held
+  SLOT_HOLD = 1,    // Parked in a free slot, it will be disposed together with the next ones
+  SLOT_FLUSH = 2,   // The held trashes of its class and this one are disposed together
+};
+
+// SLOTS STRUCTS
+// Struct for the policy of a trash class
+typedef struct {
+  uint8_t maxHeld;  // Max trashes of this class that can wait in the slots, 0 -> never held
+  ul holdTimeout;   // Millis after which the held trashes of this class are disposed anyway, 0 -> never
+} SlotPolicy;
+extern const SlotPolicy slotPolicies[TRASH_UNSORTED + 1];  // Policy of each trash class
+
+// Struct for the ring of the holding slots, in the order the trashes have arrived
+typedef struct {
+  TrashType items[SLOT_COUNT];  // Class of the trash in each slot
+  ul heldMillis[SLOT_COUNT];    // Millis at which each trash has been parked
+  uint8_t head;                 // Index of the oldest trash
+  uint8_t count;                // Number of trashes held
+} SlotRing;
+extern SlotRing slotRing;
+
+// DECLEARING FUNCTIONS
+SlotDecision slotDecide(TrashType trashType);  // What has to be done with the trash passed, following its policy
+uint8_t slotHeld(TrashType trashType);         // Number of trashes of the class passed that are held
+void slotHold(TrashType trashType);            // Park a trash of the class passed in the next slot
+void slotRelease(TrashType trashType);         // Free all the slots of the class passed, its trashes have been disposed
+bool slotExpired(TrashType* trashType);        // True if a held trash has waited longer than its 'holdTimeout'
+
+#endif /*SLOTS_H*/
@@ -1,3 +1,8 @@
 #!/bin/bash
-arduino-cli compile --fqbn arduino:megaavr:nona4809 main.ino
+# ./upload.sh for the relays' board, ./upload.sh transistor for the NPN/PNP one (see the board profiles in drivers.h)
+FLAGS=""
+if [ "$1" = "transistor" ]; then
+  FLAGS="-DREMATE_BOARD_TRANSISTOR"
+fi
+arduino-cli compile --fqbn arduino:megaavr:nona4809 --build-property "compiler.cpp.extra_flags=$FLAGS" main.ino
 arduino-cli upload --fqbn arduino:megaavr:nona4809 -p /dev/cu.usbmodem1201 --verbose
@@ -0,0 +1,39 @@
+#ifndef BATTERY_H
+#define BATTERY_H
+#include "config.h"
+
+/*
+ Voltage of the 12V lead-acid battery, read on BATTERY_PIN through a divider and filtered. A DC motor turns about as
+ fast as its voltage, so as the battery goes down the same millis move the disk, the cross and the paddle less.
+ The timings are tuned (by hand or by the calibration) at 'batteryNominal' millivolts: the time-based ones are
+ scaled by nominal / measured, so they keep moving the motors by the same amount from a full battery to a low one.
+ Only the times that depend on the speed alone are scaled: 'rotationDelay', 'departMinDelay' and the paddle's "going"
+ pulse. The offset adjustments aren't: a slower motor also overshoots the magnet less, the two cancel out.
+ The rotation budget follows the battery by itself, since 'travelMillis' is learned at every rotation.
+ On the transistor board the step down regulators already keep the motors' voltage, only the paddle is scaled.
+ Without a battery on the pin (or without a nominal voltage) nothing is scaled.
+*/
+
+// DEFINITION
+#define BATTERY_REFERENCE_MV 5000      // ADC reference (VDD), in millivolts
+#define BATTERY_DIVIDER_X10 57         // (R1 + R2) / R2 of the divider, times 10: 47k over 10k, 14.6V -> 2.56V
+#define BATTERY_SAMPLE_INTERVAL 50     // Millis between two samples
+#define BATTERY_FILTER_SHIFT 4         // Every sample moves the filter by 1/16 of the difference (~1 second with the interval above)
+#define BATTERY_NOMINAL_MV 12700       // Full battery at rest, used until a calibration saves the voltage it has been done at
+#define BATTERY_MIN_MV 6000            // Under this there is no battery on the pin (or it's flat, the timings can't help anyway)
+#define BATTERY_SCALE_ONE 1024         // Scale of the timings at the nominal voltage
+#define BATTERY_MIN_SCALE 870          // Shortest timings allowed (~0.85, battery over the nominal voltage while charging)
+#define BATTERY_MAX_SCALE 1536         // Longest timings allowed (1.5)
+#define BATTERY_UPDATE_STEP 8          // Change of the scale after which the running paddle takes the new "going" pulse
+
+// DEFINE VARIABLES
+extern uint16_t batteryNominal;        // Millivolts at which the timings have been tuned, 0 -> not known
+extern uint16_t batteryMillivolts;     // Filtered voltage of the battery, 0 -> no battery
+
+// DECLEARING FUNCTIONS
+void batteryBegin();                   // Take the first sample, the filter starts from it
+void batteryTick();                    // Take a sample every BATTERY_SAMPLE_INTERVAL millis and update the scale
+ul batteryScaled(ul tunedMillis);      // The millis passed, tuned at 'batteryNominal', for the voltage measured now
+ul batteryMotorScaled(ul tunedMillis); // Same as 'batteryScaled' for the disk and the cross, unless their voltage is regulated
+
+#endif /*BATTERY_H*/
@@ -0,0 +1,48 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+#include "config.h"
+
+// DEFINITION
+#define CALIBRATION_VERSION 3      // Must be increased every time the CalibrationRecord changes
+#define CALIBRATION_ADDRESS 0      // EEPROM address of the CalibrationRecord
+#define CALIBRATION_MAX_PAIRS 8    // Max number of clockwise + counter clockwise trials for each motor
+#define CALIBRATION_GOOD_TRIALS 2  // Consecutive adjustments that must end on the magnet before the value is kept
+#define CALIBRATION_FIRST_STEP 40  // Millis by which an adjustment is changed after the first wrong trial
+#define CALIBRATION_MAX_OFFSET 400 // Longest offset adjustment allowed, in millis
+#define CALIBRATION_MIN_STEP 5     // Millis under which the change isn't halved anymore
+
+// CALIBRATION STRUCTS
+// Struct saved in the EEPROM, all the timings that can change from a Remate to another
+typedef struct {
+  uint8_t version;                 // CALIBRATION_VERSION, a different one means the record must be ignored
+  uint8_t board;                   // BoardVariant the timings have been tuned on, a different one means the record must be ignored
+  uint16_t serialDelay;
+  uint16_t rotationDelay;
+  uint16_t departMinDelay;
+  uint16_t paddleGoingInterval;
+  uint16_t paddleNotGoingInterval;
+  uint16_t offsetDelays[2][2];
+  uint16_t travelMillis[2][2];
+  uint16_t batteryNominal;         // Millivolts of the battery when these timings have been tuned (see battery.h)
+  uint8_t crc;                     // CRC-8 of all the bytes above
+} CalibrationRecord;
+
+// Struct for the state of the calibration routine
+typedef struct {
+  bool running;                    // True while the calibration is moving the motors
+  uint8_t motorIndex;              // Motor being calibrated
+  uint8_t rotationDirection;       // Direction of the rotation of the current trial
+  uint8_t pairs;                   // Clockwise + counter clockwise trials done for this motor
+  uint8_t good[2];                 // Consecutive adjustments ended on the magnet, for each direction of the adjustment
+  uint8_t step[2];                 // Millis by which the adjustment is changed when wrong, for each direction
+  int8_t lastChange[2];            // Sign of the last change of the adjustment, for each direction
+} CalibrationState;
+extern CalibrationState calibrationState;
+
+// DECLEARING FUNCTIONS
+bool calibrationLoad();            // Load the timings saved in the EEPROM, returns false if there aren't valid ones
+void calibrationSave();            // Save the current timings in the EEPROM
+void calibrationStart(uint8_t seq); // Start the calibration routine, the motors must be free
+bool calibrationTick();            // Queue the next trial when the motors are free, returns true while calibrating
+
+#endif /*CALIBRATION_H*/
@@ -0,0 +1,244 @@
+#ifndef DRIVERS_H
+#define DRIVERS_H
+#include "config.h"
+
+// DEFINITION
+#define MOTOR_FULL_DUTY 255        // Duty of the regulators at full speed (the speed of the relays' motors)
+#define MOTOR_PWM_STEPS 16         // Steps of a period of the regulators' software PWM (see drivers.cpp)
+#define MOTOR_PWM_STEP_MICROS 125  // Micros of each step, so a period lasts 2 millis
+
+/*
+ Compile-time drivers for the motors' pins. Every pin is a type (Pin<port, bit>) and every motor is a type
+ made of its pins, so a toggle is a single sbi/cbi on the VPORT registers of the ATmega4809 instead of
+ a digitalWrite() with its table lookups. Which motors are built is chosen by the board profile (see config.h).
+ On the other boards the pins fall back to digitalWrite(), so the same code runs everywhere.
+*/
+
+// Ports of the ATmega4809, in the order of the VPORT registers
+enum PinPort {
+  PIN_PORT_A = 0,
+  PIN_PORT_B = 1,
+  PIN_PORT_C = 2,
+  PIN_PORT_D = 3,
+  PIN_PORT_E = 4,
+  PIN_PORT_F = 5,
+};
+
+/*
+ Port and bit of each pin of the Nano Every (D0 - D13, then A0 - A7), packed as port * 8 + bit.
+ String literals can be indexed in a constexpr, so this table costs nothing at run time.
+*/
+#define NANO_EVERY_PIN_COUNT 22
+constexpr uint8_t nanoEveryPortBit(uint8_t pin){
+  return (uint8_t)"\x15\x14\x00\x2D\x16\x0A\x2C\x01\x23\x08\x09\x20\x21\x22\x1B\x1A\x19\x18\x2A\x2B\x1C\x1D"[pin];
+}
+constexpr uint8_t nanoEveryPort(uint8_t pin){
+  return nanoEveryPortBit(pin) >> 3;
+}
+constexpr uint8_t nanoEveryBit(uint8_t pin){
+  return nanoEveryPortBit(pin) & 7;
+}
+// Arduino number of the pin on the port and bit passed (the other way round), only needed without the VPORTs
+constexpr uint8_t nanoEveryPinNumber(uint8_t port, uint8_t bit, uint8_t pin = 0){
+  return (pin >= NANO_EVERY_PIN_COUNT || nanoEveryPortBit(pin) == port * 8 + bit) ? pin : nanoEveryPinNumber(port, bit, pin + 1);
+}
+
+// A single output pin, every function is a single instruction on the ATmega4809
+template<uint8_t port, uint8_t bit>
+struct Pin {
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  static VPORT_t& vport(){ return (&VPORTA)[port]; }
+  static void output(){ vport().DIR |= (1 << bit); }
+  static void high(){ vport().OUT |= (1 << bit); }
+  static void low(){ vport().OUT &= ~(1 << bit); }
+  static bool read(){ return vport().IN & (1 << bit); }
+#else
+  static const uint8_t number = nanoEveryPinNumber(port, bit);
+  static void output(){ pinMode(number, OUTPUT); }
+  static void high(){ digitalWrite(number, HIGH); }
+  static void low(){ digitalWrite(number, LOW); }
+  static bool read(){ return digitalRead(number); }
+#endif
+  static void write(bool value){
+    if (value) {
+      high();
+    } else {
+      low();
+    }
+  }
+};
+
+// The Pin of the Arduino pin number passed, so the pins can keep being defined with their usual numbers
+template<uint8_t number>
+using ArduinoPin = Pin<nanoEveryPort(number), nanoEveryBit(number)>;
+
+/*
+ Motor driven by two relays: COUNTER_PIN = direction and CLOCK_PIN = !direction, both LOW is off.
+ The relay that is going off is always switched first. Relays can't brake, so 'halt' is the same as 'off'.
+*/
+template<class CounterPin, class ClockPin>
+struct RelayMotor {
+  static void begin(){
+    CounterPin::output();
+    ClockPin::output();
+    off();
+  }
+  static void drive(uint8_t rotationDirection){
+    if (rotationDirection == COUNTER_CLOCKWISE) {
+      ClockPin::low();
+      CounterPin::high();
+    } else {
+      CounterPin::low();
+      ClockPin::high();
+    }
+  }
+  static void off(){
+    CounterPin::low();
+    ClockPin::low();
+  }
+  static void halt(){
+    off();
+  }
+  static void speed(uint8_t duty){
+    (void)duty;  // The relays' motors get the battery's voltage, their speed can't be changed
+  }
+  static void pwmStep(uint8_t step){
+    (void)step;
+  }
+};
+
+/*
+ Motor driven by an H-bridge of NPN (low side) and PNP (high side) transistors, with a step down regulator.
+ Everything is turned off before a direction is turned on, so the two sides of the bridge are never on together.
+ 'halt' is the active brake: both the low side transistors on, the motor is shorted and stops in a few millis.
+ 'speed' sets the duty of the regulator. On the ATmega4809 the regulators' pins have no free timer (pin 11 has
+ none, the TCA0 of pin 10 belongs to the paddle), so the duty is a software PWM made by 'pwmStep' from the
+ interrupt of drivers.cpp: the regulator is on for the first 'pwmOnSteps' steps of each period.
+*/
+template<class ClockNpn, class ClockPnp, class CounterNpn, class CounterPnp, class Regulator>
+struct HBridgeMotor {
+  static void begin(){
+    ClockNpn::output();
+    ClockPnp::output();
+    CounterNpn::output();
+    CounterPnp::output();
+    off();
+    Regulator::output();
+    speed(MOTOR_FULL_DUTY);
+  }
+  static void drive(uint8_t rotationDirection){
+    off();
+    if (rotationDirection == CLOCKWISE) {
+      ClockPnp::high();
+      ClockNpn::high();
+    } else {
+      CounterPnp::high();
+      CounterNpn::high();
+    }
+  }
+  static void off(){
+    ClockNpn::low();
+    ClockPnp::low();
+    CounterNpn::low();
+    CounterPnp::low();
+  }
+  static void halt(){
+    ClockPnp::low();
+    CounterPnp::low();
+    ClockNpn::high();
+    CounterNpn::high();
+  }
+  static volatile uint8_t pwmOnSteps;  // Steps of each period in which the regulator is on (MOTOR_PWM_STEPS: always on)
+  static void speed(uint8_t duty){
+#if defined(ARDUINO_ARCH_MEGAAVR)
+    pwmOnSteps = ((uint16_t)duty * MOTOR_PWM_STEPS + 255) / 256;
+    if (pwmOnSteps == MOTOR_PWM_STEPS) {
+      Regulator::high();  // The interrupt leaves it alone
+    }
+#else
+    analogWrite(Regulator::number, duty);
+#endif
+  }
+  static void pwmStep(uint8_t step){
+    if (pwmOnSteps < MOTOR_PWM_STEPS) {
+      Regulator::write(step < pwmOnSteps);
+    }
+  }
+};
+template<class ClockNpn, class ClockPnp, class CounterNpn, class CounterPnp, class Regulator>
+volatile uint8_t HBridgeMotor<ClockNpn, ClockPnp, CounterNpn, CounterPnp, Regulator>::pwmOnSteps = MOTOR_PWM_STEPS;
+
+// BOARD PROFILES
+template<BoardVariant variant>
+struct BoardProfile;
+
+// Relays, the default
+template<>
+struct BoardProfile<BOARD_RELAY> {
+  static const bool brakes = false;     // 'halt' lets the motors coast
+  static const bool regulated = false;  // 'speed' does nothing
+  typedef RelayMotor<ArduinoPin<COUNTER_DISK_PIN>, ArduinoPin<CLOCK_DISK_PIN>> DiskMotor;
+  typedef RelayMotor<ArduinoPin<COUNTER_CROSS_PIN>, ArduinoPin<CLOCK_CROSS_PIN>> CrossMotor;
+};
+
+// NPN/PNP transistors, built with -DREMATE_BOARD_TRANSISTOR (see upload.sh)
+template<>
+struct BoardProfile<BOARD_TRANSISTOR> {
+  static const bool brakes = true;
+  static const bool regulated = true;
+  typedef HBridgeMotor<ArduinoPin<CLOCK_DISK_NPN>, ArduinoPin<CLOCK_DISK_PNP>, ArduinoPin<COUNTER_DISK_NPN>,
+                       ArduinoPin<COUNTER_DISK_PNP>, ArduinoPin<DISK_MOTOR_REGULATOR>> DiskMotor;
+  typedef HBridgeMotor<ArduinoPin<CLOCK_CROSS_NPN>, ArduinoPin<CLOCK_CROSS_PNP>, ArduinoPin<COUNTER_CROSS_NPN>,
+                       ArduinoPin<COUNTER_CROSS_PNP>, ArduinoPin<CROSS_MOTOR_REGULATOR>> CrossMotor;
+};
+
+typedef BoardProfile<boardVariant> Board;  // The profile this firmware is built for
+
+void motorsPwmBegin();  // Start the timer of the regulators' software PWM (see drivers.cpp)
+
+// Motor functions by index, the switch is on a value that is almost always known when inlined
+static inline void motorsBegin(){
+  Board::DiskMotor::begin();
+  Board::CrossMotor::begin();
+  if (Board::regulated) {
+    motorsPwmBegin();
+  }
+}
+
+// Makes the motor passed rotate in the direction passed
+static inline void motorDrive(uint8_t motorIndex, uint8_t rotationDirection){
+  if (motorIndex == DISK) {
+    Board::DiskMotor::drive(rotationDirection);
+  } else {
+    Board::CrossMotor::drive(rotationDirection);
+  }
+}
+
+// Lets the motor passed coast
+static inline void motorOff(uint8_t motorIndex){
+  if (motorIndex == DISK) {
+    Board::DiskMotor::off();
+  } else {
+    Board::CrossMotor::off();
+  }
+}
+
+// Stops the motor passed as fast as the board can (brakes it if possible), it may be called from the interrupts
+static inline void motorHalt(uint8_t motorIndex){
+  if (motorIndex == DISK) {
+    Board::DiskMotor::halt();
+  } else {
+    Board::CrossMotor::halt();
+  }
+}
+
+// Sets the speed of the motor passed (MOTOR_FULL_DUTY is full speed), only where the board has the regulators
+static inline void motorSpeed(uint8_t motorIndex, uint8_t duty){
+  if (motorIndex == DISK) {
+    Board::DiskMotor::speed(duty);
+  } else {
+    Board::CrossMotor::speed(duty);
+  }
+}
+
+#endif /*DRIVERS_H*/
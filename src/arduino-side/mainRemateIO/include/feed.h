@@ -0,0 +1,30 @@
+#ifndef FEED_H
+#define FEED_H
+#include "config.h"
+
+/*
+ Feed rate of the paddle, set by the Rpi4 with a FRAME_FEED from what the camera sees: faster when the chute is empty,
+ slower when more than one trash is in view. The set-point is a level from 0 (slowest) to 255 (fastest), FEED_NEUTRAL
+ being the calibrated intervals. Both the "going" pulse and the pause are moved, always inside the bounds below.
+ Without set-points for FEED_TIMEOUT millis (the Rpi4 is gone) the calibrated intervals are used again.
+*/
+
+// DEFINITION
+#define FEED_NEUTRAL 128          // Level of the calibrated intervals
+#define FEED_MIN_GOING 30UL       // Shortest "going" pulse, in millis (under it the paddle doesn't even start)
+#define FEED_MAX_GOING 150UL      // Longest "going" pulse, in millis
+#define FEED_MIN_NOT_GOING 400UL  // Shortest pause between two pulses, in millis
+#define FEED_MAX_NOT_GOING 3000UL // Longest pause between two pulses, in millis
+#define FEED_TIMEOUT 10000        // Millis without set-points after which the calibrated intervals are used again
+
+// DEFINE VARIABLES
+extern ul feedNeutralIntervals[2];  // 'paddleGoingInterval' and 'paddleNotGoingInterval' as calibrated
+extern uint8_t feedLevel;           // Level in use
+
+// DECLEARING FUNCTIONS
+void feedBegin();                   // Save the calibrated intervals, they are the ones of FEED_NEUTRAL
+void feedSet(uint8_t level);        // Apply a set-point of the Rpi4
+void feedTick();                    // Go back to the calibrated intervals if the set-points have stopped
+uint8_t feedDuty();                 // Part of the period in which the paddle is moving (0 - 255)
+
+#endif /*FEED_H*/
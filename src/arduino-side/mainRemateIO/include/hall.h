@@ -0,0 +1,77 @@
+#ifndef HALL_H
+#define HALL_H
+#include "config.h"
+
+/*
+ The halls read HALL_NOMINAL_BASELINE without a magnet only in theory: the supply, the temperature and the distance from
+ the magnets move it. So the reading without a magnet (the baseline) is learned from the readings themselves, and the
+ thresholds follow it: a magnet is there when the reading is beyond the baseline by the margins of 'hallThresholdLow'
+ and 'hallThresholdHigh' (given for HALL_NOMINAL_BASELINE), it has moved away once back inside by 'hallHysteresis'.
+ Every reading is the median of the last three (on the ATmega4809 each of them is the sum of 1 << HALL_OVERSAMPLE_SHIFT conversions, shifted back),
+ so a single spike can neither stop a motor nor be taken as a departure.
+*/
+
+// DEFINITION
+#define HALL_NOMINAL_BASELINE 512    // Reading without a magnet the thresholds in config.cpp are given for
+#define HALL_BASELINE_SHIFT 4        // The baseline moves by 1/16 of the difference at every sample
+#define HALL_BASELINE_INTERVAL 20    // Millis between two samples of the baseline
+#define HALL_BASELINE_MAX_DRIFT 80   // Max distance of the baseline from HALL_NOMINAL_BASELINE, beyond this a hall is broken
+#define HALL_OVERSAMPLE_SHIFT 2      // The ADC accumulates 1 << this conversions for a reading of a watched hall (ATmega4809 only)
+
+// Enum for the ways in which a magnet can be detected
+enum HallMode {
+  HALL_MODE_POLL = 0,    // analogRead() at every loop() pass, through 'hallUpdate'
+  HALL_MODE_WINDOW = 1,  // ADC conversions handled by interrupts, with the window comparator (ATmega4809 only)
+};
+
+// Enum for what a hall is waiting for
+enum HallWatch {
+  HALL_WATCH_NONE = 0,   // The hall isn't being read
+  HALL_WATCH_ENTRY = 1,  // Waiting for a magnet to arrive, the motor gets turned off when it does
+  HALL_WATCH_EXIT = 2,   // Waiting for the magnet to move away from the hall
+};
+
+// HALL STRUCTS
+// Struct for the state of a hall while it is being watched
+typedef struct {
+  volatile uint8_t watch;     // One of the HallWatch values
+  volatile bool magnetSeen;   // True once the magnet has been read while waiting for it to move away
+  volatile bool detected;     // True once the magnet has arrived
+  volatile bool departed;     // True once the magnet has moved away
+  volatile ul entryMicros;    // Micros at which the magnet has arrived
+  volatile bool entryIndex;   // True if the magnet that has arrived is under 'entryLow' (an index magnet, see position.h)
+  volatile ul exitMicros;     // Micros at which the magnet has moved away
+  volatile uint16_t entryReading;  // Reading that has found the magnet, 0 if it hasn't arrived since the hall has been armed
+  volatile uint16_t exitReading;   // Reading that has seen the magnet go, 0 if it hasn't moved away since the hall has been armed
+  volatile uint16_t recent[2];     // The two readings before the last one, for the median
+  volatile uint16_t lastReading;   // Last filtered reading
+  volatile bool fresh;             // True if 'lastReading' hasn't been taken by the baseline yet
+  volatile bool confirming;        // True while a reading outside the window waits for the next one (HALL_MODE_WINDOW only)
+} HallEvent;
+extern volatile HallEvent hallEvents[2];  // Events of the disk's (0) and the cross's (1) hall
+
+// Struct for the thresholds of a hall, moved with its baseline
+typedef struct {
+  volatile uint16_t baseline;   // Learned reading without a magnet
+  volatile uint16_t entryLow;   // The magnet has arrived when the reading is <= this (an index magnet)...
+  volatile uint16_t entryHigh;  // ... or >= this
+  volatile uint16_t exitLow;    // The magnet has moved away when the reading is > this...
+  volatile uint16_t exitHigh;   // ... and < this
+} HallThresholds;
+extern volatile HallThresholds hallThresholds[2];  // Thresholds of the disk's (0) and the cross's (1) hall
+extern uint8_t hallMode;                  // One of the HallMode values, chosen at boot
+
+// DECLEARING FUNCTIONS
+void hallBegin();                          // Prepare the ADC and the motors' pins for the interrupts
+void hallArm(uint8_t motorIndex);          // Start waiting for a magnet, the motor gets turned off when it arrives
+void hallArmDeparture(uint8_t motorIndex); // Start waiting for the magnet to move away from the hall
+void hallDisarm(uint8_t motorIndex);       // Stop watching the hall
+void hallUpdate();                         // Read the watched halls (HALL_MODE_POLL only)
+void hallTick();                           // Follow the baseline of the halls, it must be called at every loop() pass
+bool hallCheck(uint8_t motorIndex);        // Read the hall of the motor passed, false if it's on a magnet
+bool hallDetected(uint8_t motorIndex);     // True once the magnet has arrived since 'hallArm'
+bool hallDeparted(uint8_t motorIndex);     // True once the magnet has moved away since 'hallArmDeparture'
+bool hallIdle();                           // True while no hall is watched, analogRead() can be used
+void hallCapture(bool on);                 // Give every reading of both the halls to the capture (see capture.h)
+
+#endif /*HALL_H*/
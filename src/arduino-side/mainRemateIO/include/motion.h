@@ -0,0 +1,112 @@
+#ifndef MOTION_H
+#define MOTION_H
+#include "config.h"
+#include "hall.h"
+#include "position.h"
+
+// DEFINITION
+#define MOTION_MAX_STEPS 16    // Max number of steps a single motion job can hold (a planned batch is the longest, see PLAN_MAX_STEPS)
+#define MOTION_SETTLE_DELAY 200  // Millis for letting the cross or disk stop before adjusting the offset
+#define MOTION_JOG_DELAY 250     // Millis of the reverse jog that tries to free a stuck motor
+#define MOTION_BRAKE_DELAY 80    // Millis of active braking at the end of a rotation, where the board can brake (see drivers.h)
+#define MOTION_APPROACH_DUTY 128   // Regulator's duty while getting close to the next magnet, where the board has the regulators
+#define MOTION_APPROACH_MARGIN 150 // Millis (at full speed) before the learned arrival at which the motor slows down
+#define MOTION_MAX_RETRIES 2     // Reverse jogs (each followed by a retry) before giving up on a rotation
+#define MOTION_BUDGET_FACTOR 2   // A rotation may last up to this many times its learned 'travelMillis'...
+#define MOTION_BUDGET_MARGIN 300 // ...plus these millis
+#define MOTION_BUDGET_DEFAULT 4000  // Millis allowed for a rotation whose travel time hasn't been learned yet
+
+// Enum for the kind of steps a motion job is made of
+enum MotionStepType {
+  STEP_ROTATE = 0,       // Rotate one motor for a number of hall detections
+  STEP_OFFSET_RESET = 1, // Let the motor stop and then adjust its offset with a short pulse (nothing where the brake needs no adjustment)
+  STEP_WAIT = 2,         // Wait without moving anything
+  STEP_MOVE_TO = 3,      // Rotate one motor the shortest way to a position (see position.h)
+};
+
+// Enum for the phase in which each motor is during a step
+enum AxisPhase {
+  AXIS_IDLE = 0,     // The motor is off and has nothing to do
+  AXIS_DEPART = 1,   // Moving the magnet away from the hall
+  AXIS_SEEK = 2,     // Moving until the hall detects the next magnet
+  AXIS_SETTLE = 3,   // Motor off, waiting for the cross or disk to stop moving
+  AXIS_OFFSET = 4,   // Short pulse for adjusting the offset
+  AXIS_JOG = 5,      // Short rotation the other way round, for freeing a stuck motor before retrying
+  AXIS_BRAKE = 9,    // Motor braked after the last magnet, then left off (6 - 8 are the telemetry's, see telemetry.h)
+  AXIS_APPROACH = 10, // Like AXIS_SEEK, but slowed down because the next magnet is close
+};
+
+// Enum for the reason why a motion job has been aborted
+enum MotionFaultReason {
+  FAULT_NONE = 0,     // The job hasn't been aborted
+  FAULT_STALL = 1,    // The magnet never left the hall: the motor didn't move at all
+  FAULT_TIMEOUT = 2,  // The next magnet wasn't reached within the time budget of the rotation
+};
+
+// MOTION STRUCTS
+/*
+ Struct for a single step of a motion job. Steps joined with 'withNext' make a group: they all start together,
+ each on its own motor and with its own stop condition, and the job goes on when all of them are over.
+*/
+typedef struct {
+  uint8_t type;               // One of the MotionStepType values
+  uint8_t motorIndex;         // DISK or CROSS (for STEP_WAIT this is unused)
+  uint8_t rotationDirection;  // Direction of the motor (for STEP_OFFSET_RESET after a STEP_MOVE_TO it's chosen when the step starts)
+  uint8_t param;              // Times for STEP_ROTATE, position for STEP_MOVE_TO, 1 for a STEP_OFFSET_RESET after the last rotation
+  bool withNext;              // True if the next step starts together with this one, on the other motor
+  ul duration;                // Millis for STEP_OFFSET_RESET and STEP_WAIT
+} MotionStep;
+
+// Struct for the state of the disk's or the cross's motor while a step is running
+typedef struct {
+  uint8_t phase;              // One of the AxisPhase values
+  uint8_t rotationDirection;  // Direction in which the motor is moving
+  uint8_t lastRotation;       // Direction of the last rotation towards a magnet (offset adjustments excluded)
+  uint8_t timesLeft;          // Hall detections still needed before the step is over
+  ul phaseStart;              // Millis at which the current phase has started
+  ul phaseDuration;           // Millis that the current phase lasts (only for timed phases)
+  ul phaseStartMicros;        // Micros at which the current phase has started, for the telemetry
+  ul moveStartMicros;         // Micros at which the current rotation has started, for measuring 'travelMillis'
+  ul offsetDelay;             // Millis of the offset adjustment of the running STEP_OFFSET_RESET
+  uint8_t retries;            // Reverse jogs done during the running step
+  bool adjusted;              // True while 'hallEvents' of the motor are the ones of its last offset adjustment
+  bool behind;                // True if the magnet is behind the running rotation, in case the motor is off it (see 'magnetBehind')
+} AxisState;
+
+// Struct for what has stopped an aborted motion job
+typedef struct {
+  uint8_t reason;      // One of the MotionFaultReason values
+  uint8_t motorIndex;  // DISK or CROSS, the motor that got stuck
+  uint8_t position;    // Position of the motor when it got stuck (the last magnet it has reached)
+} MotionFault;
+
+// Struct for the whole sequence of steps of a throw
+typedef struct {
+  MotionStep steps[MOTION_MAX_STEPS];  // Steps to execute in order
+  uint8_t count;                       // Number of steps in the list
+  uint8_t current;                     // Index of the first step of the group that is running
+  uint8_t groupEnd;                    // Index of the last step of the group that is running
+  bool running;                        // True while the job has steps to execute
+  ul waitStart;                        // Millis at which the current STEP_WAIT has started
+  ul waitStartMicros;                  // Same in micros, for the telemetry
+  AxisState axis[2];                   // State of the disk's (0) and the cross's (1) motor
+  MotionFault fault;                   // Why the job has been aborted (FAULT_NONE if it hasn't)
+} MotionJob;
+extern MotionJob motionJob;  // The only motion job, advanced by 'motionTick' from the loop()
+
+// DECLEARING FUNCTIONS
+void driveMotor(uint8_t motorIndex, uint8_t rotationDirection);  // Make the motor rotate in the direction passed
+void motionClear();                                                // Empty the job, it must not be running
+void motionAddRotate(uint8_t motorIndex, uint8_t rotationDirection, uint8_t times);  // Queue a rotation of a single motor
+void motionAddRotateSIM(uint8_t rotationDirectionDisk, uint8_t rotationDirectionCross);  // Queue a simultaneous rotation
+void motionAddOffsetReset(uint8_t motorIndex, uint8_t rotationDirection, ul movementDelay);  // Queue an offset adjustment
+void motionAddOffsetResetLast(uint8_t motorIndex);                 // Queue an offset adjustment against the last rotation
+void motionAddMoveTo(uint8_t motorIndex, uint8_t position);        // Queue a rotation to a position (or POSITION_HOME)
+void motionAddWait(ul waitDelay);                                  // Queue a pause
+void motionWithNext();                                             // Make the last queued step start together with the next one
+void motionStart();                                                // Start executing the queued steps
+bool motionTick();                                                 // Advance the job, returns true while it is running
+bool motionBusy();                                                 // True while the job is running
+bool motionFaulted();                                              // True if the last job has been aborted by a stuck motor
+
+#endif /*MOTION_H*/
@@ -0,0 +1,53 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+#include "config.h"
+
+/*
+ Flight recorder: the faults and the boots (with the reason of the reset: a brown-out, the watchdog...) survive
+ in the EEPROM, so a jam or a stall can be looked at afterwards instead of being reproduced. The routine events,
+ the commands (with the battery's voltage), the hall timings of the rotations, the jogs and the FRAME_DONE, happen
+ several times a throw: they only go round a RAM history of RECORDER_HISTORY_SIZE entries, and the ones still there
+ are written right before the next fault (or boot) so it comes with what has led to it. A throw that goes well
+ writes nothing.
+ The events to write are queued in RAM and written to the EEPROM a byte at a time, only when the EEPROM isn't busy, so the
+ loop() never waits for it. The EEPROM region is a ring of RECORDER_SLOTS entries written one after the other,
+ so every byte is worn the same. Each entry has a stamp one more than the entry before it: after a reset the newest
+ entry is the one the next slot doesn't follow. The stamp is cleared first and written last, so an entry cut by the
+ reset is never read.
+ The Rpi4 reads the ring with a FRAME_RECORDER_DUMP.
+*/
+
+// DEFINITION
+#define RECORDER_ADDRESS 128      // EEPROM address of the ring (right after the ProgramStore), up to the end of the EEPROM
+#define RECORDER_SLOTS 16         // Entries of the ring
+#define RECORDER_QUEUE_SIZE 8     // Max number of events waiting in RAM to be written
+#define RECORDER_HISTORY_SIZE 7   // Routine events kept in RAM for the next fault (it has to fit in the queue with them)
+#define RECORDER_LAST_STAMP 254   // Stamps go from 1 to this, 0 and 0xFF (erased EEPROM) are never valid
+
+// Enum for the events of the recorder
+enum RecorderEvent {
+  RECORD_BOOT = 1,     // Written, arg: reset flags (RSTCTRL.RSTFR, 0 when unknown), value: battery's millivolts
+  RECORD_COMMAND = 2,  // Routine, arg: sequence number (0 for the fast stop line), aux: TrashType, value: battery's millivolts
+  RECORD_PHASE = 3,    // Routine, arg: motor, aux: AxisPhase (depart, seek or jog), value: millis it has lasted
+  RECORD_FAULT = 4,    // Written, arg: MotionFaultReason, aux: motor, value: its position
+  RECORD_DONE = 5,     // Routine, arg: sequence number, aux: feedback, value: commands queued
+};
+
+// RECORDER STRUCTS
+// Struct for an entry of the ring, as it's saved in the EEPROM
+typedef struct {
+  uint8_t stamp;    // One more than the stamp of the entry before (RECORDER_LAST_STAMP is followed by 1)
+  uint8_t type;     // One of the RecorderEvent values
+  uint8_t arg;      // Depends on the type, see RecorderEvent
+  uint8_t aux;
+  uint16_t millis;  // Low 16 bits of millis() when the event happened
+  uint16_t value;
+} RecorderEntry;
+
+// DECLEARING FUNCTIONS
+void recorderBegin();                                                         // Find the newest entry and record the boot
+void recorderAdd(uint8_t type, uint8_t arg, uint8_t aux, uint16_t value);     // Record an event, see RecorderEvent
+void recorderTick();                                                          // Write the next byte of the queued events
+uint8_t recorderRead(RecorderEntry entries[RECORDER_SLOTS]);                  // Read the ring from the oldest entry, returns how many
+
+#endif /*RECORDER_H*/
@@ -0,0 +1,59 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+#include "config.h"
+
+/*
+ Timing telemetry of the throws, for finding where the seconds of a sort go. Every phase of a motor (and the wait for
+ the class after a 9, the pauses of the jobs and the round trip of the FRAME_DONE) leaves a record when it's over.
+ The records wait in a small ring and are sent as FRAME_TELEMETRY only when the serial buffer has room for them,
+ so the loop() never waits for the Rpi4: when the ring is full the new records are lost (and counted).
+ The telemetry is off until the Rpi4 turns it on with a FRAME_TELEMETRY_ON, and off again at every FRAME_HELLO.
+*/
+
+// DEFINITION
+#define TELEMETRY_QUEUE_SIZE 8     // Max number of records waiting to be sent
+#define TELEMETRY_RECORD_SIZE 26   // Bytes of payload of a FRAME_TELEMETRY
+#define TELEMETRY_TX_MARGIN 8      // Bytes of the serial buffer always left to the other frames
+#define TELEMETRY_NO_AXIS 0xFF     // Axis of the records that aren't about a motor
+
+// Enum for the phases of the records, the ones of a motor have the same values as its AxisPhase (see motion.h)
+enum TelemetryPhase {
+  TELEMETRY_DEPART = 1,      // The magnet moving away from the hall
+  TELEMETRY_SEEK = 2,        // Rotation up to the next magnet
+  TELEMETRY_SETTLE = 3,      // Motor off, waiting for the cross or disk to stop
+  TELEMETRY_CORRECT = 4,     // Offset adjustment
+  TELEMETRY_JOG = 5,         // Reverse jog of a stuck motor
+  TELEMETRY_PAUSE = 6,       // Pause of the job (STEP_WAIT), no axis
+  TELEMETRY_WAIT_CLASS = 7,  // From the 9 to the defined trash (or to the timeout), no axis
+  TELEMETRY_FEEDBACK = 8,    // From the FRAME_DONE (or FRAME_FAULT) to its ACK, no axis
+  TELEMETRY_BRAKE = 9,       // Active brake at the end of a rotation (transistor board)
+  TELEMETRY_APPROACH = 10,   // Last part of the rotation, slowed down (transistor board)
+};
+
+// TELEMETRY STRUCTS
+// Struct for a record, sent little endian in this order
+typedef struct {
+  ul startMicros;         // Micros at which the phase has started
+  ul durationMicros;      // How long it has lasted
+  uint8_t seq;            // Sequence number of the command it belongs to, 0 if none
+  uint8_t phase;          // One of the TelemetryPhase values
+  uint8_t axis;           // DISK, CROSS or TELEMETRY_NO_AXIS
+  uint16_t hallEntry;     // Hall reading that has found the magnet during the phase, 0 if none
+  uint16_t hallExit;      // Hall reading that has seen the magnet go during the phase, 0 if none
+  ul overshootMicros;     // Settle only: micros the cross or disk has coasted on before leaving the magnet, 0 if it stopped on it
+  uint8_t lost;           // Records lost before this one because the ring was full (up to 255)
+  uint16_t hallBaseline;  // Baseline of the axis' hall when the phase was over (see hall.h), 0 if no axis
+  uint16_t hallLow;       // Its 'entryLow' threshold, 0 if no axis
+  uint16_t hallHigh;      // Its 'entryHigh' threshold, 0 if no axis
+} TelemetryRecord;
+
+// DEFINE VARIABLES
+extern bool telemetryEnabled;  // True after the Rpi4 has turned the telemetry on
+
+// DECLEARING FUNCTIONS
+void telemetryRecord(uint8_t phase, uint8_t axis, uint8_t seq, ul startMicros,
+                     uint16_t hallEntry, uint16_t hallExit, ul overshootMicros);  // Queue a record of a phase that is over now
+uint8_t telemetrySeq(uint8_t motorIndex);  // Sequence number of the command the motor passed is moving for
+void telemetryTick();                      // Send the queued records the serial buffer has room for
+
+#endif /*TELEMETRY_H*/
@@ -0,0 +1,92 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ Simulated Arduino core of the 'native' environment (see sim.h). Only what the firmware uses is here, and every call
+ that takes time on the Nano Every (analogRead(), digitalWrite(), delay(), a full serial buffer) moves the simulated
+ clock by about as much, so the firmware sees the same timings it would see on the board.
+ There are no real interrupts: the interrupt handlers are called by the simulation between two calls of the core,
+ so noInterrupts() and interrupts() have nothing to do.
+*/
+
+// DEFINITION
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+// Pins of the Nano Every
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+#define NUM_DIGITAL_PINS 22
+#define F_CPU 16000000UL
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 64
+#endif
+#define SERIAL_TX_BUFFER_SIZE 64
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// Class for the serial port: the bytes go to and come from the simulated Rpi4 (see sim.h) at 115200 baud
+class SimSerial {
+public:
+  void begin(unsigned long baud);
+  int available();
+  int peek();
+  int read();
+  int availableForWrite();
+  size_t write(uint8_t value);
+  size_t write(const uint8_t* buffer, size_t size);
+  void flush();
+  operator bool() { return true; }
+};
+extern SimSerial Serial;
+
+// Same templates as the ArduinoCore-API, the values passed can have different types
+template<class T, class L>
+auto min(const T& a, const L& b) -> decltype((b < a) ? b : a) {
+  return (b < a) ? b : a;
+}
+template<class T, class L>
+auto max(const T& a, const L& b) -> decltype((b < a) ? b : a) {
+  return (a < b) ? b : a;
+}
+template<class T, class L, class H>
+auto constrain(const T& amt, const L& low, const H& high) -> decltype((amt < low) ? low : ((amt > high) ? high : amt)) {
+  return (amt < low) ? low : ((amt > high) ? high : amt);
+}
+
+// DECLEARING FUNCTIONS
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+void attachInterrupt(uint8_t interruptNumber, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interruptNumber);
+static inline uint8_t digitalPinToInterrupt(uint8_t pin){ return pin; }  // Every pin of the ATmega4809 has its interrupt
+static inline void noInterrupts(){}
+static inline void interrupts(){}
+
+#endif /*ARDUINO_H*/
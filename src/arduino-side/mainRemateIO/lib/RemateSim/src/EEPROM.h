@@ -0,0 +1,47 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+#include <Arduino.h>
+
+/*
+ Simulated EEPROM of the ATmega4809, erased (0xFF) at every start of the simulation unless it's kept in a file
+ (see 'eepromPath' in sim.h), so a run can start where the previous one has left the parked state and the recorder.
+ Every write is counted for its cell, so the wear of a stream of throws can be checked; as on the megaAVR core,
+ update() and put() skip the bytes that already have the value.
+*/
+
+// DEFINITION
+#define EEPROM_SIZE 256
+
+// Class with the same calls as the EEPROM library of the megaAVR core
+class EEPROMClass {
+public:
+  uint8_t bytes[EEPROM_SIZE];
+  uint32_t writes[EEPROM_SIZE];  // Times each cell has been written since 'simBegin'
+  uint8_t read(int address) { return bytes[address]; }
+  void write(int address, uint8_t value) {
+    bytes[address] = value;
+    writes[address]++;
+  }
+  void update(int address, uint8_t value) {
+    if (bytes[address] != value) {
+      write(address, value);
+    }
+  }
+  uint8_t operator[](int address) { return bytes[address]; }
+  uint16_t length() { return EEPROM_SIZE; }
+  template<typename T>
+  T& get(int address, T& value) {
+    memcpy(&value, &bytes[address], sizeof(T));
+    return value;
+  }
+  template<typename T>
+  const T& put(int address, const T& value) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+      update(address + i, ((const uint8_t*)&value)[i]);
+    }
+    return value;
+  }
+};
+extern EEPROMClass EEPROM;
+
+#endif /*EEPROM_H*/
@@ -0,0 +1,153 @@
+#ifndef SIM_H
+#define SIM_H
+#include "config.h"
+#include "protocol.h"
+
+/*
+ Host-side simulation of Remate, built by the 'native' environment of platformio.ini: the firmware of src/ runs on
+ the PC against a simulated Arduino core (Arduino.h, EEPROM.h), in simulated time, so a change to the timings or to
+ the motion can be measured before it touches the machine.
+ - The core (simCore.cpp) keeps the clock, the pins, the ADC, the EEPROM and the serial link at 115200 baud.
+ - The world (simWorld.cpp) moves the disk and the cross: the motors get up to speed with their inertia, coast down
+   when they are off (or stop in a few millis with the brake of the transistor board), and the halls read a pulse
+   near each magnet (the index magnet goes the other way), with noise and the battery's voltage on BATTERY_PIN.
+ - The peer (simPeer.cpp) plays the Rpi4: it sends a stream of trashes (optionally preceded by the 9), acknowledges
+   the FRAME_DONE and sends the scripted frames at their time. After every FRAME_DONE it checks that the disk and
+   the cross are really on the magnet the firmware thinks they are on.
+ - The benchmark (simBench.cpp) runs a stream and prints the items per minute, the cycle time of each class and the
+   position error. Usage, from this directory:
+       pio run -e native && .pio/build/native/program --items 100 --mix 3,2,4,1
+       .pio/build/native/program --help
+   The tests of test/ run the same simulation, for both the boards: pio test -e native -e native_transistor
+   ('native_transistor' and 'native_index' are 'native' built with REMATE_BOARD_TRANSISTOR and REMATE_INDEX_MAGNET)
+ Without ARDUINO_ARCH_MEGAAVR the firmware reads the halls in HALL_MODE_POLL, so the simulated detection of the
+ magnets is the one of the loop(), a bit later than the interrupts of the board.
+*/
+
+// DEFINITION
+#define SIM_LOOP_MICROS 20        // Micros a pass of the loop() takes besides the calls to the core
+#define SIM_STEP_MICROS 100       // Longest step of the mechanics
+#define SIM_ANALOG_MICROS 110     // Micros of an analogRead() of the megaAVR core
+#define SIM_DIGITAL_MICROS 5      // Micros of a digitalWrite() of the megaAVR core
+#define SIM_BYTE_MICROS 87        // Micros of a byte on the serial link (10 bits at 115200 baud)
+#define SIM_MAX_ITEMS 1000        // Max trashes of a stream
+#define SIM_MAX_SCRIPT 32         // Max scripted frames
+#define SIM_PEER_RETRY 500        // Millis after which the peer sends a command again if it has had no answer
+#define SIM_POSITION_WIDTH 20.0   // Degrees from a magnet at which an axis counts as on that position, see 'SimItem'
+
+// SIM STRUCTS
+// Struct for the mechanics of the disk or of the cross and of its hall
+typedef struct {
+  double maxSpeed;       // Degrees per second at BATTERY_NOMINAL_MV
+  double spinUp;         // Seconds of the time constant of the speed while driven (the inertia)
+  double coastDecel;     // Degrees per second^2 lost with the motor off
+  double brakeDecel;     // Degrees per second^2 lost with the brake of the transistor board
+  double hallWidth;      // Degrees from a magnet at which its pulse is down to 1/e
+  double hallAmplitude;  // Counts of the pulse right on a magnet
+} SimAxisModel;
+
+// Struct for everything that can be changed in a simulation, see 'simDefaults'
+typedef struct {
+  SimAxisModel axes[2];     // Disk (0) and cross (1)
+  double hallBaseline;      // Reading of the halls without a magnet
+  int hallNoise;            // Max counts of noise, added to every reading
+  double batteryMillivolts; // Voltage on BATTERY_PIN, 0 -> no battery monitor (the motors turn at 'maxSpeed')
+  int jamAxis;              // Axis that gets stuck between 'jamFromMillis' and 'jamToMillis', -1 -> none
+  ul jamFromMillis;
+  ul jamToMillis;
+  uint32_t seed;            // Seed of the noise and of the random streams
+  uint16_t corruptEvery;    // Every this many frames from the Rpi4 (from 'simPeerBegin') one has a broken CRC, 0 -> none
+  const char* eepromPath;   // File the EEPROM is loaded from and saved to, NULL -> erased at every start
+  bool verbose;             // Print every frame of the serial link
+} SimConfig;
+
+// Struct for the state of the disk or of the cross
+typedef struct {
+  double angle;  // Degrees, 0 - 360 (the magnets are at multiples of 360 / MOTOR_POSITIONS)
+  double speed;  // Degrees per second, > 0 clockwise
+} SimAxis;
+
+// Struct for a frame of the serial link
+typedef struct {
+  uint8_t type;
+  uint8_t seq;
+  uint8_t length;
+  uint8_t payload[FRAME_MAX_PAYLOAD];
+} SimFrame;
+
+// Struct for a frame the peer sends at a given time, from the FRAME_READY
+typedef struct {
+  ul atMillis;
+  SimFrame frame;
+} SimScripted;
+
+// Struct for a trash of the stream and what has happened to it
+typedef struct {
+  uint8_t trash;           // One of the TrashType values
+  ul arrivalMillis;        // When it arrives in front of the camera, from the FRAME_READY
+  ul sentMillis;           // When its class has been sent (0 -> not yet)
+  ul doneMillis;           // When its FRAME_DONE (or FRAME_FAULT) has arrived (0 -> not yet)
+  uint8_t seq;             // Sequence number of its command
+  uint8_t feedback;        // 42, 43 (unsorted) or 0 for a FRAME_FAULT
+  bool accepted;           // True once its command has been acknowledged
+  uint8_t nacks;           // Times it has been refused (or sent again without an answer)
+  double positionError[2]; // Degrees between the disk and the cross and the magnet they should be on, at the FRAME_DONE
+  uint8_t diskPositions;   // Bit n set if the disk has been on its position n since the FRAME_DONE before this one
+} SimItem;
+
+// Struct for the Rpi4 played by the peer
+typedef struct {
+  SimItem* items;
+  uint16_t itemCount;
+  ul gapMillis;            // Millis between two arrivals, 0 -> each trash arrives as soon as the queue has room
+  ul incomingMillis;       // Millis between the 9 and the class, 0 -> no 9
+  SimScripted script[SIM_MAX_SCRIPT];
+  uint8_t scriptCount;
+} SimStream;
+
+// DEFINE VARIABLES
+extern SimConfig simConfig;        // Set before 'simBegin'
+extern SimAxis simAxes[2];         // Disk (0) and cross (1)
+extern uint32_t simRxOverruns;     // Bytes from the Rpi4 lost because the serial buffer of the Arduino was full
+extern uint32_t simShootThroughs;  // Times both the sides of an H-bridge have been on together (transistor board)
+extern ul simPaddleMillis;         // Millis the paddle's motor has been on
+extern bool simReady;              // True once the FRAME_READY has arrived
+extern uint8_t simVersion;         // Protocol version of the FRAME_READY
+extern uint16_t simCapabilities;   // Capabilities of the FRAME_READY
+extern uint8_t simQueueSize;       // Commands the Arduino can queue, from the FRAME_READY
+extern ul simReadyMillis;          // Millis at which the FRAME_READY has arrived
+extern uint16_t simFaults;         // FRAME_FAULT received
+extern uint16_t simLinkErrors;     // Frames from the Arduino with a bad CRC, NACK_CRC and commands sent again
+
+// DECLEARING FUNCTIONS
+// simCore.cpp
+SimConfig simDefaults();                    // The machine as it is tuned now
+void simBegin();                            // Reset the clock, the pins, the serial link and the world, load the EEPROM
+void simEnd();                              // Save the EEPROM, if it has a file
+unsigned long long simMicros();             // Simulated micros since 'simBegin', without wrapping
+void simAdvance(unsigned long us);          // Let the simulated time go on
+void simPass();                             // A pass of the loop(), with the peer and the time it takes
+bool simRunUntil(bool (*condition)(), ul timeoutMillis);  // Passes of the loop() until the condition holds (false on timeout)
+void simSerialToArduino(const uint8_t* bytes, uint8_t length);  // Bytes from the Rpi4, they arrive at 115200 baud
+int simPinState(uint8_t pin);               // Last value written on the pin
+int simPinDuty(uint8_t pin);                // Duty of the pin (0 - 255), the last analogWrite() or 0/255 for a digitalWrite()
+void simRaiseInterrupt(uint8_t pin);        // Call the interrupt handler of the pin, if any
+uint32_t simRandom();                       // Pseudo random number from 'seed'
+uint32_t simEepromWear(int from, int to);   // Most writes of a single EEPROM cell from 'from' to 'to' (excluded)
+// simWorld.cpp
+void simWorldBegin();                       // Both the axes on their magnet 0, still
+void simWorldStep(double seconds);          // Move the axes for the time passed
+int simWorldAnalog(uint8_t pin);            // Reading of an analog pin: a hall, the battery or nothing
+uint8_t simNearestMagnet(uint8_t motorIndex);                 // Magnet closest to the axis
+double simMagnetDistance(uint8_t motorIndex, uint8_t magnet); // Degrees between the axis and the magnet
+// simPeer.cpp
+void simPeerBegin(SimStream* stream);       // Start playing the Rpi4 with the stream passed (NULL -> only answer), also after the FRAME_READY
+void simPeerByte(uint8_t value);            // A byte from the Arduino has arrived
+void simPeerTick();                         // Send what is due, called at every pass of the loop()
+bool simPeerFinished();                     // True once every trash of the stream has its FRAME_DONE or FRAME_FAULT
+void simPeerSend(uint8_t type, uint8_t seq, const uint8_t* payload, uint8_t length);  // Send a frame now
+// The firmware (src/)
+void setup();
+void loop();
+
+#endif /*SIM_H*/
@@ -0,0 +1,281 @@
+// Include sim header file
+#include "sim.h"
+#include <stdio.h>
+
+/*
+ Benchmark of the 'native' environment (see sim.h): boots the firmware, plays a stream of trashes and prints
+ the throughput, the cycle time of each class and how far the disk and the cross have ended from their magnets.
+ The tests of test/ have their own main(), so this one is left out of them.
+*/
+
+#ifndef PIO_UNIT_TESTING
+
+// DEFINITION
+#define BENCH_TIMEOUT_PER_ITEM 30000  // Millis a trash (or a scripted frame, like a calibration) may take before the run is given up
+
+// DEFINE VARIABLES
+static SimItem benchItems[SIM_MAX_ITEMS];
+static SimStream benchStream = {};
+static const char* const benchClassNames[] = {"none", "paper", "metal", "plastic", "unsorted"};
+
+static void benchUsage(){
+  printf("Usage: program [options]\n"
+         "  --items N          trashes of the stream (default 100, max %d)\n"
+         "  --mix P,M,L,U      weights of paper, metal, plastic and unsorted in a random stream (default 1,1,1,1)\n"
+         "  --stream PMLU...   the stream itself, a letter for each trash (overrides --items and --mix)\n"
+         "  --gap MS           millis between two arrivals (default 0: as soon as the queue has room)\n"
+         "  --incoming MS      send the 9 first, then the class MS millis later (default 0: no 9)\n"
+         "  --frame MS:TYPE:HEX  send a frame MS millis after the FRAME_READY (e.g. 0:14:FF for the fastest feed)\n"
+         "  --battery MV       battery's voltage (default 0: no battery monitor)\n"
+         "  --speed X          speed of both the motors, times the default one\n"
+         "  --hall-offset N    counts added to the halls' baseline\n"
+         "  --noise N          max counts of noise of the halls (default 3)\n"
+         "  --jam AXIS:FROM:TO the disk (0) or the cross (1) is stuck between these millis\n"
+         "  --seed N           seed of the noise and of the random stream\n"
+         "  --corrupt N        break the CRC of every Nth frame sent to the Arduino (default 0: none)\n"
+         "  --eeprom FILE      keep the EEPROM in this file between runs\n"
+         "  --verbose          print every frame\n", SIM_MAX_ITEMS);
+}
+
+// Reads a frame like 0:14:FF into the script, returns false if it's malformed
+static bool benchScripted(const char* text){
+  if (benchStream.scriptCount >= SIM_MAX_SCRIPT) {
+    return false;
+  }
+  SimScripted& scripted = benchStream.script[benchStream.scriptCount];
+  unsigned long atMillis;
+  unsigned type;
+  int used = 0;
+  if (sscanf(text, "%lu:%x:%n", &atMillis, &type, &used) < 2) {
+    return false;
+  }
+  scripted.atMillis = atMillis;
+  scripted.frame.type = type;
+  scripted.frame.seq = 0;
+  scripted.frame.length = 0;
+  for (const char* hex = text + used; used > 0 && hex[0] && hex[1] && scripted.frame.length < FRAME_MAX_PAYLOAD; hex += 2) {
+    unsigned value;
+    if (sscanf(hex, "%2x", &value) != 1) {
+      return false;
+    }
+    scripted.frame.payload[scripted.frame.length++] = value;
+  }
+  benchStream.scriptCount++;
+  return true;
+}
+
+// Trash of a letter of --stream, TRASH_NONE if it isn't one
+static uint8_t benchTrash(char letter){
+  switch (letter) {
+    case 'P':
+    case 'p':
+      return TRASH_PAPER;
+    case 'M':
+    case 'm':
+      return TRASH_METAL;
+    case 'L':
+    case 'l':
+      return TRASH_PLASTIC;
+    case 'U':
+    case 'u':
+      return TRASH_UNSORTED;
+    default:
+      return TRASH_NONE;
+  }
+}
+
+// Random stream with the weights passed, from the seed of the simulation
+static void benchRandomStream(uint16_t count, const unsigned weights[4]){
+  unsigned total = weights[0] + weights[1] + weights[2] + weights[3];
+  for (uint16_t i = 0; i < count; i++) {
+    unsigned pick = total ? simRandom() % total : 0;
+    uint8_t trash = TRASH_PAPER;
+    while (trash < TRASH_UNSORTED && pick >= weights[trash - 1]) {
+      pick -= weights[trash - 1];
+      trash++;
+    }
+    benchItems[i].trash = trash;
+  }
+  benchStream.itemCount = count;
+}
+
+static int benchCompare(const void* a, const void* b){
+  ul first = *(const ul*)a;
+  ul second = *(const ul*)b;
+  return (first > second) - (first < second);
+}
+
+// Value at the part (0 - 1) of the sorted values passed
+static ul benchPercentile(const ul* sorted, uint16_t count, double part){
+  return sorted[min(uint16_t(part * count), uint16_t(count - 1))];
+}
+
+/*
+ The cycle of a trash is from its class to its FRAME_DONE. The service time leaves out the wait in the queue:
+ it starts when the previous trash is over (or when the class has been sent, if it's later).
+*/
+static void benchReport(ul elapsedMillis){
+  uint16_t done = 0;
+  uint16_t unsorted = 0;
+  uint16_t faulted = 0;
+  uint16_t nacks = 0;
+  uint16_t wrongMagnets = 0;
+  double maxError[2] = {0, 0};
+  double sumError[2] = {0, 0};
+  static ul cycles[TRASH_UNSORTED + 1][SIM_MAX_ITEMS];
+  static ul services[TRASH_UNSORTED + 1][SIM_MAX_ITEMS];
+  uint16_t counts[TRASH_UNSORTED + 1] = {};
+  ul previousDone = 0;
+  for (uint16_t i = 0; i < benchStream.itemCount; i++) {
+    const SimItem& item = benchItems[i];
+    nacks += item.nacks;
+    if (item.doneMillis == 0) {
+      continue;
+    }
+    done++;
+    unsorted += (item.feedback == feedbackUnsorted);
+    faulted += (item.feedback == 0);
+    for (int axis = 0; axis < 2; axis++) {
+      maxError[axis] = max(maxError[axis], item.positionError[axis]);
+      sumError[axis] += item.positionError[axis];
+      wrongMagnets += (item.positionError[axis] > 180.0 / MOTOR_POSITIONS);
+    }
+    uint8_t trash = item.trash;
+    cycles[trash][counts[trash]] = item.doneMillis - item.sentMillis;
+    services[trash][counts[trash]++] = item.doneMillis - max(item.sentMillis, previousDone);
+    previousDone = max(previousDone, item.doneMillis);
+  }
+  printf("firmware: protocol %u, capabilities 0x%04X, %s board, hall mode %s\n", simVersion, simCapabilities,
+         boardVariant == BOARD_RELAY ? "relay" : "transistor", hallMode == HALL_MODE_POLL ? "poll" : "window");
+  printf("%u of %u trashes in %.1f s: %.1f items/minute\n", done, benchStream.itemCount, elapsedMillis / 1000.0,
+         elapsedMillis ? done * 60000.0 / elapsedMillis : 0.0);
+  printf("%u unsorted, %u faults, %u commands refused or sent again, %u link errors, %lu bytes lost by the Arduino\n",
+         unsorted, faulted, nacks, simLinkErrors, (unsigned long)simRxOverruns);
+  printf("\n%-9s %5s %26s %26s\n", "class", "items", "cycle ms (median 90% max)", "service ms (median 90% max)");
+  for (uint8_t trash = TRASH_PAPER; trash <= TRASH_UNSORTED; trash++) {
+    uint16_t count = counts[trash];
+    if (count == 0) {
+      continue;
+    }
+    qsort(cycles[trash], count, sizeof(ul), benchCompare);
+    qsort(services[trash], count, sizeof(ul), benchCompare);
+    printf("%-9s %5u %8lu %8lu %8lu %8lu %8lu %8lu\n", benchClassNames[trash], count,
+           benchPercentile(cycles[trash], count, 0.5), benchPercentile(cycles[trash], count, 0.9), cycles[trash][count - 1],
+           benchPercentile(services[trash], count, 0.5), benchPercentile(services[trash], count, 0.9), services[trash][count - 1]);
+  }
+  printf("\nposition error (degrees from the magnet the firmware counts, at every FRAME_DONE):\n");
+  for (int axis = 0; axis < 2; axis++) {
+    printf("  %-5s mean %5.1f  max %5.1f\n", axis == DISK ? "disk" : "cross", done ? sumError[axis] / done : 0.0, maxError[axis]);
+  }
+  printf("  %u times on the wrong magnet\n", wrongMagnets);
+  printf("paddle on for %.1f s (%.0f%%)", simPaddleMillis / 1000.0, elapsedMillis ? 100.0 * simPaddleMillis / elapsedMillis : 0.0);
+  if (boardVariant == BOARD_TRANSISTOR) {
+    printf(", %lu shoot-throughs", (unsigned long)simShootThroughs);
+  }
+  printf("\n");
+}
+
+static bool benchReady(){
+  return simReady;
+}
+
+int main(int argc, char** argv){
+  uint16_t count = 100;
+  unsigned weights[4] = {1, 1, 1, 1};
+  const char* stream = NULL;
+  double speed = 1.0;
+  for (int i = 1; i < argc; i++) {
+    const char* option = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+    bool valid = true;
+    if (strcmp(option, "--verbose") == 0) {
+      simConfig.verbose = true;
+      continue;
+    }
+    if (strcmp(option, "--help") == 0 || value == NULL) {
+      benchUsage();
+      return strcmp(option, "--help") == 0 ? 0 : 1;
+    }
+    i++;
+    if (strcmp(option, "--items") == 0) {
+      count = min(atoi(value), SIM_MAX_ITEMS);
+    } else if (strcmp(option, "--mix") == 0) {
+      valid = sscanf(value, "%u,%u,%u,%u", &weights[0], &weights[1], &weights[2], &weights[3]) == 4;
+    } else if (strcmp(option, "--stream") == 0) {
+      stream = value;
+    } else if (strcmp(option, "--gap") == 0) {
+      benchStream.gapMillis = strtoul(value, NULL, 10);
+    } else if (strcmp(option, "--incoming") == 0) {
+      benchStream.incomingMillis = strtoul(value, NULL, 10);
+    } else if (strcmp(option, "--frame") == 0) {
+      valid = benchScripted(value);
+    } else if (strcmp(option, "--battery") == 0) {
+      simConfig.batteryMillivolts = atof(value);
+    } else if (strcmp(option, "--speed") == 0) {
+      speed = atof(value);
+    } else if (strcmp(option, "--hall-offset") == 0) {
+      simConfig.hallBaseline += atof(value);
+    } else if (strcmp(option, "--noise") == 0) {
+      simConfig.hallNoise = atoi(value);
+    } else if (strcmp(option, "--jam") == 0) {
+      valid = sscanf(value, "%d:%lu:%lu", &simConfig.jamAxis, &simConfig.jamFromMillis, &simConfig.jamToMillis) == 3;
+    } else if (strcmp(option, "--seed") == 0) {
+      simConfig.seed = strtoul(value, NULL, 10);
+    } else if (strcmp(option, "--corrupt") == 0) {
+      simConfig.corruptEvery = strtoul(value, NULL, 10);
+    } else if (strcmp(option, "--eeprom") == 0) {
+      simConfig.eepromPath = value;
+    } else {
+      valid = false;
+    }
+    if (!valid) {
+      printf("Bad option: %s %s\n", option, value);
+      benchUsage();
+      return 1;
+    }
+  }
+  for (int axis = 0; axis < 2; axis++) {
+    simConfig.axes[axis].maxSpeed *= speed;
+  }
+
+  simBegin();
+  if (stream != NULL) {
+    count = 0;
+    for (const char* letter = stream; *letter && count < SIM_MAX_ITEMS; letter++) {
+      if (benchTrash(*letter) != TRASH_NONE) {
+        benchItems[count++].trash = benchTrash(*letter);
+      }
+    }
+    benchStream.itemCount = count;
+  } else {
+    benchRandomStream(count, weights);
+  }
+  for (uint16_t i = 0; i < count; i++) {
+    benchItems[i].arrivalMillis = i * benchStream.gapMillis;
+  }
+  benchStream.items = benchItems;
+  simPeerBegin(&benchStream);
+
+  setup();
+  if (!simRunUntil(benchReady, 10000)) {  // The cross is calibrated first, the EEPROM may be erased
+    printf("No FRAME_READY from the firmware\n");
+    return 1;
+  }
+  if (simVersion != PROTOCOL_VERSION) {
+    printf("The firmware speaks protocol %u, the simulation %u\n", simVersion, PROTOCOL_VERSION);
+  }
+  bool finished = simRunUntil(simPeerFinished, (ul)BENCH_TIMEOUT_PER_ITEM * (count + benchStream.scriptCount + 1));
+  ul elapsed = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    elapsed = max(elapsed, benchItems[i].doneMillis);
+  }
+  benchReport(elapsed);
+  simEnd();
+  if (!finished) {
+    printf("GIVEN UP: the firmware has stopped answering\n");
+    return 1;
+  }
+  return 0;
+}
+
+#endif
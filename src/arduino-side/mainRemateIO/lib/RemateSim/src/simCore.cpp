@@ -0,0 +1,299 @@
+// Include sim header file
+#include "sim.h"
+#include <EEPROM.h>
+#include <stdio.h>
+
+// DEFINITION
+#define SIM_LINE_SIZE 4096  // Max bytes of the Rpi4 on the wire, not arrived yet
+
+// DEFINE VARIABLES
+SimSerial Serial;
+EEPROMClass EEPROM;
+SimConfig simConfig = simDefaults();
+uint32_t simRxOverruns = 0;
+ul simPaddleMillis = 0;
+static unsigned long long simNow = 0;           // Simulated micros
+static unsigned long long simPaddleMicros = 0;  // Micros the paddle's motor has been on
+static uint32_t simRandomState = 1;
+static uint8_t simPins[NUM_DIGITAL_PINS];
+static uint8_t simDuties[NUM_DIGITAL_PINS];     // Duty of the pins, 0 or 255 for the ones set by digitalWrite()
+static void (*simHandlers[NUM_DIGITAL_PINS])(void);
+// Serial link: what the Arduino is sending, what the Rpi4 has sent and is still on the wire, what has arrived
+static uint8_t simTx[SERIAL_TX_BUFFER_SIZE];
+static uint8_t simTxHead = 0;
+static uint8_t simTxCount = 0;
+static unsigned long long simTxNext = 0;        // Micros at which the oldest byte of 'simTx' is over the wire
+static uint8_t simLine[SIM_LINE_SIZE];
+static uint16_t simLineHead = 0;
+static uint16_t simLineCount = 0;
+static unsigned long long simLineNext = 0;      // Micros at which the oldest byte of 'simLine' arrives
+static uint8_t simRx[SERIAL_RX_BUFFER_SIZE];
+static uint8_t simRxHead = 0;
+static uint8_t simRxCount = 0;
+
+// The bytes whose time has come cross the wire, both ways
+static void simSerialStep(){
+  while (simTxCount > 0 && simTxNext <= simNow) {
+    uint8_t value = simTx[simTxHead];
+    simTxHead = (simTxHead + 1) % SERIAL_TX_BUFFER_SIZE;
+    simTxCount--;
+    simTxNext += SIM_BYTE_MICROS;
+    simPeerByte(value);
+  }
+  while (simLineCount > 0 && simLineNext <= simNow) {
+    if (simRxCount < SERIAL_RX_BUFFER_SIZE - 1) {  // Like the megaAVR core, a byte of the buffer is always left empty
+      simRx[(simRxHead + simRxCount++) % SERIAL_RX_BUFFER_SIZE] = simLine[simLineHead];
+    } else {
+      simRxOverruns++;
+    }
+    simLineHead = (simLineHead + 1) % SIM_LINE_SIZE;
+    simLineCount--;
+    simLineNext += SIM_BYTE_MICROS;
+  }
+}
+
+// DEFINE FUNCTIONS
+/*
+ The machine as it is tuned in config.cpp, on a full battery: a quarter turn of the disk takes ~1.2 seconds and the
+ cross is a bit faster, and the coast-down after a magnet is what the 'offsetDelays' of the relay board take back.
+ The halls read ~250 counts over 512 on a magnet, with a few counts of noise.
+*/
+SimConfig simDefaults(){
+  SimConfig config = {};
+  config.axes[DISK] = {90.0, 0.25, 437.0, 6000.0, 5.0, 250.0};
+  config.axes[CROSS] = {110.0, 0.25, 381.0, 6000.0, 5.0, 250.0};
+  config.hallBaseline = 512.0;
+  config.hallNoise = 3;
+  config.batteryMillivolts = 0;
+  config.jamAxis = -1;
+  config.seed = 1;
+  config.eepromPath = NULL;
+  config.verbose = false;
+  return config;
+}
+
+// Only once in a run: the variables of the firmware can't be reset, 'setup' comes right after this
+void simBegin(){
+  simNow = 0;
+  simPaddleMicros = 0;
+  simPaddleMillis = 0;
+  simRandomState = simConfig.seed ? simConfig.seed : 1;
+  memset(simPins, 0, sizeof(simPins));
+  memset(simDuties, 0, sizeof(simDuties));
+  memset(simHandlers, 0, sizeof(simHandlers));
+  simTxCount = 0;
+  simLineCount = 0;
+  simRxCount = 0;
+  simRxOverruns = 0;
+  memset(EEPROM.bytes, 0xFF, EEPROM_SIZE);
+  memset(EEPROM.writes, 0, sizeof(EEPROM.writes));
+  if (simConfig.eepromPath != NULL) {
+    FILE* file = fopen(simConfig.eepromPath, "rb");
+    if (file != NULL) {
+      if (fread(EEPROM.bytes, 1, EEPROM_SIZE, file) != EEPROM_SIZE) {
+        memset(EEPROM.bytes, 0xFF, EEPROM_SIZE);  // Not an EEPROM of this simulation
+      }
+      fclose(file);
+    }
+  }
+  simWorldBegin();
+}
+
+void simEnd(){
+  if (simConfig.eepromPath != NULL) {
+    FILE* file = fopen(simConfig.eepromPath, "wb");
+    if (file != NULL) {
+      fwrite(EEPROM.bytes, 1, EEPROM_SIZE, file);
+      fclose(file);
+    }
+  }
+}
+
+uint32_t simEepromWear(int from, int to){
+  uint32_t most = 0;
+  for (int address = from; address < to; address++) {
+    most = max(most, EEPROM.writes[address]);
+  }
+  return most;
+}
+
+unsigned long long simMicros(){
+  return simNow;
+}
+
+// The mechanics move in steps of SIM_STEP_MICROS at most, the serial link after each of them
+void simAdvance(unsigned long us){
+  while (us > 0) {
+    unsigned long step = min(us, (unsigned long)SIM_STEP_MICROS);
+    simWorldStep(step / 1e6);
+    if (simPins[PADDLE_NPN]) {
+      simPaddleMicros += step;
+      simPaddleMillis = simPaddleMicros / 1000;
+    }
+    simNow += step;
+    us -= step;
+    simSerialStep();
+  }
+}
+
+void simPass(){
+  simPeerTick();
+  loop();
+  simAdvance(SIM_LOOP_MICROS);
+}
+
+bool simRunUntil(bool (*condition)(), ul timeoutMillis){
+  ul start = millis();
+  while (!condition()) {
+    if (millis() - start >= timeoutMillis) {
+      return false;
+    }
+    simPass();
+  }
+  return true;
+}
+
+// The bytes sent while others are still on the wire follow them
+void simSerialToArduino(const uint8_t* bytes, uint8_t length){
+  for (uint8_t i = 0; i < length && simLineCount < SIM_LINE_SIZE; i++) {
+    if (simLineCount == 0) {
+      simLineNext = simNow + SIM_BYTE_MICROS;
+    }
+    simLine[(simLineHead + simLineCount++) % SIM_LINE_SIZE] = bytes[i];
+  }
+}
+
+int simPinState(uint8_t pin){
+  return (pin < NUM_DIGITAL_PINS) ? simPins[pin] : 0;
+}
+
+int simPinDuty(uint8_t pin){
+  return (pin < NUM_DIGITAL_PINS) ? simDuties[pin] : 0;
+}
+
+void simRaiseInterrupt(uint8_t pin){
+  if (pin < NUM_DIGITAL_PINS && simHandlers[pin] != NULL) {
+    simHandlers[pin]();
+  }
+}
+
+// xorshift32, the same stream for the same seed on every PC
+uint32_t simRandom(){
+  simRandomState ^= simRandomState << 13;
+  simRandomState ^= simRandomState >> 17;
+  simRandomState ^= simRandomState << 5;
+  return simRandomState;
+}
+
+// ARDUINO CORE
+// A call of micros() takes a few cycles on the board, the simulated time must go on also in a loop that only waits
+unsigned long millis(){
+  simAdvance(1);
+  return (unsigned long)(simNow / 1000);
+}
+
+unsigned long micros(){
+  simAdvance(1);
+  return (unsigned long)simNow;
+}
+
+void delay(unsigned long ms){
+  simAdvance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us){
+  simAdvance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode){
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value){
+  simAdvance(SIM_DIGITAL_MICROS);
+  if (pin < NUM_DIGITAL_PINS) {
+    simPins[pin] = value ? HIGH : LOW;
+    simDuties[pin] = value ? 255 : 0;
+  }
+}
+
+int digitalRead(uint8_t pin){
+  return simPinState(pin);
+}
+
+int analogRead(uint8_t pin){
+  simAdvance(SIM_ANALOG_MICROS);
+  return simWorldAnalog(pin);
+}
+
+// The PWM is much faster than the motors, only its duty is kept
+void analogWrite(uint8_t pin, int value){
+  simAdvance(SIM_DIGITAL_MICROS);
+  if (pin < NUM_DIGITAL_PINS) {
+    simPins[pin] = (value > 127) ? HIGH : LOW;
+    simDuties[pin] = constrain(value, 0, 255);
+  }
+}
+
+void attachInterrupt(uint8_t interruptNumber, void (*handler)(void), int mode){
+  (void)mode;
+  if (interruptNumber < NUM_DIGITAL_PINS) {
+    simHandlers[interruptNumber] = handler;
+  }
+}
+
+void detachInterrupt(uint8_t interruptNumber){
+  attachInterrupt(interruptNumber, NULL, 0);
+}
+
+void SimSerial::begin(unsigned long baud){
+  (void)baud;
+}
+
+int SimSerial::available(){
+  return simRxCount;
+}
+
+int SimSerial::peek(){
+  return simRxCount > 0 ? simRx[simRxHead] : -1;
+}
+
+int SimSerial::read(){
+  if (simRxCount == 0) {
+    return -1;
+  }
+  uint8_t value = simRx[simRxHead];
+  simRxHead = (simRxHead + 1) % SERIAL_RX_BUFFER_SIZE;
+  simRxCount--;
+  return value;
+}
+
+int SimSerial::availableForWrite(){
+  return SERIAL_TX_BUFFER_SIZE - 1 - simTxCount;
+}
+
+// Like the megaAVR core, a full buffer makes the write wait for a byte to go
+size_t SimSerial::write(uint8_t value){
+  while (simTxCount >= SERIAL_TX_BUFFER_SIZE - 1) {
+    simAdvance(SIM_BYTE_MICROS / 4);
+  }
+  if (simTxCount == 0) {
+    simTxNext = simNow + SIM_BYTE_MICROS;
+  }
+  simTx[(simTxHead + simTxCount++) % SERIAL_TX_BUFFER_SIZE] = value;
+  return 1;
+}
+
+size_t SimSerial::write(const uint8_t* buffer, size_t size){
+  for (size_t i = 0; i < size; i++) {
+    write(buffer[i]);
+  }
+  return size;
+}
+
+void SimSerial::flush(){
+  while (simTxCount > 0) {
+    simAdvance(SIM_BYTE_MICROS / 4);
+  }
+}
@@ -0,0 +1,300 @@
+// Include sim header file
+#include "sim.h"
+#include "position.h"
+#include <stdio.h>
+
+// DEFINE VARIABLES
+bool simReady = false;
+uint8_t simVersion = 0;
+uint16_t simCapabilities = 0;
+uint8_t simQueueSize = 1;
+ul simReadyMillis = 0;
+uint16_t simFaults = 0;
+uint16_t simLinkErrors = 0;
+static SimStream* simStream = NULL;
+static uint16_t simNextItem = 0;      // First trash whose class hasn't been sent yet
+static uint8_t simSeq = 0;            // Last sequence number used
+static uint8_t simNextScripted = 0;   // First scripted frame not sent yet
+static bool simHeld = false;          // True after a NACK_QUEUE_FULL, until the next FRAME_DONE
+static uint8_t simIncomingSeq = 0;    // Sequence number of the 9 sent for 'simNextItem', 0 -> none
+static ul simIncomingMillis = 0;      // When that 9 has been sent
+static uint16_t simSentFrames = 0;    // Frames sent since 'simPeerBegin', for 'corruptEvery'
+static uint8_t simMagnetOffset[2];    // Magnet each axis is on when the firmware says it's on its position 0
+static uint8_t simDiskPositions = 0;  // Positions of the disk seen since the last FRAME_DONE, see 'SimItem'
+// Frame being received from the Arduino
+static uint8_t simFrameBytes[FRAME_MAX_PAYLOAD + 5];
+static uint8_t simFrameLength = 0;
+
+// Same CRC-8 as the firmware (polynomial 0x07), computed again here so a change there shows up as a broken link
+static uint8_t simCrc8(const uint8_t* data, uint8_t length){
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? uint8_t((crc << 1) ^ 0x07) : uint8_t(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Sequence numbers go from 1 to 255, then back to 1
+static uint8_t simNewSeq(){
+  simSeq = (simSeq == 255) ? 1 : simSeq + 1;
+  return simSeq;
+}
+
+// Millis of the simulation from the FRAME_READY
+static ul simElapsed(){
+  return millis() - simReadyMillis;
+}
+
+// Trash (sent, not over yet) whose command has the sequence number passed, NULL if none
+static SimItem* simFindItem(uint8_t seq){
+  if (simStream == NULL) {
+    return NULL;
+  }
+  for (uint16_t i = 0; i < simNextItem; i++) {
+    SimItem& item = simStream->items[i];
+    if (item.seq == seq && item.doneMillis == 0) {
+      return &item;
+    }
+  }
+  return NULL;
+}
+
+// Trashes whose class has been sent and that aren't over yet
+static uint8_t simOutstanding(){
+  uint8_t count = 0;
+  for (uint16_t i = 0; simStream != NULL && i < simNextItem; i++) {
+    if (simStream->items[i].sentMillis > 0 && simStream->items[i].doneMillis == 0) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Sends the command of the trash passed, with its own sequence number if it's sent again
+static void simSendItem(SimItem& item){
+  if (item.seq == 0) {
+    item.seq = simNewSeq();
+  }
+  item.sentMillis = max(simElapsed(), 1UL);
+  simPeerSend(FRAME_COMMAND, item.seq, &item.trash, 1);
+}
+
+// The magnets the firmware counts from: at the FRAME_READY both the axes are stopped on their position
+static void simReadyReceived(const SimFrame& frame){
+  simReady = true;
+  simReadyMillis = millis();
+  simVersion = frame.payload[0];
+  simCapabilities = frame.payload[1] | (frame.length >= 4 ? frame.payload[3] << 8 : 0);
+  simQueueSize = max(frame.payload[2], (uint8_t)1);
+  for (int i = 0; i < 2; i++) {
+    simMagnetOffset[i] = (simNearestMagnet(i) + MOTOR_POSITIONS - axisPositions[i].position) % MOTOR_POSITIONS;
+  }
+}
+
+// A trash is over: where the axes really are is compared with where the firmware thinks they are
+static void simDoneReceived(const SimFrame& frame){
+  simPeerSend(FRAME_ACK, frame.seq, NULL, 0);
+  if (frame.type == FRAME_FAULT) {
+    simFaults++;
+  }
+  simHeld = false;
+  SimItem* item = simFindItem(frame.seq);
+  if (item == NULL) {
+    return;  // Sent again because the ACK was late, or not a trash of the stream
+  }
+  item->doneMillis = max(simElapsed(), 1UL);
+  item->feedback = (frame.type == FRAME_DONE) ? frame.payload[0] : 0;
+  for (int i = 0; i < 2; i++) {
+    uint8_t magnet = (simMagnetOffset[i] + axisPositions[i].position) % MOTOR_POSITIONS;
+    item->positionError[i] = simMagnetDistance(i, magnet);
+  }
+  item->diskPositions = simDiskPositions;  // Every throw ends with the disk back home, so these are the ones of this trash
+  simDiskPositions = 0;
+}
+
+static void simNackReceived(const SimFrame& frame){
+  SimItem* item = simFindItem(frame.seq);
+  if (item == NULL) {
+    if (frame.seq == simIncomingSeq) {
+      simIncomingSeq = 0;
+    }
+    return;
+  }
+  item->nacks++;
+  if (frame.payload[0] == NACK_QUEUE_FULL) {
+    simHeld = true;  // Sent again after the next FRAME_DONE
+  } else if (frame.payload[0] == NACK_CRC) {
+    simLinkErrors++;
+  } else {
+    item->doneMillis = max(simElapsed(), 1UL);  // Refused for good
+    return;
+  }
+  item->sentMillis = 0;  // Sent again by 'simPeerTick', before the next trashes
+}
+
+// Only the ACK of a command of the stream matters, the others are only printed
+static void simAckReceived(const SimFrame& frame){
+  SimItem* item = simFindItem(frame.seq);
+  if (item != NULL) {
+    item->accepted = true;
+  }
+}
+
+static void simFrameReceived(const SimFrame& frame){
+  if (simConfig.verbose) {
+    printf("%10.3f ms  arduino -> %02X seq %3u:", simMicros() / 1000.0, frame.type, frame.seq);
+    for (uint8_t i = 0; i < frame.length; i++) {
+      printf(" %02X", frame.payload[i]);
+    }
+    printf("\n");
+  }
+  switch (frame.type) {
+    case FRAME_READY:
+      simReadyReceived(frame);
+      break;
+    case FRAME_DONE:
+    case FRAME_FAULT:
+      simDoneReceived(frame);
+      break;
+    case FRAME_NACK:
+      simNackReceived(frame);
+      break;
+    case FRAME_ACK:
+      simAckReceived(frame);
+      break;
+    default:  // Telemetry and the other answers are only printed
+      break;
+  }
+}
+
+// DEFINE FUNCTIONS
+void simPeerBegin(SimStream* stream){
+  simStream = stream;
+  simNextItem = 0;
+  simNextScripted = 0;
+  simHeld = false;
+  simIncomingSeq = 0;
+  simSentFrames = 0;
+  simDiskPositions = 0;
+  simFaults = 0;
+  simLinkErrors = 0;
+}
+
+void simPeerSend(uint8_t type, uint8_t seq, const uint8_t* payload, uint8_t length){
+  uint8_t frame[FRAME_MAX_PAYLOAD + 5] = {FRAME_SYNC, length, type, seq};
+  if (length > 0) {
+    memcpy(frame + 4, payload, length);
+  }
+  frame[4 + length] = simCrc8(frame + 1, length + 3);
+  if (simConfig.corruptEvery > 0 && ++simSentFrames % simConfig.corruptEvery == 0) {
+    frame[4 + length] ^= 0xFF;  // Broken on the way, the Arduino answers with a NACK_CRC
+  }
+  if (simConfig.verbose) {
+    printf("%10.3f ms  rpi4 -> %02X seq %3u:", simMicros() / 1000.0, type, seq);
+    for (uint8_t i = 0; i < length; i++) {
+      printf(" %02X", payload[i]);
+    }
+    printf("\n");
+  }
+  simSerialToArduino(frame, length + 5);
+}
+
+// Same framing as 'receiveFrame' of the firmware, a frame with a bad CRC is dropped and counted
+void simPeerByte(uint8_t value){
+  if (simFrameLength == 0 && value != FRAME_SYNC) {
+    return;
+  }
+  simFrameBytes[simFrameLength++] = value;
+  if (simFrameLength == 2 && simFrameBytes[1] > FRAME_MAX_PAYLOAD) {
+    simFrameLength = 0;
+    simLinkErrors++;
+    return;
+  }
+  if (simFrameLength < 5 || simFrameLength < simFrameBytes[1] + 5) {
+    return;
+  }
+  SimFrame frame;
+  frame.length = simFrameBytes[1];
+  frame.type = simFrameBytes[2];
+  frame.seq = simFrameBytes[3];
+  memcpy(frame.payload, simFrameBytes + 4, frame.length);
+  bool valid = simCrc8(simFrameBytes + 1, frame.length + 3) == simFrameBytes[4 + frame.length];
+  simFrameLength = 0;
+  if (!valid) {
+    simLinkErrors++;
+    return;
+  }
+  simFrameReceived(frame);
+}
+
+/*
+ After the FRAME_READY: the scripted frames go at their time, and the next trash goes as soon as it has arrived and
+ the queue of the Arduino has room (after its 9 and 'incomingMillis', if the stream has them). A command without an
+ answer is sent again after SIM_PEER_RETRY with the same sequence number, like remate_link.py does, a refused one
+ after the next FRAME_DONE.
+*/
+void simPeerTick(){
+  if (!simReady || simStream == NULL) {
+    return;
+  }
+  uint8_t magnet = simNearestMagnet(DISK);
+  if (simMagnetDistance(DISK, magnet) < SIM_POSITION_WIDTH) {
+    simDiskPositions |= 1 << ((magnet + MOTOR_POSITIONS - simMagnetOffset[DISK]) % MOTOR_POSITIONS);
+  }
+  ul now = simElapsed();
+  while (simNextScripted < simStream->scriptCount && simStream->script[simNextScripted].atMillis <= now) {
+    const SimFrame& frame = simStream->script[simNextScripted++].frame;
+    simPeerSend(frame.type, frame.seq ? frame.seq : simNewSeq(), frame.payload, frame.length);
+  }
+  for (uint16_t i = 0; i < simNextItem; i++) {
+    SimItem& item = simStream->items[i];
+    if (item.doneMillis != 0) {
+      continue;
+    }
+    if (item.sentMillis > 0 && !item.accepted && now >= item.sentMillis + SIM_PEER_RETRY) {
+      simLinkErrors++;  // Lost on the way, or its ACK has been
+      item.nacks++;
+      simSendItem(item);
+    } else if (item.sentMillis == 0 && !simHeld) {
+      simSendItem(item);  // Refused because the queue was full
+      return;
+    }
+  }
+  if (simNextItem >= simStream->itemCount || simHeld || simOutstanding() >= simQueueSize) {
+    return;
+  }
+  SimItem& item = simStream->items[simNextItem];
+  if (item.arrivalMillis > now) {
+    return;
+  }
+  if (simStream->incomingMillis > 0) {
+    if (simIncomingSeq == 0) {
+      uint8_t incoming = TRASH_INCOMING;
+      simIncomingSeq = simNewSeq();
+      simIncomingMillis = now;
+      simPeerSend(FRAME_COMMAND, simIncomingSeq, &incoming, 1);
+      return;
+    }
+    if (now - simIncomingMillis < simStream->incomingMillis) {
+      return;
+    }
+    simIncomingSeq = 0;
+  }
+  simNextItem++;
+  simSendItem(item);
+}
+
+bool simPeerFinished(){
+  if (simStream == NULL) {
+    return false;
+  }
+  for (uint16_t i = 0; i < simStream->itemCount; i++) {
+    if (simStream->items[i].doneMillis == 0) {
+      return false;
+    }
+  }
+  return true;
+}
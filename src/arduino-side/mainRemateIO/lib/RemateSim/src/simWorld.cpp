@@ -0,0 +1,130 @@
+// Include sim header file
+#include "sim.h"
+#include "battery.h"
+#include "position.h"
+
+// DEFINE VARIABLES
+SimAxis simAxes[2];
+uint32_t simShootThroughs = 0;
+static bool simShorted[2];  // True while both the sides of the axis' H-bridge are on, counted once
+
+// Enum for what the driver of a motor is doing
+enum SimDrive {
+  SIM_DRIVE_OFF = 0,    // Coasting
+  SIM_DRIVE_CW = 1,
+  SIM_DRIVE_CCW = 2,
+  SIM_DRIVE_BRAKE = 3,  // Both the low sides on (transistor board)
+};
+
+// What the pins of the motor passed ask of it, with the pins of the board profile in config.h
+static uint8_t simDrive(uint8_t motorIndex){
+  if (boardVariant == BOARD_RELAY) {
+    bool clock = simPinState(motorIndex == DISK ? CLOCK_DISK_PIN : CLOCK_CROSS_PIN);
+    bool counter = simPinState(motorIndex == DISK ? COUNTER_DISK_PIN : COUNTER_CROSS_PIN);
+    if (clock == counter) {
+      return SIM_DRIVE_OFF;
+    }
+    return clock ? SIM_DRIVE_CW : SIM_DRIVE_CCW;
+  }
+  bool clockPnp = simPinState(motorIndex == DISK ? CLOCK_DISK_PNP : CLOCK_CROSS_PNP);
+  bool clockNpn = simPinState(motorIndex == DISK ? CLOCK_DISK_NPN : CLOCK_CROSS_NPN);
+  bool counterPnp = simPinState(motorIndex == DISK ? COUNTER_DISK_PNP : COUNTER_CROSS_PNP);
+  bool counterNpn = simPinState(motorIndex == DISK ? COUNTER_DISK_NPN : COUNTER_CROSS_NPN);
+  // A PNP together with the NPN under it shorts the supply
+  bool shorted = (clockPnp && counterNpn) || (counterPnp && clockNpn);
+  if (shorted && !simShorted[motorIndex]) {
+    simShootThroughs++;
+  }
+  simShorted[motorIndex] = shorted;
+  if (shorted) {
+    return SIM_DRIVE_OFF;
+  }
+  if (clockPnp && clockNpn) {
+    return SIM_DRIVE_CW;
+  }
+  if (counterPnp && counterNpn) {
+    return SIM_DRIVE_CCW;
+  }
+  return (clockNpn && counterNpn) ? SIM_DRIVE_BRAKE : SIM_DRIVE_OFF;
+}
+
+// Angle of the magnet passed
+static double simMagnetAngle(uint8_t magnet){
+  return magnet * 360.0 / MOTOR_POSITIONS;
+}
+
+// DEFINE FUNCTIONS
+void simWorldBegin(){
+  for (int i = 0; i < 2; i++) {
+    simAxes[i].angle = 0;
+    simAxes[i].speed = 0;
+    simShorted[i] = false;
+  }
+  simShootThroughs = 0;
+}
+
+/*
+ While driven the speed goes to the one of the voltage with the time constant 'spinUp'. Off, it goes down by
+ 'coastDecel' (the friction of the gears), braked by 'brakeDecel'. The relays' motors get the battery's voltage,
+ the regulators of the transistor board keep the nominal one times their duty.
+*/
+void simWorldStep(double seconds){
+  for (int i = 0; i < 2; i++) {
+    SimAxis& axis = simAxes[i];
+    const SimAxisModel& model = simConfig.axes[i];
+    ul now = (ul)(simMicros() / 1000);
+    if (simConfig.jamAxis == i && now >= simConfig.jamFromMillis && now < simConfig.jamToMillis) {
+      axis.speed = 0;  // Something is stuck between the disk (or the cross) and the chamber
+      continue;
+    }
+    uint8_t drive = simDrive(i);
+    if (drive == SIM_DRIVE_CW || drive == SIM_DRIVE_CCW) {
+      double voltage = 1.0;
+      if (boardVariant == BOARD_RELAY && simConfig.batteryMillivolts > 0) {
+        voltage = simConfig.batteryMillivolts / BATTERY_NOMINAL_MV;
+      } else if (boardVariant == BOARD_TRANSISTOR) {
+        voltage = simPinDuty(i == DISK ? DISK_MOTOR_REGULATOR : CROSS_MOTOR_REGULATOR) / 255.0;
+      }
+      double target = model.maxSpeed * voltage * (drive == SIM_DRIVE_CW ? 1 : -1);
+      axis.speed += (target - axis.speed) * min(seconds / model.spinUp, 1.0);
+    } else {
+      double loss = ((drive == SIM_DRIVE_BRAKE) ? model.brakeDecel : model.coastDecel) * seconds;
+      axis.speed = (axis.speed > 0) ? max(axis.speed - loss, 0.0) : min(axis.speed + loss, 0.0);
+    }
+    axis.angle = fmod(axis.angle + axis.speed * seconds + 360.0, 360.0);
+  }
+}
+
+/*
+ A hall reads 'hallBaseline' plus a bell shaped pulse around each magnet, down instead of up on the index magnet
+ (see position.h), plus the noise. The battery is read through the divider of battery.h.
+*/
+int simWorldAnalog(uint8_t pin){
+  for (int i = 0; i < 2; i++) {
+    if (pin != motorData[i].HALL) {
+      continue;
+    }
+    const SimAxisModel& model = simConfig.axes[i];
+    uint8_t magnet = simNearestMagnet(i);
+    double distance = simMagnetDistance(i, magnet) / model.hallWidth;
+    double pulse = model.hallAmplitude * exp(-distance * distance);
+    if (positionHasIndex[i] && magnet == POSITION_INDEX) {
+      pulse = -pulse;
+    }
+    int noise = (simConfig.hallNoise > 0) ? int(simRandom() % (2 * simConfig.hallNoise + 1)) - simConfig.hallNoise : 0;
+    return constrain(int(simConfig.hallBaseline + pulse) + noise, 0, 1023);
+  }
+  if (pin == BATTERY_PIN) {
+    return constrain(int(simConfig.batteryMillivolts * 1023 * 10 / ((double)BATTERY_REFERENCE_MV * BATTERY_DIVIDER_X10)), 0, 1023);
+  }
+  return 0;
+}
+
+uint8_t simNearestMagnet(uint8_t motorIndex){
+  return uint8_t(lround(simAxes[motorIndex].angle * MOTOR_POSITIONS / 360.0) % MOTOR_POSITIONS);
+}
+
+double simMagnetDistance(uint8_t motorIndex, uint8_t magnet){
+  double distance = fabs(simAxes[motorIndex].angle - simMagnetAngle(magnet));
+  return (distance > 180.0) ? 360.0 - distance : distance;
+}
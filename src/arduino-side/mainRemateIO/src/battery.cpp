@@ -0,0 +1,64 @@
+// Include battery header file
+#include "battery.h"
+#include "paddle.h"
+#include "hall.h"
+
+// DEFINE VARIABLES
+uint16_t batteryNominal = BATTERY_NOMINAL_MV;
+uint16_t batteryMillivolts = 0;
+static uint16_t batteryFiltered = 0;                // ADC readings times 2^BATTERY_FILTER_SHIFT
+static uint16_t batteryScale = BATTERY_SCALE_ONE;   // Scale of the timings, BATTERY_SCALE_ONE at the nominal voltage
+static uint16_t batteryPaddleScale = BATTERY_SCALE_ONE;  // Scale the paddle's timer has been given the last time
+static ul batterySampleMillis = 0;                  // Millis at which the last sample has been taken
+
+// DEFINE FUNCTIONS
+// Computes the voltage from the filter and the scale from the voltage
+static void batteryUpdate(){
+  batteryMillivolts = (ul)batteryFiltered * (BATTERY_REFERENCE_MV * (ul)BATTERY_DIVIDER_X10 / 10)
+                      / (1023UL << BATTERY_FILTER_SHIFT);
+  if (batteryMillivolts < BATTERY_MIN_MV) {
+    batteryMillivolts = 0;
+  }
+  if (batteryMillivolts == 0 || batteryNominal < BATTERY_MIN_MV) {
+    batteryScale = BATTERY_SCALE_ONE;
+  } else {
+    batteryScale = constrain((ul)batteryNominal * BATTERY_SCALE_ONE / batteryMillivolts, (ul)BATTERY_MIN_SCALE, (ul)BATTERY_MAX_SCALE);
+  }
+}
+
+// Must be called after the calibrated timings (and their nominal voltage) have been loaded
+void batteryBegin(){
+  pinMode(BATTERY_PIN, INPUT);
+  batteryFiltered = analogRead(BATTERY_PIN) << BATTERY_FILTER_SHIFT;
+  batterySampleMillis = millis();
+  batteryUpdate();
+  batteryPaddleScale = batteryScale;
+}
+
+/*
+ First order low-pass filter: the voltage drops while the motors pull their current and recovers after, only the
+ slow trend of the day is wanted. While a hall is watched the ADC belongs to its interrupts, the sample waits.
+ The paddle's timer is updated only when the scale has really moved.
+*/
+void batteryTick(){
+  if (millis() - batterySampleMillis < BATTERY_SAMPLE_INTERVAL || !hallIdle()) {
+    return;
+  }
+  batterySampleMillis = millis();
+  batteryFiltered += analogRead(BATTERY_PIN) - (batteryFiltered >> BATTERY_FILTER_SHIFT);
+  batteryUpdate();
+  if (abs((int)batteryScale - (int)batteryPaddleScale) >= BATTERY_UPDATE_STEP) {
+    batteryPaddleScale = batteryScale;
+    paddleUpdate();
+  }
+}
+
+// Returns the millis passed scaled for the current voltage of the battery
+ul batteryScaled(ul tunedMillis){
+  return tunedMillis * batteryScale / BATTERY_SCALE_ONE;
+}
+
+// The step down regulators of the transistor board keep the motors' voltage whatever the battery does
+ul batteryMotorScaled(ul tunedMillis){
+  return (boardVariant == BOARD_TRANSISTOR) ? tunedMillis : batteryScaled(tunedMillis);
+}
@@ -0,0 +1,29 @@
+// Include drivers header file
+#include "drivers.h"
+
+// DEFINE FUNCTIONS
+/*
+ Starts the software PWM of the regulators (see HBridgeMotor in drivers.h): TCB2 interrupts every
+ MOTOR_PWM_STEP_MICROS and each regulator is switched for the step. TCB2 is free because the sketch uses
+ neither tone() nor the Servo library, and it's only taken by the transistor board.
+*/
+void motorsPwmBegin(){
+#if defined(ARDUINO_ARCH_MEGAAVR) && defined(REMATE_BOARD_TRANSISTOR)
+  TCB2.CTRLA = 0;
+  TCB2.CTRLB = TCB_CNTMODE_INT_gc;  // Periodic interrupt
+  TCB2.CCMP = (F_CPU / 1000000UL) * MOTOR_PWM_STEP_MICROS - 1;
+  TCB2.CNT = 0;
+  TCB2.INTCTRL = TCB_CAPT_bm;
+  TCB2.CTRLA = TCB_CLKSEL_CLKDIV1_gc | TCB_ENABLE_bm;
+#endif
+}
+
+#if defined(ARDUINO_ARCH_MEGAAVR) && defined(REMATE_BOARD_TRANSISTOR)
+ISR(TCB2_INT_vect){
+  static uint8_t step = 0;
+  step = (step + 1) % MOTOR_PWM_STEPS;
+  Board::DiskMotor::pwmStep(step);
+  Board::CrossMotor::pwmStep(step);
+  TCB2.INTFLAGS = TCB_CAPT_bm;
+}
+#endif
@@ -0,0 +1,371 @@
+// Include hall header file
+#include "hall.h"
+#include "drivers.h"
+#include "capture.h"
+#include "position.h"
+
+// DEFINE VARIABLES
+volatile HallEvent hallEvents[2] = {};
+volatile HallThresholds hallThresholds[2] = {};
+#if defined(ARDUINO_ARCH_MEGAAVR)
+uint8_t hallMode = HALL_MODE_WINDOW;
+#else
+uint8_t hallMode = HALL_MODE_POLL;
+#endif
+
+#if defined(ARDUINO_ARCH_MEGAAVR)
+static uint8_t hallChannels[2];  // ADC channel of the disk's and the cross's hall
+static volatile uint8_t adcMotorIndex = DISK;  // Motor whose hall is being converted by the ADC
+static volatile bool adcWindowing = false;     // True while the ADC runs free with the window comparator
+#endif
+static volatile bool hallCapturing = false;  // True while the capture takes the readings of both the halls
+static uint16_t hallBaselineSums[2];         // Baselines times 2^HALL_BASELINE_SHIFT
+static ul hallBaselineMillis = 0;            // Millis at which the baselines have been sampled the last time
+
+// Median of the three readings passed, only comparisons since it runs in the ADC interrupts
+static uint16_t hallMedian(uint16_t a, uint16_t b, uint16_t c){
+  if (a > b) {
+    uint16_t swap = a;
+    a = b;
+    b = swap;
+  }
+  return (c <= a) ? a : (c >= b) ? b : c;
+}
+
+// Filters a reading of the hall of the motor passed with the two before it
+static uint16_t hallFilter(uint8_t motorIndex, uint16_t reading){
+  volatile HallEvent& event = hallEvents[motorIndex];
+  uint16_t filtered = hallMedian(event.recent[0], event.recent[1], reading);
+  event.recent[0] = event.recent[1];
+  event.recent[1] = reading;
+  event.lastReading = filtered;
+  event.fresh = true;
+  return filtered;
+}
+
+// The readings before this one are forgotten: the next reading alone can't be a magnet, it takes two in a row
+static void hallForget(uint8_t motorIndex){
+  hallEvents[motorIndex].recent[0] = hallThresholds[motorIndex].baseline;
+  hallEvents[motorIndex].recent[1] = hallThresholds[motorIndex].baseline;
+}
+
+// Median of three analogRead() of the hall of the motor passed, the ADC must be free
+static uint16_t hallRead(uint8_t motorIndex){
+  uint16_t a = analogRead(motorData[motorIndex].HALL);
+  uint16_t b = analogRead(motorData[motorIndex].HALL);
+  return hallMedian(a, b, analogRead(motorData[motorIndex].HALL));
+}
+
+/*
+ Checks a reading of the hall of the motor passed, once filtered, against what the hall is waiting for.
+ The magnet is there when the reading is outside 'entryLow' - 'entryHigh' of the hall (like in 'hallCheck').
+ It has moved away when, after having been seen, the reading is back inside 'exitLow' - 'exitHigh',
+ so the noise on the edge of the magnet can't be taken as a departure.
+ Returns true if what the hall was waiting for has happened.
+*/
+static bool hallProcess(uint8_t motorIndex, int reading){
+  volatile HallEvent& event = hallEvents[motorIndex];
+  volatile HallThresholds& thresholds = hallThresholds[motorIndex];
+  uint16_t filtered = hallFilter(motorIndex, reading);
+  bool magnet = filtered <= thresholds.entryLow || filtered >= thresholds.entryHigh;
+  if (event.watch == HALL_WATCH_ENTRY && magnet) {
+    motorHalt(motorIndex);  // The magnet has arrived, stop right now (only register writes, see drivers.h)
+    event.entryMicros = micros();
+    event.entryIndex = filtered <= thresholds.entryLow;
+    event.entryReading = filtered;
+    event.detected = true;
+    event.watch = HALL_WATCH_NONE;
+    return true;
+  }
+  if (event.watch == HALL_WATCH_EXIT) {
+    if (magnet) {
+      event.magnetSeen = true;
+    } else if (event.magnetSeen && filtered > thresholds.exitLow && filtered < thresholds.exitHigh) {
+      event.exitMicros = micros();
+      event.exitReading = filtered;
+      event.departed = true;
+      event.watch = HALL_WATCH_NONE;
+      return true;
+    }
+  }
+  return false;
+}
+
+#if defined(ARDUINO_ARCH_MEGAAVR)
+/*
+ ADC0 of the ATmega4809 is driven by interrupts while a hall is watched, so the loop() never waits for a conversion.
+ Each result is the sum of 1 << HALL_OVERSAMPLE_SHIFT conversions, accumulated by the ADC itself.
+ When the only watched hall is waiting for a magnet, the ADC runs free on its channel with the window comparator
+ set to 'entryLow' - 'entryHigh' of the hall: a result OUTSIDE of it fires the interrupt, and the next result is
+ checked too ('confirming'), the median turns the motor off only if that one is outside as well. Every time the
+ window comparator starts, the median forgets the readings before, so two spikes far apart can't stop the motor.
+ In every other case the watched halls are converted one after the other and each result is checked by 'hallProcess'.
+ During a capture both the halls are converted one after the other all the time, watched or not.
+*/
+// Selects the hall of the motor passed as the ADC input
+static void adcSelect(uint8_t motorIndex){
+  adcMotorIndex = motorIndex;
+  ADC0.MUXPOS = hallChannels[motorIndex];
+}
+
+// Sets the window comparator to the thresholds of the selected hall, for the accumulated results
+static void adcWindow(){
+  ADC0.WINLT = (hallThresholds[adcMotorIndex].entryLow + 1) << HALL_OVERSAMPLE_SHIFT;
+  ADC0.WINHT = (hallThresholds[adcMotorIndex].entryHigh << HALL_OVERSAMPLE_SHIFT) - 1;
+}
+
+/*
+ Configures the ADC depending on which halls are watched. Disabling the ADC aborts the conversion
+ that may be running, so no old result can be read as if it belonged to the new channel.
+ Must be called with the interrupts disabled.
+*/
+static void adcSchedule(){
+  uint8_t diskWatch = hallEvents[DISK].watch;
+  uint8_t crossWatch = hallEvents[CROSS].watch;
+  ADC0.CTRLA &= ~(ADC_ENABLE_bm | ADC_FREERUN_bm);
+  ADC0.INTCTRL = 0;
+  ADC0.INTFLAGS = ADC_RESRDY_bm | ADC_WCMP_bm;
+  ADC0.CTRLE = ADC_WINCM_NONE_gc;  // This is also what analogRead() expects
+  adcWindowing = false;
+  if (diskWatch == HALL_WATCH_NONE && crossWatch == HALL_WATCH_NONE && !hallCapturing) {
+    ADC0.CTRLB = ADC_SAMPNUM_ACC1_gc;  // A conversion for each analogRead()
+    ADC0.CTRLA |= ADC_ENABLE_bm;
+    return;
+  }
+  ADC0.CTRLB = ADC_SAMPNUM_ACC4_gc;  // 1 << HALL_OVERSAMPLE_SHIFT
+  if ((diskWatch == HALL_WATCH_NONE || crossWatch == HALL_WATCH_NONE) && !hallCapturing) {
+    adcSelect(diskWatch != HALL_WATCH_NONE ? DISK : CROSS);
+  } else {
+    adcSelect(1 - adcMotorIndex);  // Both are watched (or captured), keep alternating them
+  }
+  if (!hallCapturing && hallEvents[1 - adcMotorIndex].watch == HALL_WATCH_NONE && hallEvents[adcMotorIndex].watch == HALL_WATCH_ENTRY
+      && !hallEvents[adcMotorIndex].confirming) {
+    // The results inside the window never reach the median: a spike kept from before could confirm the next one
+    hallForget(adcMotorIndex);
+    adcWindow();
+    adcWindowing = true;
+    ADC0.CTRLE = ADC_WINCM_OUTSIDE_gc;
+    ADC0.INTCTRL = ADC_WCMP_bm;  // Only a result outside the window wakes the CPU
+    ADC0.CTRLA |= ADC_FREERUN_bm;
+  } else {
+    ADC0.INTCTRL = ADC_RESRDY_bm;  // Every result is checked and then the next hall is converted
+  }
+  ADC0.CTRLA |= ADC_ENABLE_bm;
+  ADC0.COMMAND = ADC_STCONV_bm;
+}
+
+// Free-running conversion of the watched hall went outside the window: the magnet may have arrived
+ISR(ADC0_WCOMP_vect){
+  int reading = ADC0.RES >> HALL_OVERSAMPLE_SHIFT;
+  ADC0.INTFLAGS = ADC_RESRDY_bm | ADC_WCMP_bm;
+  if (!hallProcess(adcMotorIndex, reading)) {
+    hallEvents[adcMotorIndex].confirming = true;  // The next result tells if it was a spike
+  }
+  adcSchedule();
+}
+
+// Conversion done while more than one hall (or a departure) is watched, after a result outside the window, or during a capture
+ISR(ADC0_RESRDY_vect){
+  int reading = ADC0.RES >> HALL_OVERSAMPLE_SHIFT;
+  ADC0.INTFLAGS = ADC_RESRDY_bm | ADC_WCMP_bm;
+  if (hallCapturing) {
+    captureSample(adcMotorIndex, reading);
+  }
+  if (hallProcess(adcMotorIndex, reading)) {
+    adcSchedule();  // What is watched has changed
+    return;
+  }
+  if (hallEvents[adcMotorIndex].confirming) {
+    hallEvents[adcMotorIndex].confirming = false;  // It was a spike, back to the window comparator
+    adcSchedule();
+    return;
+  }
+  if (hallCapturing || hallEvents[1 - adcMotorIndex].watch != HALL_WATCH_NONE) {
+    adcSelect(1 - adcMotorIndex);  // Convert the other hall
+  }
+  ADC0.COMMAND = ADC_STCONV_bm;
+}
+#endif
+
+// Starts watching the hall of the motor passed for the event passed, what has been seen before is forgotten
+static void hallWatch(uint8_t motorIndex, uint8_t watch){
+  noInterrupts();
+  hallEvents[motorIndex].watch = watch;
+  hallEvents[motorIndex].confirming = false;
+  if (watch != HALL_WATCH_NONE) {
+    hallForget(motorIndex);  // The readings before the arming are forgotten too
+    hallEvents[motorIndex].magnetSeen = false;
+    hallEvents[motorIndex].detected = false;
+    hallEvents[motorIndex].departed = false;
+    hallEvents[motorIndex].entryReading = 0;
+    hallEvents[motorIndex].exitReading = 0;
+  }
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  if (hallMode == HALL_MODE_WINDOW) {
+    adcSchedule();
+  }
+#endif
+  interrupts();
+}
+
+// Moves the thresholds of the hall of the motor passed with its baseline, the margins are the ones of config.cpp
+static void hallSetBaseline(uint8_t motorIndex, uint16_t baseline){
+  volatile HallThresholds& thresholds = hallThresholds[motorIndex];
+  noInterrupts();
+  thresholds.baseline = baseline;
+  thresholds.entryLow = baseline - (HALL_NOMINAL_BASELINE - hallThresholdLow);
+  thresholds.entryHigh = baseline + (hallThresholdHigh - HALL_NOMINAL_BASELINE);
+  thresholds.exitLow = thresholds.entryLow + hallHysteresis;
+  thresholds.exitHigh = thresholds.entryHigh - hallHysteresis;
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  if (adcWindowing && adcMotorIndex == motorIndex) {
+    adcWindow();
+  }
+#endif
+  interrupts();
+}
+
+/*
+ Takes a reading of the hall of the motor passed for its baseline, without disturbing what the ADC is doing:
+ the last filtered reading if there is a new one, otherwise analogRead() if the ADC is free for it, otherwise
+ (HALL_MODE_WINDOW) the last result of the free running conversion, if it belongs to this hall.
+ Returns false if there is no reading.
+*/
+static bool hallSample(uint8_t motorIndex, uint16_t* reading){
+  volatile HallEvent& event = hallEvents[motorIndex];
+  bool taken = false;
+  noInterrupts();
+  if (event.fresh) {
+    *reading = event.lastReading;
+    event.fresh = false;
+    taken = true;
+  }
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  else if (adcWindowing && adcMotorIndex == motorIndex) {
+    *reading = ADC0.RES >> HALL_OVERSAMPLE_SHIFT;
+    taken = true;
+  }
+#endif
+  interrupts();
+  if (!taken && (hallMode == HALL_MODE_POLL || hallIdle())) {
+    *reading = hallRead(motorIndex);
+    taken = true;
+  }
+  return taken;
+}
+
+// DEFINE FUNCTIONS
+/*
+ Must be called in the setup(), after 'motorsBegin'.
+ The ADC clock is raised to 1MHz so that a conversion takes ~13us instead of ~100us (a reading of a watched hall ~55us).
+ The baselines start from HALL_NOMINAL_BASELINE: at boot the motors are usually parked on their magnets.
+*/
+void hallBegin(){
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  for (int i = 0; i < 2; i++) {
+    hallChannels[i] = digitalPinToAnalogInput(motorData[i].HALL);
+  }
+  ADC0.CTRLC = (ADC0.CTRLC & ~ADC_PRESC_gm) | ADC_PRESC_DIV16_gc;
+#endif
+  for (int i = 0; i < 2; i++) {
+    hallBaselineSums[i] = HALL_NOMINAL_BASELINE << HALL_BASELINE_SHIFT;
+    hallSetBaseline(i, HALL_NOMINAL_BASELINE);
+  }
+}
+
+/*
+ From now on the hall of the motor passed is watched and the motor is turned off the moment the magnet arrives
+ (by the interrupt in HALL_MODE_WINDOW, by 'hallUpdate' in HALL_MODE_POLL).
+ While a hall is watched in HALL_MODE_WINDOW the ADC belongs to the interrupts, so analogRead() must not be used.
+*/
+void hallArm(uint8_t motorIndex){
+  hallWatch(motorIndex, HALL_WATCH_ENTRY);
+}
+
+// From now on the hall of the motor passed is watched until the magnet has come and gone
+void hallArmDeparture(uint8_t motorIndex){
+  hallWatch(motorIndex, HALL_WATCH_EXIT);
+}
+
+// Stops watching the hall of the motor passed (keeping what it has seen), the ADC is given back to analogRead() when no hall is watched
+void hallDisarm(uint8_t motorIndex){
+  hallWatch(motorIndex, HALL_WATCH_NONE);
+}
+
+// In HALL_MODE_POLL this reads the watched halls, it must be called at every loop() pass (in HALL_MODE_WINDOW it does nothing)
+void hallUpdate(){
+  for (int i = 0; i < 2; i++) {
+    if (hallMode == HALL_MODE_POLL && hallEvents[i].watch != HALL_WATCH_NONE) {
+      hallProcess(i, analogRead(motorData[i].HALL));
+    }
+  }
+}
+
+/*
+ Every HALL_BASELINE_INTERVAL a reading of each hall that is off a magnet (inside 'entryLow' - 'entryHigh')
+ moves its baseline a little, so it follows slow drifts but not the magnets: the edges of a magnet last too little to pull it.
+ A parked motor sits on its magnet, so the baselines are learned mostly while the motors move between the magnets.
+ The index magnet (see position.h) is only found under 'entryLow', far from the baseline: a motor stopped past it, or
+ leaving it slowly, reads under the baseline but inside the thresholds for a long time. So the baseline of a hall with
+ an index magnet is moved down only by the readings taken while it waits for a magnet, that is between two of them.
+*/
+void hallTick(){
+  if (millis() - hallBaselineMillis < HALL_BASELINE_INTERVAL) {
+    return;
+  }
+  hallBaselineMillis = millis();
+  for (int i = 0; i < 2; i++) {
+    uint16_t reading;
+    if (!hallSample(i, &reading) || reading <= hallThresholds[i].entryLow || reading >= hallThresholds[i].entryHigh) {
+      continue;
+    }
+    if (positionHasIndex[i] && reading < hallThresholds[i].baseline && hallEvents[i].watch != HALL_WATCH_ENTRY) {
+      continue;  // It may be the edge of the index magnet, see above
+    }
+    hallBaselineSums[i] += reading - (hallBaselineSums[i] >> HALL_BASELINE_SHIFT);
+    uint16_t baseline = constrain(hallBaselineSums[i] >> HALL_BASELINE_SHIFT,
+                                  HALL_NOMINAL_BASELINE - HALL_BASELINE_MAX_DRIFT, HALL_NOMINAL_BASELINE + HALL_BASELINE_MAX_DRIFT);
+    if (baseline != hallBaselineSums[i] >> HALL_BASELINE_SHIFT) {
+      hallBaselineSums[i] = baseline << HALL_BASELINE_SHIFT;  // Stuck at the limit, a broken hall can't push it further
+    }
+    if (baseline != hallThresholds[i].baseline) {
+      hallSetBaseline(i, baseline);
+    }
+  }
+}
+
+// Reads the hall of the motor passed, returns false if it's on a magnet. The ADC must be free (see 'hallIdle')
+bool hallCheck(uint8_t motorIndex){
+  uint16_t reading = hallRead(motorIndex);
+  return reading > hallThresholds[motorIndex].entryLow && reading < hallThresholds[motorIndex].entryHigh;
+}
+
+// Returns true once the magnet has arrived
+bool hallDetected(uint8_t motorIndex){
+  return hallEvents[motorIndex].detected;
+}
+
+// Returns true once the magnet has moved away
+bool hallDeparted(uint8_t motorIndex){
+  return hallEvents[motorIndex].departed;
+}
+
+// Returns true while no hall is watched: in HALL_MODE_WINDOW the ADC is free for analogRead() only then
+bool hallIdle(){
+  return hallEvents[DISK].watch == HALL_WATCH_NONE && hallEvents[CROSS].watch == HALL_WATCH_NONE && !hallCapturing;
+}
+
+/*
+ In HALL_MODE_WINDOW the ADC interrupts give every reading of both the halls to 'captureSample' until this is called
+ with false; in HALL_MODE_POLL the capture reads the halls by itself, from the loop().
+*/
+void hallCapture(bool on){
+  noInterrupts();
+  hallCapturing = on;
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  if (hallMode == HALL_MODE_WINDOW) {
+    adcSchedule();
+  }
+#endif
+  interrupts();
+}
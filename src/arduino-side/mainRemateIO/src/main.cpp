@@ -1,6 +1,20 @@
 #include <Arduino.h>
 // Include config header file
 #include "config.h"
+#include "motion.h"
+#include "calibration.h"
+#include "park.h"
+#include "protocol.h"
+#include "paddle.h"
+#include "slots.h"
+#include "drivers.h"
+#include "recovery.h"
+#include "program.h"
+#include "feed.h"
+#include "battery.h"
+#include "telemetry.h"
+#include "recorder.h"
+#include "capture.h"
 
 // SETUP
 void setup() {
@@ -10,67 +24,124 @@ void setup() {
   delay(serialDelay);
 
   // PINS INITIALIZATION
-  pinMode(PADDLE_NPN, OUTPUT);
+  paddleBegin();  // The paddle starts moving when the setup is over
   // Setting the disk's and cross's pins
+  motorsBegin();  // Pins of the board profile as output and motors off
   for (int i = 0; i < 2; i++) {
-    pinMode(motorData[i].COUNTER_PIN, OUTPUT);
-    pinMode(motorData[i].CLOCK_PIN, OUTPUT);
     pinMode(motorData[i].HALL, INPUT);  // Setting this to input for reading the hall's output
-    digitalWrite(motorData[i].COUNTER_PIN, LOW);
-    digitalWrite(motorData[i].CLOCK_PIN, LOW);
   }
+  hallBegin();  // The halls can now turn the motors off by themselves
 
   // CALIBRATION
-  rotateMotor(CROSS, CLOCKWISE, 1);  // Cross calibration
-  resetMotorOffset(CROSS, COUNTER_CLOCKWISE, 150);  // Adjust the cross's offset
+  calibrationLoad();  // Timings saved by the last calibration routine, if any
+  programLoad();  // Motion programs uploaded by the Rpi4, if any
+  feedBegin();  // The calibrated paddle's intervals are the ones used until the Rpi4 sends a feed rate
+  batteryBegin();  // From here on the timings are scaled for the battery's voltage
+  recorderBegin();  // The events before this boot are kept, the boot is the first new one
+  if (!parkLoad()) {  // Skipped if the last throw has parked the motors and the halls confirm it
+    startBootCalibration();  // Finished by the loop(), which sends the FRAME_READY and starts the paddle
+  } else {
+    paddleStart();
+    sendReadyToPi();  // From now on the commands of the Rpi4 are accepted
+  }
 }
 
 // LOOP
 void loop() {
-  controlPaddleMotorGoing(&paddleMotorStruct);
+  paddleTick();  // Only needed where the paddle isn't moved by the timer
+  feedTick();  // Back to the calibrated feed rate if the Rpi4 has stopped setting it
+  batteryTick();  // Follow the battery's voltage
+  hallTick();  // Follow the halls' readings without a magnet
+  telemetryTick();  // Send the timings of the phases that are over, if the serial buffer has room
+  recorderTick();  // Write the recorded events in the EEPROM, a byte at a time
+  parkTick();  // Mark the motors as parked in the EEPROM once they have been still for a while
+  captureTick();  // Sample the halls, or send what has been captured
 
-  // Get trash only if Remate is not throwing (motors aren't moving)
-  if(!isThrowing){
-    trash = TrashType(getTrashFromPi());
-    // Condition for when the Rpi4 has sent something
-    if(trash != TRASH_NONE){
-      // Stops the paddle
-      paddleMotorStruct.power = 0;
-      controlPaddleMotorPower(&paddleMotorStruct);
-      if(trash == TRASH_INCOMING){
-        // Wait max 5 seconds for the defined trash
-        ul startMillis = millis();
-        // In order to break the while or a trash is detected or 5 seconds passes
-        while(trash == TRASH_INCOMING || trash == TRASH_NONE){
-          ul currentMillisForTrashIncoming = millis();
-          trash = TrashType(getTrashFromPi());  // While waiting keeps to update the trash variable
-          delay(serialDelay);
-          // Checking if the 5 seconds max has passed
-          if(currentMillisForTrashIncoming - startMillis >= trashIncomingTimeout){
-            // Resets all the variable and restarts the loop()
-            trash = TRASH_NONE;  // Re-setting the trash variable
-            paddleMotorStruct.power = 1;  // Make the paddle move again
-            return;
-          }
-        };
+  // The Rpi4 is read at every pass, also while Remate is throwing (motors are moving)
+  TrashType received = TrashType(getTrashFromPi());
+  uint8_t receivedSeq = frameReceiver.lastCommandSeq;
+  // The fast stop line has already stopped the paddle, the defined trash is coming
+  if(received == TRASH_NONE && paddleStopRequested()){
+    received = TRASH_INCOMING;
+    receivedSeq = 0;  // It hasn't come with a frame
+  }
+  // Condition for when the Rpi4 has sent something
+  if(received != TRASH_NONE){
+    recorderAdd(RECORD_COMMAND, receivedSeq, received, batteryMillivolts);
+    // Stops the paddle
+    paddleStop();
+    if(received == TRASH_INCOMING){
+      // Wait max 5 seconds for the defined trash, the loop() keeps running meanwhile
+      awaitingTrash = true;
+      trashIncomingMillis = millis();
+    } else {
+      if(awaitingTrash){
+        // How long the class has taken to arrive after the 9
+        telemetryRecord(TELEMETRY_WAIT_CLASS, TELEMETRY_NO_AXIS, frameReceiver.lastCommandSeq,
+                        micros() - (millis() - trashIncomingMillis) * 1000UL, 0, 0, 0);
       }
-      isThrowing = true;  // This is useful for stopping the data reception from the Rpi4
-      if(trash == TRASH_METAL || trash == TRASH_PLASTIC){
-        throwPOM(trash);
-      } else {
-        throwPaper();
+      awaitingTrash = false;  // The trash (or the calibration) is in the queue, it starts as soon as the motors are free
+    }
+  }
+  // Checking if the 5 seconds max has passed without receiving the defined trash
+  if(awaitingTrash && millis() - trashIncomingMillis >= trashIncomingTimeout){
+    awaitingTrash = false;
+    telemetryRecord(TELEMETRY_WAIT_CLASS, TELEMETRY_NO_AXIS, 0, micros() - (millis() - trashIncomingMillis) * 1000UL, 0, 0, 0);
+    if(!isThrowing && commandQueue.count == 0){
+      paddleStart();  // Make the paddle move again
+    }
+  }
+
+  // Advance the running throw, this never blocks
+  bool moving = motionTick();
+  if(!moving && isBooting){
+    endBootCalibration();  // The cross is in place, the commands of the Rpi4 are accepted from now on
+    paddleStart();
+  }
+  if(!moving && motionFaulted()){
+    // A motor has got stuck: the trashes go to the unsorted bin, or the Rpi4 gets a FRAME_FAULT
+    moving = recoverFault();
+    if(!moving && commandQueue.count == 0 && !awaitingTrash){
+      paddleStart();
+    }
+  }
+  if(!moving && !calibrationTick() && !captureRunning()){  // While calibrating (or capturing) the trashes wait
+    if(isThrowing){
+      // Send feedback to Rpi4 and start moving the paddle again if nothing else is waiting
+      sendFeedbackToPi(recoveryFallback ? feedbackUnsorted : feedbackOk);
+      recoveryFallback = false;
+      if(commandQueue.count == 0 && !awaitingTrash){
+        paddleStart();
       }
-      /* 
-      else if(trash == TRASH_PAPER){  // At this point trash must be TRASH_PAPER
-        throwPaper();
+    } else if(isFlushing){
+      isFlushing = false;
+      parkSave(true);  // The motors are parked on their magnets again
+      if(commandQueue.count == 0 && !awaitingTrash){
+        paddleStart();
+      }
+    }
+    // The next command starts right after the previous one, without waiting for the Rpi4
+    QueuedCommand next;
+    QueuedCommand following;
+    TrashType expired;
+    if(popCommand(&next)){
+      if(next.command == TRASH_CALIBRATE){
+        calibrationStart(next.seq);
+      } else if(next.command == TRASH_CAPTURE){
+        captureStart(next.items, next.seq);
+      } else if(next.command == TRASH_BATCH){
+        startBatch(next.items, next.itemCount, next.seq);
+      } else if(peekCommand(&following) && canThrowTogether(next.command, following.command)){
+        // The two oldest trashes go to different motors, both of them are thrown at once
+        popCommand(&following);
+        startDualThrow(next.command, next.seq, following.command, following.seq);
       } else {
-        throwUnsorted();
-      }*/
-      // Send feedback to Rpi4 and start moving the paddle again
-      sendFeedbackToPi(feedbackOk);
-      paddleMotorStruct = {1, 0};  // Power = 1, going = 0
+        startThrow(next.command, next.seq);
+      }
+    } else if(!awaitingTrash && slotExpired(&expired)){
+      // Nothing has come to join the held trashes for too long, they are disposed alone with the paddle stopped
+      paddleStop();
+      startFlush(expired);
     }
   }
-  // Call the function for moving the paddle based on the parameters that as been changed
-  controlPaddleMotorPower(&paddleMotorStruct);
 }
\ No newline at end of file
@@ -0,0 +1,451 @@
+// Include motion header file
+#include "motion.h"
+#include "drivers.h"
+#include "battery.h"
+#include "telemetry.h"
+#include "recorder.h"
+
+// DEFINE VARIABLES
+MotionJob motionJob = {};
+
+// DEFINE FUNCTIONS
+// Sets the relays (or the transistors) of the motor passed in order to make it rotate in the direction passed, at full speed
+void driveMotor(uint8_t motorIndex, uint8_t rotationDirection){
+  motorSpeed(motorIndex, MOTOR_FULL_DUTY);
+  motorDrive(motorIndex, rotationDirection);
+}
+
+// Stops the single motor passed (braking it where the board can)
+static void stopMotor(uint8_t motorIndex){
+  motorHalt(motorIndex);
+}
+
+// Moves the motor passed to a new phase, saving when it started and how long it lasts
+static void enterPhase(uint8_t motorIndex, uint8_t phase, ul phaseDuration){
+  AxisState& axis = motionJob.axis[motorIndex];
+  axis.phase = phase;
+  axis.phaseStart = millis();
+  axis.phaseDuration = phaseDuration;
+  axis.phaseStartMicros = micros();
+}
+
+/*
+ Leaves the telemetry record of the phase of the motor passed, it must be called when the phase is over.
+ The phases timed by the hall (and the jogs) go in the flight recorder too.
+*/
+static void phaseRecord(uint8_t motorIndex, ul overshootMicros){
+  const AxisState& axis = motionJob.axis[motorIndex];
+  telemetryRecord(axis.phase, motorIndex, telemetrySeq(motorIndex), axis.phaseStartMicros,
+                  hallEvents[motorIndex].entryReading, hallEvents[motorIndex].exitReading, overshootMicros);
+  if (axis.phase == AXIS_DEPART || axis.phase == AXIS_SEEK || axis.phase == AXIS_APPROACH || axis.phase == AXIS_JOG) {
+    recorderAdd(RECORD_PHASE, motorIndex, axis.phase, min((micros() - axis.phaseStartMicros) / 1000, 0xFFFFUL));
+  }
+}
+
+// Empties the job, this must be called before queueing the steps of a new throw
+void motionClear(){
+  motionJob.count = 0;
+  motionJob.current = 0;
+  motionJob.running = false;
+  motionJob.fault = {};
+}
+
+/*
+ Appends a step to the job, if the job is full the step is discarded.
+ A step can't join the group of the previous one if it's a pause or if it needs a motor that the group already uses.
+*/
+static void motionAdd(uint8_t type, uint8_t motorIndex, uint8_t rotationDirection, uint8_t param, ul duration){
+  if (motionJob.count >= MOTION_MAX_STEPS) {
+    return;
+  }
+  for (int i = motionJob.count - 1; i >= 0 && motionJob.steps[i].withNext; i--) {
+    if (type == STEP_WAIT || motionJob.steps[i].motorIndex == motorIndex) {
+      motionJob.steps[motionJob.count - 1].withNext = false;
+      break;
+    }
+  }
+  MotionStep& step = motionJob.steps[motionJob.count++];
+  step.withNext = false;
+  step.type = type;
+  step.motorIndex = motorIndex;
+  step.rotationDirection = rotationDirection;
+  step.param = param;
+  step.duration = duration;
+}
+
+/*
+ The first parameter is the index of the motors to rotate;
+ The second one indicates in which direction the rotation must be done;
+ The third one is the times that the motor must rotate (1 times -> 1 hall detections, 2 times -> 2 hall detections...);
+*/
+void motionAddRotate(uint8_t motorIndex, uint8_t rotationDirection, uint8_t times){
+  motionAdd(STEP_ROTATE, motorIndex, rotationDirection, times, 0);
+}
+
+/*
+ Both the motors start together; each one is turned off as soon as its own hall detects a magnet,
+ the job goes on when both of them have stopped.
+*/
+void motionAddRotateSIM(uint8_t rotationDirectionDisk, uint8_t rotationDirectionCross){
+  motionAddRotate(DISK, rotationDirectionDisk, 1);
+  motionWithNext();
+  motionAddRotate(CROSS, rotationDirectionCross, 1);
+}
+
+/*
+ Due to the high speed and acceleration of the motors and the lack of precise mounting, when the motor turns off
+ the disk or the cross keeps moving for a bit. This step waits for it to stop and then brings it back
+ for 'movementDelay' millis in order to adjust the offset.
+*/
+void motionAddOffsetReset(uint8_t motorIndex, uint8_t rotationDirection, ul movementDelay){
+  motionAdd(STEP_OFFSET_RESET, motorIndex, rotationDirection, 0, movementDelay);
+}
+
+/*
+ Like 'motionAddOffsetReset', but the direction is the opposite of the last rotation of the motor (and the millis are
+ the ones in 'offsetDelays' for it), chosen when the step starts: after a STEP_MOVE_TO it isn't known before.
+*/
+void motionAddOffsetResetLast(uint8_t motorIndex){
+  motionAdd(STEP_OFFSET_RESET, motorIndex, CLOCKWISE, 1, 0);
+}
+
+/*
+ The motor rotates the shortest way to the position passed, from wherever it is when the step starts.
+ With POSITION_HOME it goes to the nearest of its home positions, so it may not have to move at all.
+*/
+void motionAddMoveTo(uint8_t motorIndex, uint8_t position){
+  motionAdd(STEP_MOVE_TO, motorIndex, CLOCKWISE, position, 0);
+}
+
+// Queues a pause of 'waitDelay' millis between two steps
+void motionAddWait(ul waitDelay){
+  motionAdd(STEP_WAIT, DISK, 0, 0, waitDelay);
+}
+
+// The next step queued will start together with the last one, if it's for the other motor
+void motionWithNext(){
+  if (motionJob.count > 0 && motionJob.steps[motionJob.count - 1].type != STEP_WAIT) {
+    motionJob.steps[motionJob.count - 1].withNext = true;
+  }
+}
+
+/*
+ Where the magnet the motor passed is counted on is for the rotation that is starting, in case the motor is off it:
+ true if behind, so it won't be crossed. A motor off its magnet has gone past it in the direction of 'lastRotation'
+ (coasting, or an adjustment too short to bring it back), unless its last offset adjustment has crossed the magnet
+ and left it: then it's before it. After a jog where it is isn't known anymore.
+*/
+static bool magnetBehind(uint8_t motorIndex){
+  AxisState& axis = motionJob.axis[motorIndex];
+  bool before = axis.adjusted && hallEvents[motorIndex].magnetSeen && hallEvents[motorIndex].departed;
+  axis.adjusted = false;
+  if (axis.retries > 0) {
+    return false;
+  }
+  return before != (axis.rotationDirection == axis.lastRotation);
+}
+
+/*
+ Makes the motor passed start moving the magnet away from the hall. The hall is watched meanwhile, so the
+ rotation can go on looking for the next magnet as soon as this one has gone, instead of always after 'rotationDelay'.
+ If the magnet isn't under the hall when it starts and it's behind the motor, the seek starts after 'departMinDelay'
+ (see 'tickAxis'): with a fast motor the next magnet could be reached within 'rotationDelay' and be taken for this one.
+*/
+static void startDeparture(uint8_t motorIndex){
+  AxisState& axis = motionJob.axis[motorIndex];
+  axis.behind = magnetBehind(motorIndex);
+  axis.moveStartMicros = micros();
+  axis.lastRotation = axis.rotationDirection;
+  driveMotor(motorIndex, axis.rotationDirection);
+  enterPhase(motorIndex, AXIS_DEPART, batteryMotorScaled(rotationDelay));
+  hallArmDeparture(motorIndex);
+}
+
+/*
+ Updates the travel time of the motor passed in the current direction, measured from the start of the rotation to the magnet.
+ It's the time at full speed: the part of the approach counts for MOTION_APPROACH_DUTY / MOTOR_FULL_DUTY of its millis,
+ otherwise the motor would slow down earlier at every rotation.
+*/
+static void learnTravel(uint8_t motorIndex){
+  AxisState& axis = motionJob.axis[motorIndex];
+  if (axis.retries > 0) {
+    return;  // A rotation that has been jogged back and retried isn't a normal one
+  }
+  ul travel = (hallEvents[motorIndex].entryMicros - axis.moveStartMicros) / 1000;
+  if (axis.phase == AXIS_APPROACH) {
+    ul slowPart = (hallEvents[motorIndex].entryMicros - axis.phaseStartMicros) / 1000;
+    travel -= slowPart - slowPart * MOTION_APPROACH_DUTY / MOTOR_FULL_DUTY;
+  }
+  ul& learned = travelMillis[motorIndex][axis.rotationDirection];
+  learned = (learned == 0) ? travel : (3 * learned + travel) / 4;
+}
+
+// Prepares the motor's state for the step passed
+static void startStep(const MotionStep& step){
+  AxisState& axis = motionJob.axis[step.motorIndex];
+  axis.retries = 0;
+  switch (step.type) {
+    case STEP_ROTATE:
+      axis.rotationDirection = step.rotationDirection;
+      axis.timesLeft = step.param;
+      // Move the motor away from the magnet or else the hall will detect it and the rotation won't be done
+      startDeparture(step.motorIndex);
+      break;
+    case STEP_MOVE_TO: {
+      uint8_t from = axisPositions[step.motorIndex].position;
+      uint8_t to = (step.param == POSITION_HOME) ? positionNearestHome(step.motorIndex, from) : step.param;
+      int8_t steps = positionShortest(from, to);
+      if (steps != 0) {  // Otherwise the motor is already there and stays idle
+        axis.rotationDirection = (steps > 0) ? CLOCKWISE : COUNTER_CLOCKWISE;
+        axis.timesLeft = abs(steps);
+        startDeparture(step.motorIndex);
+      }
+      break;
+    }
+    case STEP_OFFSET_RESET:
+      axis.adjusted = false;
+      if (step.param == 1) {
+        axis.rotationDirection = !axis.lastRotation;  // Against the last rotation
+        axis.offsetDelay = offsetDelays[step.motorIndex][axis.rotationDirection];
+      } else {
+        axis.rotationDirection = step.rotationDirection;
+        axis.offsetDelay = step.duration;
+      }
+      if (Board::brakes && axis.offsetDelay == 0) {
+        break;  // The brake has already stopped it on the magnet, there is nothing to wait for
+      }
+      stopMotor(step.motorIndex);
+      enterPhase(step.motorIndex, AXIS_SETTLE, MOTION_SETTLE_DELAY);  // Wait for the cross or disk to stop moving
+      if (telemetryEnabled) {
+        hallArmDeparture(step.motorIndex);  // Tells the telemetry if it coasts off the magnet
+      }
+      break;
+    default:  // STEP_WAIT
+      motionJob.waitStart = millis();
+      motionJob.waitStartMicros = micros();
+      break;
+  }
+}
+
+// Starts together all the steps of the group that begins at 'motionJob.current'
+static void startGroup(){
+  uint8_t i = motionJob.current;
+  startStep(motionJob.steps[i]);
+  while (motionJob.steps[i].withNext && i + 1 < motionJob.count) {
+    startStep(motionJob.steps[++i]);
+  }
+  motionJob.groupEnd = i;
+}
+
+/*
+ Millis that a rotation of the motor passed may last, from its start to the next magnet. They come from the travel
+ time learned for its direction, so a jam is found in about one more rotation; until it's learned a fixed
+ budget applies.
+*/
+static ul rotationBudget(uint8_t motorIndex){
+  ul learned = travelMillis[motorIndex][motionJob.axis[motorIndex].rotationDirection];
+  return (learned == 0) ? MOTION_BUDGET_DEFAULT : learned * MOTION_BUDGET_FACTOR + MOTION_BUDGET_MARGIN;
+}
+
+// Stops both the motors and the job, saving why and where it got stuck for the recovery (see recovery.h)
+static void motionAbort(uint8_t motorIndex, uint8_t reason){
+  for (int i = 0; i < 2; i++) {
+    stopMotor(i);
+    hallDisarm(i);
+    motionJob.axis[i].phase = AXIS_IDLE;
+  }
+  motionJob.running = false;
+  motionJob.fault.reason = reason;
+  motionJob.fault.motorIndex = motorIndex;
+  motionJob.fault.position = axisPositions[motorIndex].position;
+  recorderAdd(RECORD_FAULT, reason, motorIndex, motionJob.fault.position);
+}
+
+/*
+ The motor passed hasn't made any progress: it's jogged back for 'MOTION_JOG_DELAY' millis (freeing what has
+ wedged it, most of the times) and then the rotation is retried. After 'MOTION_MAX_RETRIES' the job is aborted.
+*/
+static void axisStalled(uint8_t motorIndex, uint8_t reason){
+  AxisState& axis = motionJob.axis[motorIndex];
+  stopMotor(motorIndex);
+  hallDisarm(motorIndex);
+  if (axis.retries >= MOTION_MAX_RETRIES) {
+    motionAbort(motorIndex, reason);
+    return;
+  }
+  axis.retries++;
+  driveMotor(motorIndex, !axis.rotationDirection);
+  enterPhase(motorIndex, AXIS_JOG, MOTION_JOG_DELAY);
+}
+
+/*
+ The motor passed has just been stopped at the end of its movement. Where the board can brake it's kept braked for
+ 'MOTION_BRAKE_DELAY' millis and then left off, the relays' motors are already off.
+*/
+static void axisStopped(uint8_t motorIndex){
+  if (Board::brakes) {
+    enterPhase(motorIndex, AXIS_BRAKE, MOTION_BRAKE_DELAY);
+  } else {
+    motionJob.axis[motorIndex].phase = AXIS_IDLE;
+  }
+}
+
+/*
+ True if the motor passed, seeking, is close enough to the next magnet to slow down: its learned travel time
+ minus MOTION_APPROACH_MARGIN has passed. Only where the board has the regulators, and once the travel is learned.
+*/
+static bool axisApproaching(uint8_t motorIndex){
+  ul learned = travelMillis[motorIndex][motionJob.axis[motorIndex].rotationDirection];
+  return Board::regulated && learned > MOTION_APPROACH_MARGIN
+         && (micros() - motionJob.axis[motorIndex].moveStartMicros) / 1000 >= learned - MOTION_APPROACH_MARGIN;
+}
+
+/*
+ Advances the phase of a single motor. Timed phases end when their duration has passed,
+ the seek and the approach phases end when the hall detects a magnet (see 'hallArm').
+*/
+static void tickAxis(uint8_t motorIndex){
+  AxisState& axis = motionJob.axis[motorIndex];
+  bool phaseElapsed = millis() - axis.phaseStart >= axis.phaseDuration;
+  switch (axis.phase) {
+    case AXIS_DEPART:
+      if (axis.behind && !hallEvents[motorIndex].magnetSeen && millis() - axis.phaseStart >= batteryMotorScaled(departMinDelay)) {
+        phaseRecord(motorIndex, 0);  // Off the magnet from the start, and it's behind: there is nothing to move away from
+        axis.phase = AXIS_SEEK;
+        axis.phaseStartMicros = micros();
+        hallArm(motorIndex);
+        break;
+      }
+      // The magnet must have gone (but not earlier than 'departMinDelay'), after 'rotationDelay' it's taken as gone anyway
+      if ((hallDeparted(motorIndex) && millis() - axis.phaseStart >= batteryMotorScaled(departMinDelay)) || phaseElapsed) {
+        phaseRecord(motorIndex, 0);
+        if (!hallDeparted(motorIndex) && hallEvents[motorIndex].magnetSeen) {
+          axisStalled(motorIndex, FAULT_STALL);  // Still on the magnet after 'rotationDelay': the motor is stuck
+          break;
+        }
+        axis.phase = AXIS_SEEK;  // Now it can start rotating until a magnet is found from the hall
+        axis.phaseStartMicros = micros();
+        hallArm(motorIndex);
+      }
+      break;
+    case AXIS_SEEK:
+    case AXIS_APPROACH:
+      if (axis.phase == AXIS_SEEK && !hallDetected(motorIndex) && axisApproaching(motorIndex)) {
+        phaseRecord(motorIndex, 0);
+        motorSpeed(motorIndex, MOTION_APPROACH_DUTY);  // The hall stays armed, it's still the same seek
+        axis.phase = AXIS_APPROACH;
+        axis.phaseStartMicros = micros();
+      }
+      if (!hallDetected(motorIndex) && (micros() - axis.moveStartMicros) / 1000 >= rotationBudget(motorIndex)) {
+        phaseRecord(motorIndex, 0);
+        axisStalled(motorIndex, FAULT_TIMEOUT);
+      } else if (hallDetected(motorIndex)) {
+        stopMotor(motorIndex);  // When a magnet is detected than the motor can be turned off (already done by the interrupt in HALL_MODE_WINDOW)
+        phaseRecord(motorIndex, 0);
+        learnTravel(motorIndex);
+        positionPass(motorIndex, axis.rotationDirection, hallEvents[motorIndex].entryIndex);
+        if (--axis.timesLeft > 0) {
+          startDeparture(motorIndex);
+        } else {
+          axisStopped(motorIndex);
+        }
+      }
+      break;
+    case AXIS_SETTLE:
+      if (phaseElapsed) {
+        // The coasting is over: how long it has gone on after the stop before leaving the magnet, if it has
+        phaseRecord(motorIndex, hallDeparted(motorIndex) ? hallEvents[motorIndex].exitMicros - axis.phaseStartMicros : 0);
+        if (axis.offsetDelay == 0) {
+          motorOff(motorIndex);  // Let the brake go
+          axis.phase = AXIS_IDLE;  // Nothing to adjust (the brake has stopped it on the magnet), not even a pass of the loop()
+          break;
+        }
+        driveMotor(motorIndex, axis.rotationDirection);
+        enterPhase(motorIndex, AXIS_OFFSET, axis.offsetDelay);  // Short time for adjusting the offset
+        hallArmDeparture(motorIndex);  // Tells the calibration and the next rotation if the adjustment has reached the magnet or passed it
+        axis.adjusted = axis.rotationDirection != axis.lastRotation;  // Only an adjustment against the rotation tells which side it's on
+      }
+      break;
+    case AXIS_OFFSET:
+      if (phaseElapsed) {
+        stopMotor(motorIndex);
+        phaseRecord(motorIndex, 0);
+        axisStopped(motorIndex);
+      }
+      break;
+    case AXIS_BRAKE:
+      if (phaseElapsed) {
+        motorOff(motorIndex);
+        phaseRecord(motorIndex, 0);
+        axis.phase = AXIS_IDLE;
+      }
+      break;
+    case AXIS_JOG:
+      if (phaseElapsed) {
+        stopMotor(motorIndex);
+        phaseRecord(motorIndex, 0);
+        startDeparture(motorIndex);  // Retry the rotation, the magnets still needed are the same
+      }
+      break;
+    default:  // AXIS_IDLE
+      break;
+  }
+}
+
+// Starts the queued steps, the job is then advanced by 'motionTick'
+void motionStart(){
+  motionJob.current = 0;
+  motionJob.fault = {};
+  motionJob.running = motionJob.count > 0;
+  if (motionJob.running) {
+    startGroup();
+  }
+}
+
+/*
+ This must be called at every loop() pass. It never blocks: it only checks if the running group of steps
+ is over and, if so, starts the next one. Returns true while the job is still running.
+*/
+bool motionTick(){
+  if (!motionJob.running) {
+    return false;
+  }
+  hallUpdate();
+  const MotionStep& step = motionJob.steps[motionJob.current];
+  bool stepDone;
+  if (step.type == STEP_WAIT) {
+    stepDone = millis() - motionJob.waitStart >= step.duration;
+    if (stepDone) {
+      telemetryRecord(TELEMETRY_PAUSE, TELEMETRY_NO_AXIS, telemetrySeq(TELEMETRY_NO_AXIS), motionJob.waitStartMicros, 0, 0, 0);
+    }
+  } else {
+    for (int i = 0; i < 2 && motionJob.running; i++) {
+      tickAxis(i);
+    }
+    if (!motionJob.running) {
+      return false;  // Aborted by a stuck motor
+    }
+    stepDone = motionJob.axis[DISK].phase == AXIS_IDLE && motionJob.axis[CROSS].phase == AXIS_IDLE;
+  }
+  if (stepDone) {
+    motionJob.current = motionJob.groupEnd + 1;
+    if (motionJob.current < motionJob.count) {
+      startGroup();
+    } else {
+      motionJob.running = false;
+      hallDisarm(DISK);  // The halls are free again, what they have seen is kept in 'hallEvents'
+      hallDisarm(CROSS);
+    }
+  }
+  return motionJob.running;
+}
+
+// Returns true while the job is running (the disk or the cross may be moving)
+bool motionBusy(){
+  return motionJob.running;
+}
+
+// Returns true if the last job has been aborted because a motor got stuck, 'motionJob.fault' tells which one
+bool motionFaulted(){
+  return motionJob.fault.reason != FAULT_NONE;
+}
@@ -0,0 +1,161 @@
+// Include program header file
+#include "program.h"
+#include "motion.h"
+#include "slots.h"
+#include <EEPROM.h>
+
+// DEFINE VARIABLES
+static ProgramStore programStore = {};
+
+// DEFINE FUNCTIONS
+// Reads the ProgramStore from the EEPROM, if its version or CRC are wrong no program has been uploaded
+void programLoad(){
+  EEPROM.get(PROGRAM_ADDRESS, programStore);
+  if (programStore.version != PROGRAM_VERSION || programStore.used > sizeof(programStore.data)
+      || programStore.crc != crc8((const uint8_t*)&programStore, sizeof(programStore) - 1)) {
+    programStore = {};
+    programStore.version = PROGRAM_VERSION;
+  }
+}
+
+// Returns the index in 'programStore.data' of the uploaded program passed, or -1 if it hasn't been uploaded
+static int programFind(uint8_t programId){
+  for (uint8_t i = 0; i + 1 < programStore.used; i += 2 + programStore.data[i + 1]) {
+    if (programStore.data[i] == programId) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*
+ A program is accepted only if all its instructions are known, their arguments are in range and its steps
+ fit in the motion job.
+*/
+bool programValid(const uint8_t* code, uint8_t length){
+  if (length > PROGRAM_MAX_LENGTH || length % 2 != 0) {
+    return false;
+  }
+  uint8_t steps = 0;
+  for (uint8_t i = 0; i < length && code[i] != OP_END; i += 2) {
+    uint8_t arg = code[i + 1];
+    switch (code[i]) {
+      case OP_MOVE:
+        if ((arg >> 2) == 0) {
+          return false;  // A move of no magnets at all
+        }
+        steps++;
+        break;
+      case OP_MOVE_BOTH:
+        steps += 2;
+        break;
+      case OP_MOVE_TO:
+        if ((arg >> 1) >= MOTOR_POSITIONS && (arg >> 1) != PROGRAM_POSITION_HOME) {
+          return false;
+        }
+        steps++;
+        break;
+      case OP_SETTLE:
+        steps++;
+        break;
+      case OP_CORRECT:
+        if (arg > CROSS) {
+          return false;
+        }
+        steps++;
+        break;
+      case OP_TOGETHER:
+        break;
+      case OP_SLOT:
+        if ((arg & 0x7F) == TRASH_NONE || (arg & 0x7F) > TRASH_UNSORTED) {
+          return false;
+        }
+        break;
+      default:
+        return false;
+    }
+  }
+  return steps <= MOTION_MAX_STEPS;
+}
+
+/*
+ Replaces the uploaded program passed (a length of 0 removes it, the default one is used again) and writes the
+ ProgramStore in the EEPROM. The other uploaded programs are kept. Returns false if there is no room for it.
+*/
+bool programSave(uint8_t programId, const uint8_t* code, uint8_t length){
+  ProgramStore store = {};
+  store.version = PROGRAM_VERSION;
+  for (uint8_t i = 0; i + 1 < programStore.used; i += 2 + programStore.data[i + 1]) {
+    if (programStore.data[i] != programId) {
+      memcpy(&store.data[store.used], &programStore.data[i], 2 + programStore.data[i + 1]);
+      store.used += 2 + programStore.data[i + 1];
+    }
+  }
+  if (length > 0) {
+    if (store.used + 2 + length > (int)sizeof(store.data)) {
+      return false;
+    }
+    store.data[store.used++] = programId;
+    store.data[store.used++] = length;
+    memcpy(&store.data[store.used], code, length);
+    store.used += length;
+  }
+  store.crc = crc8((const uint8_t*)&store, sizeof(store) - 1);
+  programStore = store;
+  EEPROM.put(PROGRAM_ADDRESS, programStore);  // Only the bytes that have changed are written
+  return true;
+}
+
+// Turns a single instruction into the steps of the motion job
+static void programStep(uint8_t operation, uint8_t arg){
+  switch (operation) {
+    case OP_MOVE:
+      motionAddRotate(arg & 1, (arg >> 1) & 1, arg >> 2);
+      break;
+    case OP_MOVE_BOTH:
+      motionAddRotateSIM(arg & 1, (arg >> 1) & 1);  // Simultaneously rotates both the disk's motor and the cross's motor
+      break;
+    case OP_MOVE_TO:
+      motionAddMoveTo(arg & 1, ((arg >> 1) == PROGRAM_POSITION_HOME) ? POSITION_HOME : arg >> 1);
+      break;
+    case OP_SETTLE:
+      motionAddWait((arg == 0) ? serialDelay : arg * 10UL);
+      break;
+    case OP_CORRECT:
+      motionAddOffsetResetLast(arg);  // Adjusting the offset post-rotation
+      break;
+    case OP_TOGETHER:
+      motionWithNext();
+      break;
+    case OP_SLOT:
+      if (arg & 0x80) {
+        slotHold(TrashType(arg & 0x7F));
+      } else {
+        slotRelease(TrashType(arg & 0x7F));
+      }
+      break;
+    default:  // OP_END
+      break;
+  }
+}
+
+/*
+ Queues the program passed, the uploaded one if there is one, or else the default one. The slots are
+ updated right away, as if the program were already over.
+*/
+void programQueue(uint8_t programId){
+  uint8_t code[PROGRAM_MAX_LENGTH] = {};
+  uint8_t length = PROGRAM_MAX_LENGTH;
+  int index = programFind(programId);
+  if (index >= 0) {
+    length = programStore.data[index + 1];
+    memcpy(code, &programStore.data[index + 2], length);
+  } else if (programId < PROGRAM_COUNT) {
+    for (uint8_t i = 0; i < PROGRAM_MAX_LENGTH; i++) {
+      code[i] = pgm_read_byte(&motionPrograms[programId][i]);
+    }
+  }
+  for (uint8_t i = 0; i + 1 < length && code[i] != OP_END; i += 2) {
+    programStep(code[i], code[i + 1]);
+  }
+}
@@ -0,0 +1,150 @@
+// Include recorder header file
+#include "recorder.h"
+#include "battery.h"
+#include <EEPROM.h>
+
+// DEFINE VARIABLES
+static RecorderEntry recorderQueue[RECORDER_QUEUE_SIZE];  // Ring of the events waiting to be written
+static uint8_t recorderHead = 0;                          // Index of the oldest event waiting
+static uint8_t recorderCount = 0;                         // Number of events waiting
+static uint8_t recorderSlot = 0;                          // Slot of the EEPROM ring the oldest event waiting goes to
+static uint8_t recorderByte = 0;                          // Writes of that event already done (see 'recorderTick')
+static uint8_t recorderStamp = 1;                         // Stamp of the next event queued
+static RecorderEntry recorderHistory[RECORDER_HISTORY_SIZE];  // Ring of the last routine events, not written
+static uint8_t recorderHistoryHead = 0;                       // Index of the oldest routine event kept
+static uint8_t recorderHistoryCount = 0;                      // Number of routine events kept
+
+// DEFINE FUNCTIONS
+// Stamp that follows the one passed
+static uint8_t recorderNext(uint8_t stamp){
+  return stamp % RECORDER_LAST_STAMP + 1;
+}
+
+static bool recorderValid(uint8_t stamp){
+  return stamp != 0 && stamp <= RECORDER_LAST_STAMP;
+}
+
+// EEPROM address of the stamp of the slot passed
+static int recorderAddress(uint8_t slot){
+  return RECORDER_ADDRESS + slot * sizeof(RecorderEntry);
+}
+
+/*
+ The newest entry is the only valid one that the next slot (going round the ring) doesn't follow.
+ An erased ring has no valid entry at all, the events start from slot 0.
+*/
+static int recorderNewest(){
+  for (uint8_t slot = 0; slot < RECORDER_SLOTS; slot++) {
+    uint8_t stamp = EEPROM.read(recorderAddress(slot));
+    if (recorderValid(stamp) && EEPROM.read(recorderAddress((slot + 1) % RECORDER_SLOTS)) != recorderNext(stamp)) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+// Must be called after 'batteryBegin', so the boot can be recorded with the battery's voltage
+void recorderBegin(){
+  int newest = recorderNewest();
+  if (newest >= 0) {
+    recorderSlot = (newest + 1) % RECORDER_SLOTS;
+    recorderStamp = recorderNext(EEPROM.read(recorderAddress(newest)));
+  }
+  uint8_t resetFlags = 0;
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  resetFlags = RSTCTRL.RSTFR;
+  RSTCTRL.RSTFR = resetFlags;  // Cleared (writing ones), so the next reset has only its own flags
+#endif
+  recorderAdd(RECORD_BOOT, resetFlags, 0, batteryMillivolts);
+}
+
+// Queues the event passed to be written, with the next stamp. The queue has room (see 'recorderAdd')
+static void recorderQueueEntry(const RecorderEntry& event){
+  RecorderEntry& entry = recorderQueue[(recorderHead + recorderCount++) % RECORDER_QUEUE_SIZE];
+  entry = event;
+  entry.stamp = recorderStamp;
+  recorderStamp = recorderNext(recorderStamp);
+}
+
+/*
+ Does nothing but copying the event, it can be called while the motors are moving.
+ A routine event takes the place of the oldest one in the history. A fault or a boot is queued to be written after
+ the history, whose oldest events are dropped if the queue hasn't room for all of them: the EEPROM can't keep up,
+ the ring would lose old events anyway.
+*/
+void recorderAdd(uint8_t type, uint8_t arg, uint8_t aux, uint16_t value){
+  RecorderEntry event = {0, type, arg, aux, uint16_t(millis()), value};
+  if (type != RECORD_BOOT && type != RECORD_FAULT) {
+    recorderHistory[(recorderHistoryHead + recorderHistoryCount) % RECORDER_HISTORY_SIZE] = event;
+    if (recorderHistoryCount < RECORDER_HISTORY_SIZE) {
+      recorderHistoryCount++;
+    } else {
+      recorderHistoryHead = (recorderHistoryHead + 1) % RECORDER_HISTORY_SIZE;
+    }
+    return;
+  }
+  if (recorderCount >= RECORDER_QUEUE_SIZE) {
+    return;
+  }
+  while (recorderHistoryCount > 0) {
+    if (recorderHistoryCount < RECORDER_QUEUE_SIZE - recorderCount) {
+      recorderQueueEntry(recorderHistory[recorderHistoryHead]);
+    }
+    recorderHistoryHead = (recorderHistoryHead + 1) % RECORDER_HISTORY_SIZE;
+    recorderHistoryCount--;
+  }
+  recorderQueueEntry(event);
+}
+
+/*
+ Writes a single byte of the oldest event waiting, and only if the EEPROM has finished the write before:
+ on the ATmega4809 a write takes a few millis, waiting for it would stop the loop().
+ The stamp is cleared first and written last, so an entry cut by a reset is never taken as a valid one.
+*/
+void recorderTick(){
+  if (recorderCount == 0) {
+    return;
+  }
+#if defined(ARDUINO_ARCH_MEGAAVR)
+  if (NVMCTRL.STATUS & NVMCTRL_EEBUSY_bm) {
+    return;
+  }
+#endif
+  const uint8_t* bytes = (const uint8_t*)&recorderQueue[recorderHead];
+  if (recorderByte == 0) {
+    EEPROM.update(recorderAddress(recorderSlot), 0);
+  } else {
+    uint8_t index = recorderByte % sizeof(RecorderEntry);  // 1, 2, ... and then the stamp (0)
+    EEPROM.update(recorderAddress(recorderSlot) + index, bytes[index]);
+  }
+  if (++recorderByte <= sizeof(RecorderEntry)) {
+    return;
+  }
+  recorderByte = 0;
+  recorderSlot = (recorderSlot + 1) % RECORDER_SLOTS;
+  recorderHead = (recorderHead + 1) % RECORDER_QUEUE_SIZE;
+  recorderCount--;
+}
+
+/*
+ Copies the entries of the EEPROM ring in 'entries', from the oldest to the newest: going back from the newest,
+ as long as each entry is followed by the next one. The slot being written right now isn't part of them.
+*/
+uint8_t recorderRead(RecorderEntry entries[RECORDER_SLOTS]){
+  int newest = recorderNewest();
+  if (newest < 0) {
+    return 0;
+  }
+  uint8_t count = 1;
+  EEPROM.get(recorderAddress(newest), entries[RECORDER_SLOTS - 1]);
+  while (count < RECORDER_SLOTS) {
+    RecorderEntry& entry = entries[RECORDER_SLOTS - 1 - count];
+    EEPROM.get(recorderAddress((newest + RECORDER_SLOTS - count) % RECORDER_SLOTS), entry);
+    if (!recorderValid(entry.stamp) || recorderNext(entry.stamp) != entries[RECORDER_SLOTS - count].stamp) {
+      break;
+    }
+    count++;
+  }
+  memmove(entries, entries + RECORDER_SLOTS - count, count * sizeof(RecorderEntry));
+  return count;
+}
@@ -0,0 +1,89 @@
+// Include slots header file
+#include "slots.h"
+
+// DEFINE VARIABLES
+/*
+ Only the paper has a holding position on this Remate: the cross parks one on the disk and the next one is
+ disposed together with it. The other classes are disposed by a single motor and are never held.
+*/
+const SlotPolicy slotPolicies[TRASH_UNSORTED + 1] = {
+  {0, 0},      // TRASH_NONE
+  {1, 60000},  // TRASH_PAPER
+  {0, 0},      // TRASH_METAL
+  {0, 0},      // TRASH_PLASTIC
+  {0, 0},      // TRASH_UNSORTED
+};
+SlotRing slotRing = {};
+
+// DEFINE FUNCTIONS
+// Index in 'slotRing' of the i-th oldest trash
+static uint8_t slotIndex(uint8_t i){
+  return (slotRing.head + i) % SLOT_COUNT;
+}
+
+/*
+ A trash is held while its class has room left (and there is a free slot at all), otherwise it's disposed
+ together with the ones already waiting. The classes without a policy are always disposed right away.
+*/
+SlotDecision slotDecide(TrashType trashType){
+  if (trashType > TRASH_UNSORTED || slotPolicies[trashType].maxHeld == 0) {
+    return SLOT_DIRECT;
+  }
+  if (slotHeld(trashType) < slotPolicies[trashType].maxHeld && slotRing.count < SLOT_COUNT) {
+    return SLOT_HOLD;
+  }
+  return SLOT_FLUSH;
+}
+
+// Counts the held trashes of the class passed
+uint8_t slotHeld(TrashType trashType){
+  uint8_t held = 0;
+  for (uint8_t i = 0; i < slotRing.count; i++) {
+    if (slotRing.items[slotIndex(i)] == trashType) {
+      held++;
+    }
+  }
+  return held;
+}
+
+// Parks a trash after the newest one, nothing is done if all the slots are taken
+void slotHold(TrashType trashType){
+  if (slotRing.count >= SLOT_COUNT) {
+    return;
+  }
+  uint8_t index = slotIndex(slotRing.count++);
+  slotRing.items[index] = trashType;
+  slotRing.heldMillis[index] = millis();
+}
+
+/*
+ Frees the slots of the class passed. The trashes of the other classes keep their order: the ones in front
+ are moved forward, so when the released trashes are the oldest (the usual case) only 'head' moves.
+*/
+void slotRelease(TrashType trashType){
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < slotRing.count; i++) {
+    uint8_t from = slotIndex(slotRing.count - 1 - i);
+    if (slotRing.items[from] == trashType) {
+      continue;
+    }
+    uint8_t to = slotIndex(slotRing.count - 1 - kept++);
+    slotRing.items[to] = slotRing.items[from];
+    slotRing.heldMillis[to] = slotRing.heldMillis[from];
+  }
+  slotRing.head = slotIndex(slotRing.count - kept);
+  slotRing.count = kept;
+}
+
+// Looks for a held trash whose class has a timeout that has passed, its class is written in 'trashType'
+bool slotExpired(TrashType* trashType){
+  for (uint8_t i = 0; i < slotRing.count; i++) {
+    uint8_t index = slotIndex(i);
+    ul holdTimeout = slotPolicies[slotRing.items[index]].holdTimeout;
+    if (holdTimeout > 0 && millis() - slotRing.heldMillis[index] >= holdTimeout) {
+      *trashType = slotRing.items[index];
+      return true;
+    }
+  }
+  return false;
+}
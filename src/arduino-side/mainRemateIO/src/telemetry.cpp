@@ -0,0 +1,85 @@
+// Include telemetry header file
+#include "telemetry.h"
+#include "protocol.h"
+#include "hall.h"
+
+// DEFINE VARIABLES
+bool telemetryEnabled = false;
+static TelemetryRecord telemetryQueue[TELEMETRY_QUEUE_SIZE];  // Ring of the records waiting to be sent
+static uint8_t telemetryHead = 0;                             // Index of the oldest record
+static uint8_t telemetryCount = 0;                            // Number of records in the ring
+static uint8_t telemetryLost = 0;                             // Records lost since the last one queued
+
+// DEFINE FUNCTIONS
+// Does nothing while the telemetry is off, so it can be called from everywhere
+void telemetryRecord(uint8_t phase, uint8_t axis, uint8_t seq, ul startMicros,
+                     uint16_t hallEntry, uint16_t hallExit, ul overshootMicros){
+  if (!telemetryEnabled) {
+    return;
+  }
+  if (telemetryCount >= TELEMETRY_QUEUE_SIZE) {
+    if (telemetryLost < 255) {
+      telemetryLost++;
+    }
+    return;
+  }
+  TelemetryRecord& record = telemetryQueue[(telemetryHead + telemetryCount++) % TELEMETRY_QUEUE_SIZE];
+  record.startMicros = startMicros;
+  record.durationMicros = micros() - startMicros;
+  record.seq = seq;
+  record.phase = phase;
+  record.axis = axis;
+  record.hallEntry = hallEntry;
+  record.hallExit = hallExit;
+  record.overshootMicros = overshootMicros;
+  record.lost = telemetryLost;
+  record.hallBaseline = (axis == TELEMETRY_NO_AXIS) ? 0 : hallThresholds[axis].baseline;
+  record.hallLow = (axis == TELEMETRY_NO_AXIS) ? 0 : hallThresholds[axis].entryLow;
+  record.hallHigh = (axis == TELEMETRY_NO_AXIS) ? 0 : hallThresholds[axis].entryHigh;
+  telemetryLost = 0;
+}
+
+/*
+ During a dual throw the disk moves for the metal and the cross for the plastic, each with its own command.
+ The motors of a flush (or of the boot) aren't moving for a command, what isn't about a motor goes with the first trash.
+*/
+uint8_t telemetrySeq(uint8_t motorIndex){
+  if (!isThrowing) {
+    return 0;
+  }
+  if (motorIndex != TELEMETRY_NO_AXIS && dualTrash != TRASH_NONE && (motorIndex == DISK) == (dualTrash == TRASH_METAL)) {
+    return dualSeq;
+  }
+  return throwSeq;
+}
+
+// Writes the value passed little endian in 'bytes' and returns where the next value goes
+static uint8_t* telemetryPut(uint8_t* bytes, ul value, uint8_t length){
+  for (uint8_t i = 0; i < length; i++) {
+    *bytes++ = uint8_t(value >> (8 * i));
+  }
+  return bytes;
+}
+
+// A record is sent only if the whole frame fits in the serial buffer, Serial.write() would wait otherwise
+void telemetryTick(){
+  while (telemetryCount > 0 && Serial.availableForWrite() >= TELEMETRY_RECORD_SIZE + 5 + TELEMETRY_TX_MARGIN) {
+    const TelemetryRecord& record = telemetryQueue[telemetryHead];
+    uint8_t payload[TELEMETRY_RECORD_SIZE];
+    uint8_t* next = telemetryPut(payload, record.startMicros, 4);
+    next = telemetryPut(next, record.durationMicros, 4);
+    next = telemetryPut(next, record.seq, 1);
+    next = telemetryPut(next, record.phase, 1);
+    next = telemetryPut(next, record.axis, 1);
+    next = telemetryPut(next, record.hallEntry, 2);
+    next = telemetryPut(next, record.hallExit, 2);
+    next = telemetryPut(next, record.overshootMicros, 4);
+    next = telemetryPut(next, record.lost, 1);
+    next = telemetryPut(next, record.hallBaseline, 2);
+    next = telemetryPut(next, record.hallLow, 2);
+    telemetryPut(next, record.hallHigh, 2);
+    sendFrame(FRAME_TELEMETRY, 0, payload, sizeof(payload));
+    telemetryHead = (telemetryHead + 1) % TELEMETRY_QUEUE_SIZE;
+    telemetryCount--;
+  }
+}
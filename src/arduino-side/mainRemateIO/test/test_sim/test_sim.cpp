@@ -0,0 +1,285 @@
+// Include sim header file
+#include <sim.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include "park.h"
+#include "position.h"
+#include "hall.h"
+#include "recorder.h"
+#include "motion.h"
+
+/*
+ The firmware in the simulation of lib/RemateSim, run with: pio test -e native -e native_transistor -e native_index
+ Every board and the index magnet have to pass them all.
+ Its variables can't be reset, so the tests are a single boot and run in order, each one from where the previous has left it.
+*/
+
+// DEFINITION
+#define TEST_MAX_ERROR 15.0  // Degrees from its magnet an axis may end a throw at
+#define TEST_DUAL_MILLIS 20  // Max millis between the FRAME_DONEs of two trashes thrown together
+#define TEST_UNSORTED_POSITION 2  // Position of the disk over the unsorted bin, half a turn (see PROGRAM_UNSORTED)
+
+// DEFINE VARIABLES
+static SimItem testItems[8];
+static SimStream testStream;
+
+// A new stream with the trashes passed, all of them arrived already
+static void testStart(const uint8_t* trashes, uint8_t count){
+  memset(testItems, 0, sizeof(testItems));
+  memset(&testStream, 0, sizeof(testStream));
+  for (uint8_t i = 0; i < count; i++) {
+    testItems[i].trash = trashes[i];
+  }
+  testStream.items = testItems;
+  testStream.itemCount = count;
+  simPeerBegin(&testStream);
+}
+
+static bool testReady(){
+  return simReady;
+}
+
+static bool testNever(){
+  return false;
+}
+
+// Most writes of a cell of the ParkRecord
+static uint32_t testParkWear(){
+  return simEepromWear(PARK_ADDRESS, PARK_ADDRESS + sizeof(ParkRecord));
+}
+
+// Most writes of a cell of the recorder's ring
+static uint32_t testRecorderWear(){
+  return simEepromWear(RECORDER_ADDRESS, RECORDER_ADDRESS + RECORDER_SLOTS * sizeof(RecorderEntry));
+}
+
+// True if every pin of the motors is low: nothing is driven, and where the board brakes the brake has been let go
+static bool testMotorsOff(){
+  const uint8_t relayPins[] = {CLOCK_DISK_PIN, COUNTER_DISK_PIN, CLOCK_CROSS_PIN, COUNTER_CROSS_PIN};
+  const uint8_t transistorPins[] = {CLOCK_DISK_PNP, COUNTER_DISK_PNP, CLOCK_DISK_NPN, COUNTER_DISK_NPN,
+                                    CLOCK_CROSS_PNP, COUNTER_CROSS_PNP, CLOCK_CROSS_NPN, COUNTER_CROSS_NPN};
+  const uint8_t* pins = (boardVariant == BOARD_RELAY) ? relayPins : transistorPins;
+  uint8_t count = (boardVariant == BOARD_RELAY) ? sizeof(relayPins) : sizeof(transistorPins);
+  for (uint8_t i = 0; i < count; i++) {
+    if (simPinState(pins[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ Positions the disk has been on to throw the trash of the stream passed. A trash thrown together with another one
+ (see 'throwPOMTogether') gets the positions of both, because their FRAME_DONEs arrive one after the other.
+*/
+static uint8_t testDiskPositions(uint8_t item, uint8_t count){
+  uint8_t positions = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    ul from = min(testItems[i].doneMillis, testItems[item].doneMillis);
+    if (max(testItems[i].doneMillis, testItems[item].doneMillis) - from <= TEST_DUAL_MILLIS) {
+      positions |= testItems[i].diskPositions;
+    }
+  }
+  return positions;
+}
+
+void setUp(){
+}
+
+void tearDown(){
+}
+
+/*
+ The firmware boots and says it speaks the protocol of protocol.h. The EEPROM is erased, so the cross is calibrated
+ first: setup() doesn't wait for it, the loop() does and only then sends the FRAME_READY.
+*/
+void test_ready(){
+  simBegin();
+  testStart(NULL, 0);
+  setup();
+  TEST_ASSERT_TRUE(motionJob.running);
+  TEST_ASSERT_FALSE(simRunUntil(testReady, 100));
+  TEST_ASSERT_TRUE(simRunUntil(testReady, 10000));
+  TEST_ASSERT_FALSE(motionJob.running);
+  TEST_ASSERT_EQUAL_UINT8(PROTOCOL_VERSION, simVersion);
+  TEST_ASSERT_EQUAL_UINT8(COMMAND_QUEUE_SIZE, simQueueSize);
+}
+
+// Every class is sorted, and after each throw the axes are on the magnet the firmware counts
+void test_mixed_stream(){
+  const uint8_t trashes[] = {TRASH_PAPER, TRASH_METAL, TRASH_PLASTIC, TRASH_UNSORTED,
+                             TRASH_PLASTIC, TRASH_METAL, TRASH_METAL, TRASH_PAPER};
+  testStart(trashes, sizeof(trashes));
+  TEST_ASSERT_TRUE(simRunUntil(simPeerFinished, 120000));
+  for (uint8_t i = 0; i < sizeof(trashes); i++) {
+    TEST_ASSERT_EQUAL_UINT8(feedbackOk, testItems[i].feedback);
+    TEST_ASSERT_TRUE(testItems[i].positionError[DISK] < TEST_MAX_ERROR);
+    TEST_ASSERT_TRUE(testItems[i].positionError[CROSS] < TEST_MAX_ERROR);
+    // Each trash has gone over its own bin, and none but the unsorted ones over the unsorted bin
+    uint8_t positions = testDiskPositions(i, sizeof(trashes));
+    TEST_ASSERT_EQUAL(trashes[i] == TRASH_UNSORTED, (positions & (1 << TEST_UNSORTED_POSITION)) != 0);
+    if (trashes[i] == TRASH_METAL) {
+      TEST_ASSERT_TRUE(positions & (1 << DISK_METAL_POSITION));
+    } else if (trashes[i] == TRASH_PAPER && i == sizeof(trashes) - 1) {
+      TEST_ASSERT_TRUE(positions & (1 << DISK_PAPER_POSITION));  // The two papers are disposed together with this one
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT16(0, simFaults);
+  TEST_ASSERT_EQUAL_UINT16(0, simLinkErrors);
+  TEST_ASSERT_EQUAL_UINT32(0, simRxOverruns);
+  TEST_ASSERT_TRUE(testMotorsOff());
+}
+
+// Throws back to back don't write the parked state, it's written once when the motors stay still. The recorder writes nothing
+void test_park_wear(){
+  const uint8_t trashes[] = {TRASH_METAL, TRASH_PLASTIC, TRASH_METAL, TRASH_PLASTIC};
+  uint32_t wear = testParkWear();
+  uint32_t recorderWear = testRecorderWear();
+  testStart(trashes, sizeof(trashes));
+  TEST_ASSERT_TRUE(simRunUntil(simPeerFinished, 60000));
+  TEST_ASSERT_EQUAL_UINT32(wear, testParkWear());
+  TEST_ASSERT_EQUAL_UINT32(recorderWear, testRecorderWear());
+  simRunUntil(testNever, PARK_IDLE_DELAY + 1000);
+  TEST_ASSERT_TRUE(testParkWear() <= wear + 1);
+  ParkRecord record;
+  EEPROM.get(PARK_ADDRESS, record);
+  TEST_ASSERT_EQUAL_UINT8(1, record.clean);
+  TEST_ASSERT_EQUAL_UINT8(crc8((const uint8_t*)&record, sizeof(record) - 1), record.crc);
+}
+
+// Commands broken on the way are sent again after the newer ones, and they are still thrown
+void test_broken_frames(){
+  const uint8_t trashes[] = {TRASH_METAL, TRASH_PLASTIC, TRASH_METAL, TRASH_PLASTIC, TRASH_METAL, TRASH_PLASTIC};
+  simConfig.corruptEvery = 3;
+  testStart(trashes, sizeof(trashes));
+  TEST_ASSERT_TRUE(simRunUntil(simPeerFinished, 60000));
+  simConfig.corruptEvery = 0;
+  for (uint8_t i = 0; i < sizeof(trashes); i++) {
+    TEST_ASSERT_EQUAL_UINT8(feedbackOk, testItems[i].feedback);
+  }
+  TEST_ASSERT_TRUE(simLinkErrors > 0);
+}
+
+/*
+ The disk turned by a magnet while it was still: its index magnet (built with REMATE_INDEX_MAGNET) puts the count right
+ within a few throws. Without it nothing can notice, the count stays wrong and the disk is turned back for the next tests.
+*/
+void test_index_magnet(){
+  const uint8_t trashes[] = {TRASH_METAL, TRASH_PLASTIC, TRASH_METAL, TRASH_PLASTIC};
+  uint8_t indexErrors = axisPositions[DISK].indexErrors;
+  simAxes[DISK].angle = fmod(simAxes[DISK].angle + 360.0 / MOTOR_POSITIONS, 360.0);
+  testStart(trashes, sizeof(trashes));
+  TEST_ASSERT_TRUE(simRunUntil(simPeerFinished, 60000));
+  const SimItem& last = testItems[sizeof(trashes) - 1];
+#if defined(REMATE_INDEX_MAGNET)
+  TEST_ASSERT_TRUE(axisPositions[DISK].indexErrors > indexErrors);
+  TEST_ASSERT_TRUE(last.positionError[DISK] < TEST_MAX_ERROR);
+  TEST_ASSERT_INT_WITHIN(hallHysteresis, int(simConfig.hallBaseline), hallThresholds[DISK].baseline);  // Not dragged down by the index magnet
+#else
+  TEST_ASSERT_EQUAL_UINT8(indexErrors, axisPositions[DISK].indexErrors);
+  TEST_ASSERT_TRUE(last.positionError[DISK] > 180.0 / MOTOR_POSITIONS);
+  simAxes[DISK].angle = fmod(simAxes[DISK].angle + 360.0 - 360.0 / MOTOR_POSITIONS, 360.0);
+#endif
+}
+
+/*
+ A disk stuck for the whole throw is reported with a FRAME_FAULT, not with a FRAME_DONE on the wrong magnet.
+ The fault is in the recorder, right after the command that has led to it.
+*/
+void test_jammed_disk(){
+  const uint8_t trashes[] = {TRASH_METAL};
+  simConfig.jamAxis = DISK;
+  simConfig.jamFromMillis = millis();
+  simConfig.jamToMillis = millis() + 60000;
+  testStart(trashes, sizeof(trashes));
+  TEST_ASSERT_TRUE(simRunUntil(simPeerFinished, 60000));
+  TEST_ASSERT_EQUAL_UINT8(0, testItems[0].feedback);
+  TEST_ASSERT_EQUAL_UINT16(1, simFaults);
+  RecorderEntry entries[RECORDER_SLOTS];
+  uint8_t count = recorderRead(entries);
+  uint8_t fault = count;
+  for (uint8_t i = 0; i < count; i++) {
+    if (entries[i].type == RECORD_FAULT) {
+      fault = i;
+    }
+  }
+  TEST_ASSERT_TRUE(fault < count);
+  uint8_t command = fault;
+  while (command > 0 && entries[command].type != RECORD_COMMAND) {
+    command--;
+  }
+  TEST_ASSERT_EQUAL_UINT8(RECORD_COMMAND, entries[command].type);
+  TEST_ASSERT_EQUAL_UINT8(TRASH_METAL, entries[command].aux);
+}
+
+// Once the disk is free again the trashes are thrown (in the unsorted bin while the firmware recovers)
+void test_after_jam(){
+  const uint8_t trashes[] = {TRASH_METAL, TRASH_METAL};
+  simConfig.jamAxis = -1;
+  testStart(trashes, sizeof(trashes));
+  TEST_ASSERT_TRUE(simRunUntil(simPeerFinished, 60000));
+  for (uint8_t i = 0; i < sizeof(trashes); i++) {
+    TEST_ASSERT_TRUE(testItems[i].feedback == feedbackOk || testItems[i].feedback == feedbackUnsorted);
+  }
+  TEST_ASSERT_EQUAL_UINT16(0, simFaults);
+}
+
+/*
+ Motors half again as fast as the ones the default timings are tuned for: they coast far past the magnets and the
+ offset adjustments don't bring them back, but every rotation still counts the right magnets.
+*/
+void test_fast_motors(){
+  const uint8_t trashes[] = {TRASH_PLASTIC, TRASH_PLASTIC, TRASH_METAL, TRASH_PAPER, TRASH_UNSORTED,
+                             TRASH_METAL, TRASH_PLASTIC, TRASH_PAPER};
+  for (int i = 0; i < 2; i++) {
+    simConfig.axes[i].maxSpeed *= 1.5;
+  }
+  testStart(trashes, sizeof(trashes));
+  TEST_ASSERT_TRUE(simRunUntil(simPeerFinished, 120000));
+  for (int i = 0; i < 2; i++) {
+    simConfig.axes[i].maxSpeed /= 1.5;
+  }
+  for (uint8_t i = 0; i < sizeof(trashes); i++) {
+    TEST_ASSERT_EQUAL_UINT8(feedbackOk, testItems[i].feedback);
+    TEST_ASSERT_TRUE(testItems[i].positionError[DISK] < 180.0 / MOTOR_POSITIONS);
+    TEST_ASSERT_TRUE(testItems[i].positionError[CROSS] < 180.0 / MOTOR_POSITIONS);
+  }
+  TEST_ASSERT_EQUAL_UINT16(0, simFaults);
+}
+
+/*
+ The calibration run on motors faster than the ones the defaults are tuned for: the adjustments it learns bring every
+ throw back on its magnet (one that reaches the next magnet by going past the right one isn't taken as right).
+*/
+void test_calibration_speed(){
+  const uint8_t trashes[] = {TRASH_CALIBRATE, TRASH_PLASTIC, TRASH_METAL, TRASH_PAPER, TRASH_PLASTIC,
+                             TRASH_UNSORTED, TRASH_METAL, TRASH_PLASTIC};
+  for (int i = 0; i < 2; i++) {
+    simConfig.axes[i].maxSpeed *= 1.3;
+  }
+  testStart(trashes, sizeof(trashes));
+  TEST_ASSERT_TRUE(simRunUntil(simPeerFinished, 180000));
+  for (int i = 0; i < 2; i++) {
+    simConfig.axes[i].maxSpeed /= 1.3;
+  }
+  for (uint8_t i = 0; i < sizeof(trashes); i++) {
+    TEST_ASSERT_EQUAL_UINT8(feedbackOk, testItems[i].feedback);
+    TEST_ASSERT_TRUE(testItems[i].positionError[DISK] < TEST_MAX_ERROR);
+    TEST_ASSERT_TRUE(testItems[i].positionError[CROSS] < TEST_MAX_ERROR);
+  }
+  TEST_ASSERT_EQUAL_UINT16(0, simFaults);
+}
+
+int main(){
+  UNITY_BEGIN();
+  RUN_TEST(test_ready);
+  RUN_TEST(test_mixed_stream);
+  RUN_TEST(test_park_wear);
+  RUN_TEST(test_broken_frames);
+  RUN_TEST(test_index_magnet);
+  RUN_TEST(test_jammed_disk);
+  RUN_TEST(test_after_jam);
+  RUN_TEST(test_fast_motors);
+  RUN_TEST(test_calibration_speed);
+  return UNITY_END();
+}
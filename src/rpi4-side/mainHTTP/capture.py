@@ -0,0 +1,221 @@
+import sys
+from statistics import median, pstdev
+from time import monotonic, sleep
+from remate_link import (open_serial, wait_ready, RemateLink, CAPABILITY_CAPTURE, FRAME_CAPTURE_INFO, FRAME_CAPTURE_DATA,
+                         FEEDBACK_FAULT)
+
+"""
+Waveform capture of the halls (see capture.h of the Arduino): a motor is driven across a magnet without stopping on it
+while both the halls are sampled at a fixed rate. This script asks for the captures, saves them as CSV files and
+tells, for each motor, how long the pulse of a magnet lasts, how noisy the reading is without a magnet, which thresholds
+('hallThresholdLow', 'hallThresholdHigh', 'hallHysteresis' in config.cpp) would fit it and how fast the motor could turn
+before a magnet gets missed. The chamber should be empty: the motors move as if they were throwing.
+Usage, with the server stopped (it owns the serial port):
+    python3 capture.py                      (disk and cross, clockwise, a sample every 500 micros)
+    python3 capture.py cross ccw 250
+    python3 capture.py capture-disk-cw.csv  (only the analysis of a saved capture)
+A PNG with the waveform is saved next to each CSV when matplotlib is installed.
+"""
+
+MOTORS = {'disk': 0, 'cross': 1}
+DIRECTIONS = {'cw': 0, 'ccw': 1}
+CAPTURE_NO_TRIGGER = 0xFFFF
+# Reading without a magnet 'hallThresholdLow' and 'hallThresholdHigh' are given for (HALL_NOMINAL_BASELINE in hall.h)
+NOMINAL_BASELINE = 512
+# Micros between two readings of a watched hall: the ADC interrupts alternating both the halls, oversampled
+# (HALL_MODE_WINDOW), or a pass of the loop() (HALL_MODE_POLL, a guess: it depends on what the loop() is doing)
+DETECT_PERIOD_US = {0: 2000, 1: 120}
+# Readings beyond the threshold needed for a magnet not to be missed: the median of three needs two of them in a row
+DETECT_READINGS = 3
+
+"""
+Turns the frames of a capture into (info, samples): info is a dict, samples a list of (disk, cross) readings
+"""
+def decode(frames):
+    info, samples = None, {}
+    for frame_type, payload in frames:
+        if frame_type == FRAME_CAPTURE_INFO and len(payload) >= 18:
+            word = lambda start: payload[start] | payload[start + 1] << 8
+            info = {'motor': payload[0], 'direction': payload[1], 'interval_us': word(2), 'samples': word(4),
+                    'trigger': word(6), 'threshold_low': word(8), 'threshold_high': word(10), 'hysteresis': word(12),
+                    'index': payload[14], 'late': word(15), 'hall_mode': payload[17],
+                    'baseline': word(19) if len(payload) >= 21 else NOMINAL_BASELINE}
+        elif frame_type == FRAME_CAPTURE_DATA and len(payload) >= 2:
+            first = payload[0] | payload[1] << 8
+            for i in range((len(payload) - 2) // 3):
+                low_disk, low_cross, high = payload[2 + 3 * i:5 + 3 * i]
+                samples[first + i] = (low_disk | (high & 0x03) << 8, low_cross | (high >> 2 & 0x03) << 8)
+    if info is None:
+        return None, []
+    return info, [samples[i] for i in range(info['samples']) if i in samples]
+
+def save(path, info, samples):
+    with open(path, 'w') as f:
+        for key, value in info.items():
+            f.write(f'# {key}={value}\n')
+        f.write('time_us,disk,cross\n')
+        for i, (disk, cross) in enumerate(samples):
+            f.write(f'{i * info["interval_us"]},{disk},{cross}\n')
+
+def load(path):
+    info, samples = {}, []
+    with open(path) as f:
+        for line in f:
+            if line.startswith('#'):
+                key, value = line[1:].strip().split('=')
+                info[key] = int(value)
+            elif line[0].isdigit():
+                _, disk, cross = line.strip().split(',')
+                samples.append((int(disk), int(cross)))
+    return info, samples
+
+# Samples from 'start' on (going back when 'step' is -1) for which the condition holds, stopping at the first that doesn't
+def run_length(values, start, step, condition):
+    count = 0
+    i = start
+    while 0 <= i < len(values) and condition(values[i]):
+        count += 1
+        i += step
+    return count
+
+"""
+Measures the capture of a motor and returns a dict with the results, None if no magnet has been found
+"""
+def analyze(info, samples):
+    trigger = info['trigger']
+    if trigger == CAPTURE_NO_TRIGGER or trigger >= len(samples):
+        return None
+    interval = info['interval_us']
+    low, high, hysteresis = info['threshold_low'], info['threshold_high'], info['hysteresis']
+    values = [sample[info['motor']] for sample in samples]
+    # The reading without a magnet: the older half of what comes before the pulse, the newer one may be on its edge
+    quiet = values[:max(trigger // 2, 1)]
+    baseline = median(quiet)
+    noise_sd = pstdev(quiet) if len(quiet) > 1 else 0.0
+    noise_pp = max(quiet) - min(quiet)
+    # The pulse: the index magnet goes down, the others up
+    sign = -1 if values[trigger] <= low else 1
+    pulse = values[trigger:]
+    peak = min(pulse) if sign < 0 else max(pulse)
+    swing = abs(peak - baseline)
+    peak_at = trigger + pulse.index(peak)
+    # Samples around the peak for which the hall reports the magnet: it's gone only once back inside by the hysteresis
+    beyond = lambda threshold, margin: (lambda value: sign * (value - threshold) >= -margin)
+    width_at = lambda threshold, margin: (run_length(values, peak_at, 1, beyond(threshold, margin))
+                                          + run_length(values, peak_at - 1, -1, beyond(threshold, margin)))
+    threshold = low if sign < 0 else high
+    width = width_at(threshold, hysteresis)
+    # A threshold must stay well clear of the noise, and well inside the pulse
+    offset = max(8 * noise_sd, 2 * noise_pp, 0.25 * swing)
+    weak = offset > 0.6 * swing
+    # The Arduino moves the thresholds with the baseline it learns, the constants are given for NOMINAL_BASELINE
+    recommended_low = round(NOMINAL_BASELINE - offset)
+    recommended_high = round(NOMINAL_BASELINE + offset)
+    recommended_hysteresis = max(round(4 * noise_sd), (noise_pp + 1) // 2, 5)
+    recommended = round(baseline - offset) if sign < 0 else round(baseline + offset)
+    recommended_width = width_at(recommended, recommended_hysteresis)
+    half_width = width_at(baseline + sign * swing / 2, noise_pp)
+    # The pulse gets shorter as the speed grows, it must last DETECT_READINGS readings of the detector
+    needed_us = DETECT_READINGS * DETECT_PERIOD_US.get(info['hall_mode'], DETECT_PERIOD_US[0])
+    return {
+        'baseline': baseline, 'noise_sd': noise_sd, 'noise_pp': noise_pp, 'peak': peak, 'swing': swing,
+        'index': sign < 0, 'width_us': width * interval, 'half_width_us': half_width * interval,
+        'truncated': peak_at + run_length(values, peak_at, 1, beyond(threshold, hysteresis)) >= len(values),
+        'recommended_low': recommended_low, 'recommended_high': recommended_high,
+        'recommended_hysteresis': recommended_hysteresis, 'weak': weak,
+        'recommended_width_us': recommended_width * interval, 'needed_us': needed_us,
+        'max_speed': width * interval / needed_us, 'recommended_max_speed': recommended_width * interval / needed_us,
+    }
+
+def report(name, info, samples):
+    motor = 'disk' if info['motor'] == 0 else 'cross'
+    print(f'{name}: {motor}, {len(samples)} samples every {info["interval_us"]} us')
+    if info['late'] > 0:
+        print(f'  {info["late"]} samples were late, the timings are less precise')
+    result = analyze(info, samples)
+    if result is None:
+        print('  NO MAGNET FOUND: the thresholds may be too far from what the hall reads')
+        return None
+    r = result
+    at_least = 'at least ' if r['truncated'] else ''
+    print(f'  no magnet: {r["baseline"]:.0f} (learned by the Arduino: {info.get("baseline", NOMINAL_BASELINE)}), '
+          f'noise {r["noise_sd"]:.1f} sd, {r["noise_pp"]} peak to peak')
+    print(f'  {"index " if r["index"] else ""}magnet: peak {r["peak"]} ({r["swing"]:.0f} from the baseline)')
+    print(f'  pulse width: {at_least}{r["width_us"] / 1000:.1f} ms over the thresholds in use ({info["threshold_low"]} - '
+          f'{info["threshold_high"]}), {at_least}{r["half_width_us"] / 1000:.1f} ms at half height')
+    print(f'  recommended: hallThresholdLow {r["recommended_low"]}, hallThresholdHigh {r["recommended_high"]}, '
+          f'hallHysteresis {r["recommended_hysteresis"]} (now {info["hysteresis"]})')
+    if r['weak']:
+        print('  WEAK MAGNET: the pulse is close to the noise, check the distance between magnet and hall')
+    print(f'  max safe speed: {r["max_speed"]:.1f}x the captured one with the thresholds in use, '
+          f'{r["recommended_max_speed"]:.1f}x with the recommended ones ({r["needed_us"]} us of pulse needed)')
+    return result
+
+def plot(path, info, samples, result):
+    try:
+        import matplotlib
+        matplotlib.use('Agg')
+        import matplotlib.pyplot as plt
+    except ImportError:
+        return
+    times = [i * info['interval_us'] / 1000 for i in range(len(samples))]
+    plt.figure(figsize=(10, 4))
+    plt.plot(times, [sample[0] for sample in samples], label='disk (A0)')
+    plt.plot(times, [sample[1] for sample in samples], label='cross (A1)')
+    for value, style in ((info['threshold_low'], '--'), (info['threshold_high'], '--')):
+        plt.axhline(value, color='gray', linestyle=style)
+    if result is not None:
+        for value in (result['baseline'] - NOMINAL_BASELINE + result['recommended_low'],
+                      result['baseline'] - NOMINAL_BASELINE + result['recommended_high']):
+            plt.axhline(value, color='green', linestyle=':')
+    if info['trigger'] < len(samples):
+        plt.axvline(times[info['trigger']], color='red', linewidth=0.5)
+    plt.xlabel('ms')
+    plt.ylabel('reading')
+    plt.legend()
+    plt.tight_layout()
+    plt.savefig(path.rsplit('.', 1)[0] + '.png')
+    plt.close()
+
+def capture(link, motor, direction, interval):
+    link.capture_frames = []
+    seq = link.send_capture(motor, direction, interval)
+    end = monotonic() + 15.0
+    while monotonic() < end:
+        for done_seq, feedback in link.poll():
+            if done_seq == seq:
+                if feedback == FEEDBACK_FAULT:
+                    print(f'THE MOTOR GOT STUCK: {link.last_fault}')
+                return decode(link.capture_frames)
+        if link.last_refused == seq:
+            print('CAPTURE REFUSED')
+            return None, []
+        sleep(0.01)
+    print('NO ANSWER')
+    return None, []
+
+def main():
+    if len(sys.argv) > 1 and sys.argv[1].endswith('.csv'):
+        for path in sys.argv[1:]:
+            info, samples = load(path)
+            plot(path, info, samples, report(path, info, samples))
+        return
+    motors = [sys.argv[1]] if len(sys.argv) > 1 else ['disk', 'cross']
+    direction = sys.argv[2] if len(sys.argv) > 2 else 'cw'
+    interval = int(sys.argv[3]) if len(sys.argv) > 3 else 500
+    ser = open_serial()
+    ready = wait_ready(ser)
+    if ready is None or not ready[0] & CAPABILITY_CAPTURE:
+        print('THE ARDUINO CAN\'T CAPTURE THE HALLS')
+        return
+    link = RemateLink(ser, ready[1])
+    for motor in motors:
+        info, samples = capture(link, MOTORS[motor], DIRECTIONS[direction], interval)
+        if info is None:
+            continue
+        path = f'capture-{motor}-{direction}.csv'
+        save(path, info, samples)
+        plot(path, info, samples, report(path, info, samples))
+
+if __name__ == '__main__':
+    main()
@@ -13,14 +13,22 @@ args = parser.parse_args()
 # Model and streak deque initialization
 detection_model = YOLO('detection.pt')
 streak = deque(maxlen=10)
+# Frames between two reports of what is in the chute, for the paddle's feed rate
+FEED_REPORT_FRAMES = 5
+frame_count = 0
 
 """
 This function creates and returns a dictionary to be sent as data through an http request
 """
-def request_dict(class_id, fast_stop=0):
+def request_dict(class_id, fast_stop=0, items=(), count=None, occupancy=0.0):
     detection_dict = {'class' : class_id, # Class predicted by the model
-                'fast': fast_stop # Condition to immediately stop the paddle
+                'fast': fast_stop, # Condition to immediately stop the paddle
+                'items': ','.join(str(i) for i in items) # Classes of all the items seen together, in order
                 }
+    if count is not None:
+        detection_dict['count'] = count # Items in view
+        detection_dict['occupancy'] = f'{occupancy:.3f}' # Part of the image covered by them
+
     
     return detection_dict
 
@@ -74,8 +82,15 @@ if get_response.status_code == 200:
             predicted_class = 0
             boxes_list = []
 
-            # Saves boxes data
-            for data in detection.boxes.data.tolist():
+            # Items in view and part of the image they cover, reported every few frames for the paddle's feed rate
+            frame_count += 1
+            if frame_count % FEED_REPORT_FRAMES == 0:
+                covered = sum((box[2] - box[0]) * (box[3] - box[1]) for box in detection.boxes.data.tolist())
+                occupancy = min(1.0, covered / (image.shape[0] * image.shape[1]))
+                post_response = requests.post(url, data=request_dict(class_id=0, count=len(detection.boxes), occupancy=occupancy))
+
+            # Saves boxes data, from left to right
+            for data in sorted(detection.boxes.data.tolist(), key=lambda box: box[0]):
                 class_id = data[5]
                 boxes_list.append(class_id)
 
@@ -91,24 +106,27 @@ if get_response.status_code == 200:
                     else: predicted_class = 4
                 else: predicted_class = int(c.most_common()[0][0]) + 1
 
-            print(predicted_class)
+            # When there are items of different classes, the server gets all of them in order
+            items = tuple(int(class_id) + 1 for class_id in boxes_list) if len(c) > 1 else ()
+
+            print(predicted_class, items)
             
 
             # Appends the prediction to the streak deque    
             if predicted_class != 0:
-                streak.append(int(predicted_class))
+                streak.append((int(predicted_class), items))
 
             # Checks if it is the first prediction
             if predicted_class != 0 and len(streak) == 1:
                 # Saves data in a dictionary
-                dict = request_dict(class_id=float(streak[0]), fast_stop=1)
+                dict = request_dict(class_id=float(streak[0][0]), fast_stop=1)
                 # Sends a post request with the data
                 post_response = requests.post(url, data=dict)
                 
             # Checks if the last 10 predictions are all the same
             if predicted_class != 0 and len(streak) == 10 and all(streak[i] == streak[0] for i in range(len(streak))):
                 # Saves data in a dictionary 
-                dict = request_dict(class_id=float(streak[0]))
+                dict = request_dict(class_id=float(streak[0][0]), items=streak[0][1])
                 # Clears the streak deque
                 streak.clear()
                 # Sends a post request with the data
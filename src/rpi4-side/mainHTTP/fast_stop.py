@@ -0,0 +1,36 @@
+from time import sleep
+from remate_link import CAPABILITY_STOP_LINE
+try:
+    import RPi.GPIO as GPIO
+except ImportError:
+    GPIO = None
+
+# Pin of the fast stop line (BOARD numbering, GPIO17), wired to PADDLE_STOP_PIN of the Arduino through a level shifter
+FAST_STOP_PIN = 11
+# Seconds the line is kept high, the Arduino only needs the rising edge
+FAST_STOP_PULSE = 0.0005
+
+"""
+FastStopLine stops the paddle with a pulse on a GPIO: the Arduino turns the paddle off from the interrupt of the
+rising edge, without waiting for the serial link and its loop(). Only for an Arduino with CAPABILITY_STOP_LINE.
+The 9 is still sent over the serial link, so nothing is lost if the line isn't wired.
+"""
+class FastStopLine(object):
+    def __init__(self, pin=FAST_STOP_PIN):
+        self.pin = pin
+        if GPIO.getmode() is None:
+            GPIO.setmode(GPIO.BOARD)
+        GPIO.setup(pin, GPIO.OUT, initial=GPIO.LOW)
+
+    def trigger(self):
+        GPIO.output(self.pin, GPIO.HIGH)
+        sleep(FAST_STOP_PULSE)
+        GPIO.output(self.pin, GPIO.LOW)
+
+"""
+Returns the FastStopLine, or None if the Arduino can't use it or this isn't a Raspberry Pi
+"""
+def open_stop_line(capabilities):
+    if GPIO is None or not capabilities & CAPABILITY_STOP_LINE:
+        return None
+    return FastStopLine()
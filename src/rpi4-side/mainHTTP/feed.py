@@ -0,0 +1,50 @@
+from time import monotonic
+
+# Feed levels of the paddle, see feed.h of the Arduino
+FEED_SLOWEST = 0
+FEED_NEUTRAL = 128
+FEED_FASTEST = 255
+
+"""
+FeedController turns what the camera sees into the feed level of the paddle, so that about one trash is always
+in view: one at a time is what the sorter throws best, none means the sorter is waiting, more than one means a
+batch or the unsorted bin. It's an integral controller: the level goes up while the chute is emptier than the target
+and down while it's fuller. A chute mostly covered counts as too full even with a single trash.
+The client sends a measure every few frames, a new set-point is given at most once per 'interval' seconds,
+and only if a measure has arrived meanwhile (without them the Arduino goes back to its calibrated rate by itself).
+"""
+class FeedController(object):
+    def __init__(self, target_items=1.0, gain=30.0, smoothing=0.3, max_occupancy=0.35, interval=1.0):
+        self.target_items = target_items
+        self.gain = gain
+        self.smoothing = smoothing
+        self.max_occupancy = max_occupancy
+        self.interval = interval
+        self.level = FEED_NEUTRAL
+        # Smoothed number of trashes in view and part of the image they cover
+        self.items = None
+        self.occupancy = 0.0
+        self.fresh = False
+        self.last_set = 0.0
+
+    def measure(self, count, occupancy):
+        if self.items is None:
+            self.items, self.occupancy = float(count), occupancy
+        else:
+            self.items += self.smoothing * (count - self.items)
+            self.occupancy += self.smoothing * (occupancy - self.occupancy)
+        self.fresh = True
+
+    """
+    Returns the new feed level when it's time to send one, None otherwise
+    """
+    def set_point(self):
+        if not self.fresh or monotonic() - self.last_set < self.interval:
+            return None
+        error = self.target_items - self.items
+        if self.occupancy > self.max_occupancy:
+            error = min(error, -0.5)
+        self.level = max(FEED_SLOWEST, min(FEED_FASTEST, round(self.level + self.gain * error)))
+        self.fresh = False
+        self.last_set = monotonic()
+        return self.level
@@ -0,0 +1,74 @@
+import sys
+from time import monotonic, sleep
+from remate_link import open_serial, wait_ready, RemateLink, CAPABILITY_PROGRAM
+
+"""
+Motion programs of the Arduino, see program.h. Every instruction is two bytes: operation and argument.
+A program is written as a list of strings like 'move cross ccw 1', 'both cw ccw', 'to disk home', 'settle 0',
+'correct disk', 'together', 'hold 1', 'release 1'.
+Usage, with the server stopped (it owns the serial port):
+    python3 program.py metal 'to disk 3' 'settle 0' 'to disk home' 'correct disk'
+    python3 program.py metal        (brings back the default program)
+"""
+
+OP_MOVE = 1
+OP_MOVE_BOTH = 2
+OP_MOVE_TO = 3
+OP_SETTLE = 4
+OP_CORRECT = 5
+OP_TOGETHER = 6
+OP_SLOT = 7
+PROGRAM_MAX_LENGTH = 24
+PROGRAM_POSITION_HOME = 0x7F
+PROGRAMS = {'paper': 1, 'metal': 2, 'plastic': 3, 'unsorted': 4, 'paper_hold': 5, 'paper_expired': 6}
+MOTORS = {'disk': 0, 'cross': 1}
+DIRECTIONS = {'cw': 0, 'ccw': 1}
+
+"""
+Turns a list of instructions into the bytes of the program, raises ValueError if one of them is wrong
+"""
+def assemble(lines):
+    code = []
+    for line in lines:
+        words = line.lower().split()
+        op, args = words[0], words[1:]
+        if op == 'move':
+            code += [OP_MOVE, MOTORS[args[0]] | DIRECTIONS[args[1]] << 1 | int(args[2]) << 2]
+        elif op == 'both':
+            code += [OP_MOVE_BOTH, DIRECTIONS[args[0]] | DIRECTIONS[args[1]] << 1]
+        elif op == 'to':
+            position = PROGRAM_POSITION_HOME if args[1] == 'home' else int(args[1])
+            code += [OP_MOVE_TO, MOTORS[args[0]] | position << 1]
+        elif op == 'settle':
+            code += [OP_SETTLE, int(args[0]) // 10]
+        elif op == 'correct':
+            code += [OP_CORRECT, MOTORS[args[0]]]
+        elif op == 'together':
+            code += [OP_TOGETHER, 0]
+        elif op == 'hold' or op == 'release':
+            code += [OP_SLOT, int(args[0]) | (0x80 if op == 'hold' else 0)]
+        else:
+            raise ValueError(f'unknown instruction: {line}')
+    if len(code) > PROGRAM_MAX_LENGTH or any(byte > 0xFF for byte in code):
+        raise ValueError('program too long or argument out of range')
+    return bytes(code)
+
+def main():
+    ser = open_serial()
+    ready = wait_ready(ser)
+    if ready is None or not ready[0] & CAPABILITY_PROGRAM:
+        print('THE ARDUINO CAN\'T RECEIVE PROGRAMS')
+        return
+    link = RemateLink(ser, ready[1])
+    seq = link.send_program(PROGRAMS[sys.argv[1]], assemble(sys.argv[2:]))
+    end = monotonic() + 2.0
+    while seq in link.pending and monotonic() < end:
+        link.poll()
+        sleep(0.01)
+    if seq in link.pending:
+        print('NO ANSWER')
+    else:
+        print('PROGRAM REFUSED' if link.last_refused == seq else 'PROGRAM SAVED')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,90 @@
+import sys
+from time import monotonic
+from remate_link import (open_serial, wait_ready, read_frame, build_frame, FRAME_ACK, FRAME_RECORDS,
+                         FRAME_RECORDER_DUMP, CAPABILITY_RECORDER)
+
+"""
+Flight recorder of the Arduino (see recorder.h): the last faults and boots are kept in its EEPROM, each fault
+with the events that have led to it.
+This script reads them and prints them from the oldest, so a brown-out or a jam can be looked at after the fact.
+Usage, with the server stopped (it owns the serial port):
+    python3 recorder.py
+    python3 recorder.py /dev/ttyACM1
+"""
+
+ENTRY_SIZE = 8
+EVENTS = {1: 'boot', 2: 'command', 3: 'phase', 4: 'fault', 5: 'done'}
+# Bits of RSTCTRL.RSTFR in a boot event
+RESET_FLAGS = {0x01: 'power-on', 0x02: 'brown-out', 0x04: 'external', 0x08: 'watchdog', 0x10: 'software', 0x20: 'updi'}
+# AxisPhase and MotionFaultReason of motion.h
+PHASES = {1: 'depart', 2: 'seek', 5: 'jog', 10: 'approach'}
+FAULTS = {1: 'stall', 2: 'timeout'}
+MOTORS = {0: 'disk', 1: 'cross'}
+FEEDBACKS = {0: 'fault', 42: 'ok', 43: 'unsorted'}
+
+"""
+Turns the payloads of the FRAME_RECORDS into a list of (stamp, event, arg, aux, millis, value), from the oldest
+"""
+def decode(payloads):
+    data = b''.join(payloads)
+    entries = []
+    for start in range(0, len(data) - ENTRY_SIZE + 1, ENTRY_SIZE):
+        entry = data[start:start + ENTRY_SIZE]
+        entries.append((entry[0], entry[1], entry[2], entry[3],
+                        int.from_bytes(entry[4:6], 'little'), int.from_bytes(entry[6:8], 'little')))
+    return entries
+
+"""
+Describes an entry in words
+"""
+def describe(entry):
+    stamp, event, arg, aux, millis, value = entry
+    if event == 1:
+        flags = [name for bit, name in RESET_FLAGS.items() if arg & bit] or ['unknown']
+        text = f'reset: {", ".join(flags)}, battery {value} mV'
+    elif event == 2:
+        source = 'stop line' if arg == 0 else f'seq {arg}'
+        text = f'{source}, trash {aux}, battery {value} mV'
+    elif event == 3:
+        text = f'{MOTORS.get(arg, arg)} {PHASES.get(aux, aux)} {value} ms'
+    elif event == 4:
+        text = f'{FAULTS.get(arg, arg)} of the {MOTORS.get(aux, aux)}, position {value}'
+    elif event == 5:
+        text = f'seq {arg} {FEEDBACKS.get(aux, aux)}, {value} queued'
+    else:
+        text = f'{arg} {aux} {value}'
+    return f'#{stamp:3d} {millis:5d} ms  {EVENTS.get(event, "?"):8s} {text}'
+
+"""
+Asks the Arduino for its recorder, returns the entries or None if it hasn't answered
+"""
+def dump(ser, timeout=2.0):
+    ser.write(build_frame(FRAME_RECORDER_DUMP, 1))
+    end = monotonic() + timeout
+    payloads = []
+    while monotonic() < end:
+        frame = read_frame(ser, end)
+        if frame is None:
+            break
+        if frame[0] == FRAME_RECORDS and frame[1] == 1:
+            payloads.append(frame[2])
+        elif frame[0] == FRAME_ACK and frame[1] == 1:
+            return decode(payloads)
+    return None
+
+def main():
+    ser = open_serial(*sys.argv[1:2])
+    ready = wait_ready(ser)
+    if ready is None or not ready[0] & CAPABILITY_RECORDER:
+        print('THE ARDUINO HAS NO FLIGHT RECORDER')
+        return
+    entries = dump(ser)
+    if entries is None:
+        print('NO ANSWER')
+        return
+    # The millis are only the low 16 bits, they wrap every ~65 seconds
+    for entry in entries:
+        print(describe(entry))
+
+if __name__ == '__main__':
+    main()
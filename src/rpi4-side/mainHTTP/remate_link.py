@@ -0,0 +1,346 @@
+import serial
+from collections import deque
+from time import monotonic, sleep
+
+# Binary frames in both directions: FRAME_SYNC, payload length, type, sequence number, payload, CRC-8
+FRAME_SYNC = 0xA5
+FRAME_MAX_PAYLOAD = 32
+# Types of the frames, see protocol.h of the Arduino
+FRAME_READY = 0x01
+FRAME_ACK = 0x02
+FRAME_NACK = 0x03
+FRAME_DONE = 0x04
+FRAME_FAULT = 0x05
+FRAME_TELEMETRY = 0x06
+FRAME_RECORDS = 0x07
+FRAME_CAPTURE_INFO = 0x08
+FRAME_CAPTURE_DATA = 0x09
+FRAME_HELLO = 0x10
+FRAME_COMMAND = 0x11
+FRAME_BATCH = 0x12
+FRAME_PROGRAM = 0x13
+FRAME_FEED = 0x14
+FRAME_TELEMETRY_ON = 0x15
+FRAME_RECORDER_DUMP = 0x16
+FRAME_CAPTURE = 0x17
+# Sequence numbers the Arduino remembers behind the newest one (SEQ_WINDOW of protocol.h): a command sent again
+# after more than this many newer frames would be taken as a copy of one already accepted
+SEQ_WINDOW = 16
+# Max number of trashes in a FRAME_BATCH
+BATCH_MAX_ITEMS = 4
+# Command that only stops the paddle, it doesn't get a FRAME_DONE
+COMMAND_INCOMING = 9
+# Command for more than one trash, when the FRAME_BATCH isn't available
+TRASH_UNSORTED = 4
+# Reasons of a FRAME_NACK
+NACK_CRC = 1
+NACK_UNKNOWN = 2
+NACK_QUEUE_FULL = 3
+NACK_INVALID = 4
+# Bits of the capabilities inside the FRAME_READY
+CAPABILITY_HALL_WINDOW = 0x01
+CAPABILITY_CALIBRATION = 0x02
+CAPABILITY_PARK = 0x04
+CAPABILITY_PARK_RESTORED = 0x08
+CAPABILITY_DUAL_THROW = 0x10
+CAPABILITY_BATCH = 0x20
+CAPABILITY_RECOVERY = 0x40
+CAPABILITY_PROGRAM = 0x80
+CAPABILITY_FEED = 0x100
+CAPABILITY_STOP_LINE = 0x200
+CAPABILITY_BATTERY = 0x400
+CAPABILITY_TELEMETRY = 0x800
+CAPABILITY_RECORDER = 0x1000
+CAPABILITY_CAPTURE = 0x2000
+# Feedback of a command that is over: thrown, thrown in the unsorted bin because of a jam, or failed (FRAME_FAULT)
+FEEDBACK_OK = 42
+FEEDBACK_UNSORTED = 43
+FEEDBACK_FAULT = 0
+# Reasons of a FRAME_FAULT
+FAULT_STALL = 1
+FAULT_TIMEOUT = 2
+
+"""
+CRC-8 with polynomial 0x07, the same one used by the Arduino for the frames and the EEPROM
+"""
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+"""
+Builds a frame ready to be written on the serial port
+"""
+def build_frame(frame_type, seq, payload=b''):
+    body = bytes([len(payload), frame_type, seq]) + bytes(payload)
+    return bytes([FRAME_SYNC]) + body + bytes([crc8(body)])
+
+"""
+Opens the serial port without toggling DTR, so an Arduino that is already running isn't reset
+when the server (re)starts
+"""
+def open_serial(port='/dev/ttyACM0', baudrate=115200, timeout=1.0):
+    ser = serial.Serial()
+    ser.port = port
+    ser.baudrate = baudrate
+    ser.timeout = timeout
+    ser.dtr = False
+    ser.open()
+    return ser
+
+"""
+Reads bytes until a frame with a valid CRC arrives, returns (type, sequence, payload) or None once the deadline has passed.
+Whatever isn't a frame is skipped.
+"""
+def read_frame(ser, deadline):
+    while monotonic() < deadline:
+        byte = ser.read(1)
+        if not byte or byte[0] != FRAME_SYNC:
+            continue
+        header = ser.read(3)
+        if len(header) < 3:
+            continue
+        length, frame_type, seq = header
+        rest = ser.read(length + 1)
+        if len(rest) < length + 1:
+            continue
+        if crc8(header + rest[:-1]) == rest[-1]:
+            return frame_type, seq, rest[:-1]
+    return None
+
+"""
+Waits for the FRAME_READY of the Arduino. It's sent at the end of its setup(), and when it's asked with FRAME_HELLO:
+if the Arduino hasn't been reset (it was already running) the question gets the answer in a few millis.
+Returns (capabilities, credits), or None if the Arduino hasn't answered within the timeout.
+The credits are the size of the Arduino's command queue, how many commands can be sent ahead.
+"""
+def wait_ready(ser, timeout=15.0, hello_interval=0.25):
+    end = monotonic() + timeout
+    saved_timeout = ser.timeout
+    ser.timeout = 0.05
+    ready = None
+    try:
+        while ready is None and monotonic() < end:
+            ser.write(build_frame(FRAME_HELLO, 0))
+            frame = read_frame(ser, min(end, monotonic() + hello_interval))
+            if frame is not None and frame[0] == FRAME_READY and len(frame[2]) >= 3:
+                # The capabilities that don't fit in the first byte are at the end
+                high = frame[2][3] << 8 if len(frame[2]) >= 4 else 0
+                ready = (frame[2][1] | high, frame[2][2])
+        # A FRAME_HELLO sent while the Arduino was still in its setup() gets a second answer right after the first one
+        sleep(0.05)
+        ser.reset_input_buffer()
+    finally:
+        ser.timeout = saved_timeout
+    return ready
+
+"""
+RemateLink sends the commands to the Arduino and reads its answers without ever blocking.
+Every command is sent again if its ACK doesn't arrive in time, every FRAME_DONE gets an ACK.
+The Arduino queues the commands while the motors are busy: 'queue_depth' is how many are waiting there.
+Each command that moves the motors takes one of the credits until its FRAME_DONE arrives, so the queue never overflows.
+"""
+class RemateLink(object):
+    def __init__(self, ser, credits=1, retry_delay=0.2, max_retries=5):
+        self.ser = ser
+        self.credits = credits
+        # Commands sent and not over yet, each one holds a credit
+        self.in_flight = set()
+        self.retry_delay = retry_delay
+        self.max_retries = max_retries
+        self.seq = 0
+        # Commands waiting for their ACK: sequence number -> [frame, last time sent, retries]
+        self.pending = {}
+        # Commands refused because the Arduino's queue was full, sent again at the next FRAME_DONE
+        self.refused = []
+        self.buffer = bytearray()
+        # Last commands that are over: a dual throw ends two of them together and their FRAME_DONE are sent again in turns
+        self.recent_done = deque(maxlen=8)
+        self.queue_depth = 0
+        # Sequence number of the last frame refused for good (NACK_UNKNOWN or NACK_INVALID)
+        self.last_refused = None
+        # Paddle as reported by the ACK of the last FRAME_FEED: (level, duty 0 - 255, going millis, not going millis)
+        self.feed_state = None
+        # Battery's voltage as reported by the last FRAME_DONE (or FRAME_FEED's ACK), None if unknown
+        self.battery_volts = None
+        # Payloads of the FRAME_TELEMETRY not taken yet (see telemetry.py), the oldest are dropped if nobody takes them
+        self.telemetry = deque(maxlen=256)
+        # What has been sent with each sequence number of a command: a trash, or the list of trashes of a batch
+        self.commands = {}
+        # FRAME_CAPTURE_INFO and FRAME_CAPTURE_DATA not taken yet (see capture.py), as (type, payload)
+        self.capture_frames = []
+        # Last FRAME_FAULT: (sequence number, reason, motor, position)
+        self.last_fault = None
+
+    def _send(self, frame_type, payload, holds_credit=True):
+        # Sequence numbers go from 1 to 255, 0 is used by the frames that don't answer a command
+        self.seq = self.seq % 255 + 1
+        frame = build_frame(frame_type, self.seq, bytes(payload))
+        self.ser.write(frame)
+        self.pending[self.seq] = [frame, monotonic(), 0]
+        if holds_credit:
+            self.in_flight.add(self.seq)
+        return self.seq
+
+    def send_command(self, command):
+        seq = self._send(FRAME_COMMAND, [command], command != COMMAND_INCOMING)
+        self.commands[seq] = command
+        return seq
+
+    """
+    Sends all the trashes seen together in the chamber, in order: the Arduino plans a single job for all of them.
+    Only for an Arduino with CAPABILITY_BATCH, it takes a single credit.
+    """
+    def send_batch(self, items):
+        seq = self._send(FRAME_BATCH, items[:BATCH_MAX_ITEMS])
+        self.commands[seq] = tuple(items[:BATCH_MAX_ITEMS])
+        return seq
+
+    """
+    Replaces a motion program of the Arduino (see program.py), an empty one brings back the default.
+    Only for an Arduino with CAPABILITY_PROGRAM, it doesn't take any credit.
+    """
+    def send_program(self, program_id, code=b''):
+        return self._send(FRAME_PROGRAM, bytes([program_id]) + bytes(code), False)
+
+    """
+    Sets the feed level of the paddle (see feed.py), only for an Arduino with CAPABILITY_FEED, it doesn't take any credit
+    """
+    def send_feed(self, level):
+        return self._send(FRAME_FEED, [level], False)
+
+    """
+    Turns the FRAME_TELEMETRY of the Arduino on or off, only for an Arduino with CAPABILITY_TELEMETRY.
+    It's off again after every FRAME_HELLO.
+    """
+    def send_telemetry(self, on):
+        return self._send(FRAME_TELEMETRY_ON, [1 if on else 0], False)
+
+    """
+    Returns the FRAME_TELEMETRY arrived since the last call, as (payload, what had been sent with its sequence number)
+    """
+    def take_telemetry(self):
+        taken = [(payload, self.commands.get(payload[8]) if len(payload) > 8 else None) for payload in self.telemetry]
+        self.telemetry.clear()
+        return taken
+
+    """
+    Asks for a capture of the halls' waveform (see capture.py), only for an Arduino with CAPABILITY_CAPTURE.
+    It's queued like a throw and takes a credit, its frames arrive before its FRAME_DONE.
+    The interval is sent in 2 bytes, a ValueError is raised if it doesn't fit (the Arduino refuses the ones out of
+    CAPTURE_MIN_INTERVAL - CAPTURE_MAX_INTERVAL with a NACK_INVALID).
+    """
+    def send_capture(self, motor, direction, interval_us):
+        if not 1 <= interval_us <= 0xFFFF:
+            raise ValueError(f'capture interval must be 1 - 65535 us, not {interval_us}')
+        return self._send(FRAME_CAPTURE, [motor, direction, interval_us & 0xFF, interval_us >> 8])
+
+    """
+    Credits left for new commands. A command refused (or broken) is sent again after the newer ones: no new command
+    is sent while it's half of SEQ_WINDOW back, so the Arduino can still tell it from a copy (the other half is left
+    for the frames that don't take a credit and for the wrap from 255 to 1).
+    """
+    def free_credits(self):
+        waiting = [entry[0][3] for entry in list(self.pending.values()) + self.refused]
+        if any((self.seq - seq) % 255 >= SEQ_WINDOW // 2 for seq in waiting):
+            return 0
+        return self.credits - len(self.in_flight)
+
+    def _resend(self, seq):
+        entry = self.pending[seq]
+        if entry[2] >= self.max_retries:
+            print(f'COMMAND {seq} LOST')
+            del self.pending[seq]
+            self.in_flight.discard(seq)
+            return
+        entry[1] = monotonic()
+        entry[2] += 1
+        self.ser.write(entry[0])
+
+    def _frames(self):
+        # Extracts the whole frames from the bytes received so far, skipping what isn't a frame
+        while True:
+            start = self.buffer.find(FRAME_SYNC)
+            if start < 0:
+                self.buffer.clear()
+                return
+            del self.buffer[:start]
+            if len(self.buffer) < 2:
+                return
+            length = self.buffer[1]
+            if length > FRAME_MAX_PAYLOAD:
+                del self.buffer[0]
+                continue
+            if len(self.buffer) < length + 5:
+                return
+            frame = bytes(self.buffer[:length + 5])
+            if crc8(frame[1:-1]) != frame[-1]:
+                del self.buffer[0]
+                continue
+            del self.buffer[:length + 5]
+            yield frame[2], frame[3], frame[4:-1]
+
+    # 0 millivolts means that the Arduino hasn't got a battery on its pin
+    def _battery(self, millivolts):
+        self.battery_volts = millivolts / 1000 if millivolts > 0 else None
+
+    """
+    Must be called often: reads what the Arduino has sent and sends again the commands without ACK.
+    Returns the list of (sequence number, feedback) of the commands that are over, a command ended by a FRAME_FAULT
+    has FEEDBACK_FAULT as feedback (the details are in 'last_fault').
+    """
+    def poll(self):
+        done = []
+        if self.ser.in_waiting > 0:
+            self.buffer += self.ser.read(self.ser.in_waiting)
+        for frame_type, seq, payload in self._frames():
+            if frame_type == FRAME_ACK:
+                self.pending.pop(seq, None)
+                if len(payload) >= 1: self.queue_depth = payload[0]
+                if len(payload) >= 7:
+                    self.feed_state = (payload[1], payload[2], payload[3] | payload[4] << 8, payload[5] | payload[6] << 8)
+                if len(payload) >= 9: self._battery(payload[7] | payload[8] << 8)
+            elif frame_type == FRAME_TELEMETRY:
+                self.telemetry.append(payload)
+            elif frame_type == FRAME_CAPTURE_INFO or frame_type == FRAME_CAPTURE_DATA:
+                self.capture_frames.append((frame_type, payload))
+            elif frame_type == FRAME_NACK and seq in self.pending:
+                reason = payload[0] if len(payload) >= 1 else NACK_CRC
+                if reason == NACK_QUEUE_FULL:
+                    self.refused.append(self.pending.pop(seq))
+                elif reason == NACK_UNKNOWN or reason == NACK_INVALID:
+                    print(f'COMMAND {seq} REFUSED')
+                    self.last_refused = seq
+                    del self.pending[seq]
+                    self.in_flight.discard(seq)
+                else:
+                    self._resend(seq)
+            elif frame_type == FRAME_DONE or frame_type == FRAME_FAULT:
+                self.ser.write(build_frame(FRAME_ACK, seq))
+                # The credit is back
+                self.in_flight.discard(seq)
+                self.pending.pop(seq, None)
+                # The Arduino sends it again if our ACK gets lost
+                if frame_type == FRAME_FAULT and len(payload) >= 4:
+                    if self.last_fault != (seq, payload[0], payload[1], payload[2]):
+                        self.last_fault = (seq, payload[0], payload[1], payload[2])
+                        done.append((seq, FEEDBACK_FAULT))
+                    self.queue_depth = payload[3]
+                elif frame_type == FRAME_DONE and seq not in self.recent_done and len(payload) >= 1:
+                    self.recent_done.append(seq)
+                    done.append((seq, payload[0]))
+                if frame_type == FRAME_DONE and len(payload) >= 2: self.queue_depth = payload[1]
+                if frame_type == FRAME_DONE and len(payload) >= 4: self._battery(payload[2] | payload[3] << 8)
+                # There is room in the queue again
+                for entry in self.refused:
+                    entry[1] = monotonic()
+                    self.ser.write(entry[0])
+                    self.pending[entry[0][3]] = entry
+                self.refused = []
+        now = monotonic()
+        for seq in [s for s, entry in self.pending.items() if now - entry[1] >= self.retry_delay]:
+            self._resend(seq)
+        return done
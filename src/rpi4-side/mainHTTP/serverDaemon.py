@@ -2,9 +2,15 @@ import io
 import picamera
 from http.server import SimpleHTTPRequestHandler, ThreadingHTTPServer
 from threading import Condition
+from collections import deque
 import json
 import serial
 from time import sleep
+from urllib.parse import parse_qs
+from remate_link import open_serial, wait_ready, RemateLink, COMMAND_INCOMING, CAPABILITY_BATCH, TRASH_UNSORTED, FEEDBACK_OK, FEEDBACK_UNSORTED, FEEDBACK_FAULT, CAPABILITY_FEED, CAPABILITY_TELEMETRY
+from feed import FeedController
+from fast_stop import open_stop_line
+from telemetry import TelemetryLog, decode, class_name
 import RPi.GPIO as GPIO
 
 # Setup for the display that shows the IP Address once the code runs
@@ -76,17 +82,27 @@ class StreamingHandler(SimpleHTTPRequestHandler):
 
     def do_POST(self):
         # Calls global variables
-        global class_predicted, stop_condition, fast_stop
+        global predictions, stop_condition, fast_stop
         # Finds length of client's data
         length = int(self.headers['Content-Length'])
         # Reads the data
-        field_data = self.rfile.read(length).decode('utf-8')
-        data = [int(float(i.split('=')[1])) for i in field_data.split('&')]
-        fast_stop = int(data[1])
-
-        # Saves the predicted class
-        if data[0] != '0.0':
-            class_predicted = int(float(data[0]))
+        field_data = parse_qs(self.rfile.read(length).decode('utf-8'))
+        fast_stop = int(float(field_data.get('fast', ['0'])[0]))
+        # The paddle is stopped right away by the fast stop line, the 9 follows over the serial link
+        if fast_stop == 1 and self.server.stop_line is not None:
+            self.server.stop_line.trigger()
+        predicted_class = int(float(field_data.get('class', ['0'])[0]))
+        # Classes of all the trashes seen together, in order (only sent when there is more than one)
+        items = [int(i) for i in field_data.get('items', [''])[0].split(',') if i]
+        # What the camera sees in the chute, for the paddle's feed rate
+        if 'count' in field_data:
+            self.server.feed.measure(int(field_data['count'][0]), float(field_data.get('occupancy', ['0'])[0]))
+
+        # Queues the predicted class (or the whole list), it's sent as soon as the Arduino has room for it
+        if len(items) > 1:
+            predictions.append(items)
+        elif predicted_class != 0:
+            predictions.append(predicted_class)
 
         # Responds
         self.send_response(200)
@@ -99,44 +115,69 @@ class StreamingHandler(SimpleHTTPRequestHandler):
 ThreadingServer extents ThreadingHTTPServer in order to manage the class prediction sent by the client
 '''
 class ThreadingServer(ThreadingHTTPServer):
-    def __init__(self, serial, *args):
+    def __init__(self, serial, credits, capabilities, *args):
         self.serial = serial
+        self.link = RemateLink(serial, credits)
+        self.capabilities = capabilities
+        self.feed = FeedController()
+        self.stop_line = open_stop_line(capabilities)
+        # Timings of the throws for telemetry.py, if the Arduino can send them
+        self.telemetry_log = None
+        if capabilities & CAPABILITY_TELEMETRY:
+            self.telemetry_log = TelemetryLog()
+            self.link.send_telemetry(True)
         super().__init__(*args)
+        # Don't wait forever for a request, the Arduino's frames must be read also meanwhile
+        self.timeout = 0.05
 
     def serve_forever(self):
         # Calls and initializes global variables
-        global class_predicted, stop_condition, fast_stop
-        class_predicted = 0
+        global predictions, stop_condition, fast_stop
         fast_stop = 0
 
         while True:
             # Handles single request
             self.handle_request()
-            sleep(0.01)
 
             # Checks if the paddle needs to be stopped
             if fast_stop == 1:
-                # Send fast stop command
-                self.serial.write(('9\n').encode())
+                # Send fast stop command, once for each request asking for it
+                self.link.send_command(COMMAND_INCOMING)
+                fast_stop = 0
                 print('PADDLE BLOCKED')
 
-            else:
-                # Checks if new predictions should be received and a class is predicted
-                if stop_condition == 0 and class_predicted != 0:
-                    # Sends the class recognized
-                    self.serial.write((str(class_predicted) + '\n').encode())
-                    print('DATA SENT')
-                    # Stops new predictions
-                    stop_condition = 1
-
-            sleep(0.01)
-
-            if self.serial.in_waiting > 0:
-                # Decodes the received data
-                received_data = self.serial.readline().decode('utf-8').strip()
-
-                # If the Arduino said so, start getting new predictions
-                if received_data == "42": stop_condition = 0
+            # Sends the classes recognized while the Arduino has room in its queue, also while it is throwing
+            while predictions and self.link.free_credits() > 0:
+                prediction = predictions.popleft()
+                if not isinstance(prediction, list):
+                    seq = self.link.send_command(prediction)
+                elif self.capabilities & CAPABILITY_BATCH:
+                    seq = self.link.send_batch(prediction)
+                else:
+                    # Old firmware: all the trashes seen together go in the unsorted bin
+                    seq = self.link.send_command(TRASH_UNSORTED)
+                print(f'DATA SENT {seq}')
+
+            # Reads the answers of the Arduino, the commands without ACK are sent again
+            for seq, feedback in self.link.poll():
+                battery = f', battery {self.link.battery_volts:.2f} V' if self.link.battery_volts is not None else ''
+                if feedback == FEEDBACK_OK: print(f'DONE {seq}, {self.link.queue_depth} queued{battery}')
+                elif feedback == FEEDBACK_UNSORTED: print(f'DONE {seq} IN THE UNSORTED BIN AFTER A JAM, {self.link.queue_depth} queued')
+                elif feedback == FEEDBACK_FAULT: print(f'FAULT {seq}: reason {self.link.last_fault[1]} on motor {self.link.last_fault[2]}')
+
+            # Saves the timings of the phases that are over
+            if self.telemetry_log is not None:
+                for payload, command in self.link.take_telemetry():
+                    record = decode(payload, class_name(command))
+                    if record is not None: self.telemetry_log.write(record)
+
+            # Keeps about one trash in view by changing the paddle's feed rate
+            level = self.feed.set_point()
+            if level is not None and self.capabilities & CAPABILITY_FEED:
+                self.link.send_feed(level)
+
+            # Tells the client to stop sending when there is no room left
+            stop_condition = 1 if self.link.free_credits() <= 0 else 0
 
 
 '''
@@ -145,14 +186,18 @@ It also manages serial USB communication with an Arduino
 '''
 def stream():
     # Calls and initializes global variables
-    global class_predicted, stop_condition
+    global predictions, stop_condition
+    predictions = deque()
     stop_condition = 0
 
-    # Initialize serial communication with the Arduino
-    ser = serial.Serial('/dev/ttyACM0', 115200, timeout=1.0) # controlla il timeout
-    sleep(2)
-    # Clear any leftover data in the input buffer
-    ser.reset_input_buffer()
+    # Initialize serial communication with the Arduino, without resetting it
+    ser = open_serial('/dev/ttyACM0', 115200, timeout=1.0) # controlla il timeout
+    # Wait until the Arduino says it's ready, instead of a fixed sleep
+    ready = wait_ready(ser)
+    if ready is None:
+        ser.close()
+        raise RuntimeError('the Arduino has not sent its FRAME_READY: check the cable and that it runs the firmware of src/arduino-side/main')
+    print(f'ARDUINO READY, capabilities {ready[0]:#04x}, credits {ready[1]}')
 
     # Check if the serial communication is open
     if ser.isOpen():
@@ -169,7 +214,7 @@ def stream():
                 handler = lambda *args: StreamingHandler(frame_buffer, *args)
 
                 # Start a multithreaded server to handle requests and serial communication
-                server = ThreadingServer(ser, address, handler)
+                server = ThreadingServer(ser, ready[1], ready[0], address, handler)
                 # Keep the server running indefinitely
                 server.serve_forever()
 
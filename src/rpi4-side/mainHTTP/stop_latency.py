@@ -0,0 +1,69 @@
+import sys
+from statistics import median
+from time import perf_counter, sleep
+import RPi.GPIO as GPIO
+from remate_link import open_serial, wait_ready, RemateLink, COMMAND_INCOMING, CAPABILITY_FEED, CAPABILITY_STOP_LINE
+from fast_stop import FastStopLine
+
+"""
+Measures how long the paddle takes to stop, with the fast stop line and with the 9 over the serial link.
+Run it with the server stopped (it owns the serial port). PADDLE_SENSE_PIN must read the paddle's output (PADDLE_NPN)
+through a voltage divider. Each trial waits for a "going" pulse to start, asks for the stop and waits for the pulse
+to end: the paddle is set to the fastest feed, so the longest pulses are used, and a trial that ends after
+MAX_LATENCY is taken as the natural end of the pulse. After each stop the Arduino waits for the trash
+(5 seconds) before moving the paddle again, so the trials are slow.
+Usage: python3 stop_latency.py [trials]
+"""
+
+# Pin that reads the paddle's output (BOARD numbering, GPIO27)
+PADDLE_SENSE_PIN = 13
+# Longer stops can't be told apart from the natural end of the "going" pulse
+MAX_LATENCY = 0.1
+
+def trial(stop, link):
+    # Waits for the paddle to start a pulse (it restarts after the Arduino's trash timeout)
+    while GPIO.input(PADDLE_SENSE_PIN) == GPIO.LOW:
+        link.poll()
+        sleep(0.0002)
+    start = perf_counter()
+    stop()
+    while GPIO.input(PADDLE_SENSE_PIN) == GPIO.HIGH and perf_counter() - start < MAX_LATENCY:
+        pass
+    latency = perf_counter() - start
+    # Waits for the ACK, so that the link doesn't send it again during the next trial
+    while link.pending:
+        link.poll()
+    return latency if latency < MAX_LATENCY else None
+
+def report(name, latencies):
+    measured = [latency * 1000 for latency in latencies if latency is not None]
+    if not measured:
+        print(f'{name}: no stop measured')
+        return
+    print(f'{name}: min {min(measured):.2f} ms, median {median(measured):.2f} ms, max {max(measured):.2f} ms, '
+          f'{len(latencies) - len(measured)} missed')
+
+def main():
+    trials = int(sys.argv[1]) if len(sys.argv) > 1 else 10
+    ser = open_serial()
+    ready = wait_ready(ser)
+    if ready is None or not ready[0] & CAPABILITY_STOP_LINE:
+        print('THE ARDUINO HASN\'T GOT THE FAST STOP LINE')
+        return
+    link = RemateLink(ser, ready[1])
+    GPIO.setmode(GPIO.BOARD)
+    GPIO.setup(PADDLE_SENSE_PIN, GPIO.IN)
+    line = FastStopLine()
+    # The feed set-point lasts 10 seconds on the Arduino, it's sent again before every trial
+    feed = (lambda: link.send_feed(255)) if ready[0] & CAPABILITY_FEED else (lambda: None)
+    results = {'line': [], 'serial': []}
+    for _ in range(trials):
+        for name, stop in (('line', line.trigger), ('serial', lambda: link.send_command(COMMAND_INCOMING))):
+            feed()
+            results[name].append(trial(stop, link))
+    report('fast stop line', results['line'])
+    report('serial 9', results['serial'])
+    GPIO.cleanup()
+
+if __name__ == '__main__':
+    main()
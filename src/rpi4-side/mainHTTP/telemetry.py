@@ -0,0 +1,152 @@
+import csv
+import os
+import sys
+from collections import defaultdict, namedtuple
+
+"""
+Timing telemetry of the Arduino (see telemetry.h): every phase of a throw that is over arrives as a FRAME_TELEMETRY.
+The server appends them to a CSV file together with the class of their command, this script reads it back and
+prints, for each class, the histogram of the cycle times and how long each phase takes, then where the learned
+baselines and thresholds of the halls have been (see hall.h).
+Usage: python3 telemetry.py [telemetry.csv]
+"""
+
+# Phases of the records, see TelemetryPhase in telemetry.h
+PHASES = {1: 'depart', 2: 'seek', 3: 'settle', 4: 'correct', 5: 'jog', 6: 'pause', 7: 'wait-class', 8: 'feedback', 9: 'brake', 10: 'approach'}
+# Phases that are part of the motors' cycle, the others are spent waiting for the Rpi4
+MOTION_PHASES = (1, 2, 3, 4, 5, 6, 9, 10)
+AXES = {0: 'disk', 1: 'cross', 0xFF: '-'}
+CLASSES = {1: 'paper', 2: 'metal', 3: 'plastic', 4: 'unsorted', 7: 'calibration'}
+RECORD_SIZE = 26
+# Records of an Arduino before the learned thresholds, they have 0 in the last three values
+OLD_RECORD_SIZE = 20
+FIELDS = ['start_us', 'duration_us', 'seq', 'phase', 'axis', 'hall_entry', 'hall_exit', 'overshoot_us', 'lost',
+          'hall_baseline', 'hall_low', 'hall_high', 'trash']
+
+TelemetryRecord = namedtuple('TelemetryRecord', FIELDS)
+
+"""
+Turns the payload of a FRAME_TELEMETRY into a TelemetryRecord, None if it's too short
+"""
+def decode(payload, trash=''):
+    if len(payload) < OLD_RECORD_SIZE:
+        return None
+    value = lambda start, length: int.from_bytes(payload[start:start + length], 'little')
+    return TelemetryRecord(value(0, 4), value(4, 4), payload[8], payload[9], payload[10],
+                           value(11, 2), value(13, 2), value(15, 4), payload[19],
+                           value(20, 2), value(22, 2), value(24, 2), trash)
+
+"""
+Name of the class of a command as sent to the Arduino: a single trash, or the trashes of a batch joined by '+'
+"""
+def class_name(command):
+    if command is None:
+        return ''
+    if isinstance(command, (list, tuple)):
+        return '+'.join(CLASSES.get(item, str(item)) for item in command)
+    return CLASSES.get(command, str(command))
+
+"""
+TelemetryLog appends the records to a CSV file, flushed at every record so nothing is lost if the server stops
+"""
+class TelemetryLog(object):
+    def __init__(self, path='telemetry.csv'):
+        # A log with other columns is moved to '.old', the new records wouldn't match its header
+        if os.path.exists(path):
+            with open(path, newline='') as file:
+                header = next(csv.reader(file), FIELDS)
+            if header != FIELDS:
+                os.replace(path, path + '.old')
+        self.file = open(path, 'a', newline='')
+        self.writer = csv.writer(self.file)
+        if self.file.tell() == 0:
+            self.writer.writerow(FIELDS)
+
+    def write(self, record):
+        self.writer.writerow(record)
+        self.file.flush()
+
+def read_log(path):
+    with open(path, newline='') as file:
+        for row in csv.DictReader(file):
+            yield TelemetryRecord(*[int(row.get(field) or 0) for field in FIELDS[:-1]], row['trash'])
+
+"""
+Groups the records by command: the cycle of a command goes from the start of its first motion phase to the end
+of its last one. A sequence number is reused after 255 commands, so a command ends when its FRAME_DONE is acknowledged
+(the 'feedback' record).
+"""
+def cycles(records):
+    open_cycles = {}
+    for record in records:
+        if record.seq == 0:
+            continue
+        cycle = open_cycles.setdefault(record.seq, {'trash': record.trash, 'start': None, 'end': None, 'phases': []})
+        if record.phase in MOTION_PHASES:
+            end = record.start_us + record.duration_us
+            cycle['start'] = record.start_us if cycle['start'] is None else min(cycle['start'], record.start_us)
+            cycle['end'] = end if cycle['end'] is None else max(cycle['end'], end)
+        cycle['phases'].append(record)
+        if record.trash:
+            cycle['trash'] = record.trash
+        if record.phase == 8:
+            yield open_cycles.pop(record.seq)
+    # The last commands of the log may not have their 'feedback' record
+    yield from open_cycles.values()
+
+"""
+Text histogram of the millis passed, in bins of 'width' millis
+"""
+def histogram(values, width=100, bar=40):
+    bins = defaultdict(int)
+    for value in values:
+        bins[int(value // width)] += 1
+    most = max(bins.values())
+    return '\n'.join(f'  {b * width:6d}-{(b + 1) * width:<6d} ms {"#" * max(1, round(bins[b] * bar / most))} {bins[b]}'
+                     for b in sorted(bins))
+
+def percentile(values, part):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(part * len(ordered)))]
+
+def report(records):
+    records = list(records)
+    lost = sum(record.lost for record in records)
+    by_class = defaultdict(list)
+    for cycle in cycles(records):
+        if cycle['start'] is not None:
+            by_class[cycle['trash'] or '?'].append(cycle)
+    print(f'{len(records)} records, {lost} lost')
+    for trash, class_cycles in sorted(by_class.items()):
+        times = [(cycle['end'] - cycle['start']) / 1000 for cycle in class_cycles]
+        print(f'\n{trash}: {len(times)} cycles, median {percentile(times, 0.5):.0f} ms, 90% {percentile(times, 0.9):.0f} ms')
+        print(histogram(times))
+        # Millis spent in each phase of each axis, over all the cycles of the class
+        phases = defaultdict(list)
+        overshoots = defaultdict(list)
+        for cycle in class_cycles:
+            for record in cycle['phases']:
+                key = (PHASES.get(record.phase, str(record.phase)), AXES.get(record.axis, str(record.axis)))
+                phases[key].append(record.duration_us / 1000)
+                if record.phase == 3:
+                    overshoots[key[1]].append(record.overshoot_us / 1000)
+        for (phase, axis), durations in sorted(phases.items(), key=lambda item: -sum(item[1])):
+            print(f'  {phase:10s} {axis:5s} {sum(durations) / len(class_cycles):7.0f} ms per cycle, '
+                  f'median {percentile(durations, 0.5):6.0f} ms, max {max(durations):6.0f} ms')
+        for axis, values in sorted(overshoots.items()):
+            print(f'  overshoot  {axis:5s} median {percentile(values, 0.5):6.1f} ms, max {max(values):6.1f} ms')
+    # The baselines drift slowly: far from 512 or moving a lot means a hall (or its supply) to check
+    baselines = defaultdict(list)
+    for record in records:
+        if record.axis in (0, 1) and record.hall_baseline > 0:
+            baselines[AXES[record.axis]].append(record)
+    if baselines:
+        print('\nhalls:')
+    for axis, axis_records in sorted(baselines.items()):
+        values = [record.hall_baseline for record in axis_records]
+        last = axis_records[-1]
+        print(f'  {axis:5s} baseline median {percentile(values, 0.5)}, min {min(values)}, max {max(values)}, '
+              f'last thresholds {last.hall_low} - {last.hall_high}')
+
+if __name__ == '__main__':
+    report(read_log(sys.argv[1] if len(sys.argv) > 1 else 'telemetry.csv'))